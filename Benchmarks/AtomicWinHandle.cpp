@@ -0,0 +1,110 @@
+#include "Benchmark.h"
+#include <WinHandle.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using Benchmark::do_not_optimize;
+
+namespace
+{
+	using shared_handle = WinHandle<int, -1, int>;
+
+	constexpr size_t Threads = 32;
+	constexpr size_t WriteEvery = 100; // Operations of the first thread per replacement
+
+	struct fd_owner
+	{
+		int fd;
+		~fd_owner() { Benchmark::fake_close(fd); }
+	};
+
+	// Handle published through a mutex
+	class MutexSlot
+	{
+	public:
+		shared_handle load() const
+		{
+			std::lock_guard lock{ m_mutex };
+			return m_handle;
+		}
+
+		void store(shared_handle handle)
+		{
+			std::lock_guard lock{ m_mutex };
+			m_handle.swap(handle);
+		}
+
+		static int get(const shared_handle& handle) { return handle.get(); }
+		static shared_handle make(int fd) { return shared_handle{ fd, &Benchmark::fake_close }; }
+
+	private:
+		mutable std::mutex m_mutex;
+		shared_handle m_handle{ make(0) };
+	};
+
+	class AtomicSlot
+	{
+	public:
+		shared_handle load() const { return m_handle.load(); }
+		void store(shared_handle handle) { m_handle.store(std::move(handle)); }
+
+		static int get(const shared_handle& handle) { return handle.get(); }
+		static shared_handle make(int fd) { return shared_handle{ fd, &Benchmark::fake_close }; }
+
+	private:
+		AtomicWinHandle<int, -1, int> m_handle{ make(0) };
+	};
+
+#if defined(__cpp_lib_atomic_shared_ptr)
+	class AtomicSharedPtrSlot
+	{
+	public:
+		std::shared_ptr<fd_owner> load() const { return m_handle.load(); }
+		void store(std::shared_ptr<fd_owner> handle) { m_handle.store(std::move(handle)); }
+
+		static int get(const std::shared_ptr<fd_owner>& handle) { return handle->fd; }
+		static std::shared_ptr<fd_owner> make(int fd) { return std::make_shared<fd_owner>(fd); }
+
+	private:
+		std::atomic<std::shared_ptr<fd_owner>> m_handle{ make(0) };
+	};
+#endif
+
+	// Loads the handle from Threads threads while the first one also replaces it now and then.
+	// Reported per operation over all threads.
+	template<typename Slot>
+	void readMostly(Benchmark::State& state)
+	{
+		state.pause();
+		Slot slot;
+		state.resume();
+
+		std::vector<std::thread> threads;
+		for (size_t t = 0; t < Threads; ++t)
+		{
+			threads.emplace_back([&slot, &state, t]
+			{
+				const size_t count = state.iterations() / Threads;
+				for (size_t i = 0; i < count; ++i)
+				{
+					if (t == 0 && i % WriteEvery == 0)
+						slot.store(Slot::make(static_cast<int>(i)));
+					else
+						do_not_optimize(Slot::get(slot.load()));
+				}
+			});
+		}
+		for (std::thread& thread : threads)
+			thread.join();
+	}
+}
+
+// Loading a handle that is replaced now and then, from 32 threads
+BENCHMARK(ReadMostly32Threads, Mutex) { readMostly<MutexSlot>(state); }
+#if defined(__cpp_lib_atomic_shared_ptr)
+BENCHMARK(ReadMostly32Threads, AtomicSharedPtr) { readMostly<AtomicSharedPtrSlot>(state); }
+#endif
+BENCHMARK(ReadMostly32Threads, AtomicWinHandle) { readMostly<AtomicSlot>(state); }
@@ -0,0 +1,159 @@
+#include "Benchmark.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+
+namespace
+{
+	std::atomic<size_t> s_allocations{ 0 };
+
+	struct Case
+	{
+		std::string name;
+		Benchmark::Function function;
+	};
+
+	std::vector<Case>& registry()
+	{
+		static std::vector<Case> cases;
+		return cases;
+	}
+
+	long long now() noexcept
+	{
+		using namespace std::chrono;
+		return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+	}
+
+	struct Result
+	{
+		double elapsed;
+		size_t allocations;
+	};
+
+	Result run(const Case& c, size_t iterations)
+	{
+		Benchmark::State state{ iterations };
+		state.resume();
+		c.function(state);
+		state.pause();
+		return { state.elapsed(), state.allocations() };
+	}
+
+	// Runs a benchmark with an increasing number of iterations until it takes at least min_time
+	// and reports the fastest of a few repetitions
+	void measure(const Case& c, double min_time)
+	{
+		size_t iterations = 1;
+		Result result = run(c, iterations);
+		while (result.elapsed < min_time && iterations < (size_t{ 1 } << 30))
+		{
+			const double scale = result.elapsed > 0 ? std::min(10.0, std::max(2.0, 1.2 * min_time / result.elapsed)) : 10.0;
+			iterations = static_cast<size_t>(static_cast<double>(iterations) * scale);
+			result = run(c, iterations);
+		}
+
+		double best = result.elapsed;
+		for (int i = 0; i < 2; ++i)
+			best = std::min(best, run(c, iterations).elapsed);
+
+		const double count = static_cast<double>(iterations);
+		std::printf("%-48s %12.2f ns/op %12.2f allocs/op %12zu\n", c.name.c_str(), best / count, static_cast<double>(result.allocations) / count, iterations);
+	}
+}
+
+namespace Benchmark
+{
+	State::State(size_t iterations) noexcept
+		: m_iterations{ iterations }
+	{
+	}
+
+	size_t State::iterations() const noexcept
+	{
+		return m_iterations;
+	}
+
+	void State::pause() noexcept
+	{
+		m_elapsed += now() - m_start;
+		m_allocations += s_allocations.load(std::memory_order_relaxed) - m_allocationsStart;
+	}
+
+	void State::resume() noexcept
+	{
+		m_allocationsStart = s_allocations.load(std::memory_order_relaxed);
+		m_start = now();
+	}
+
+	double State::elapsed() const noexcept
+	{
+		return static_cast<double>(m_elapsed);
+	}
+
+	size_t State::allocations() const noexcept
+	{
+		return m_allocations;
+	}
+
+	bool add(const char* group, const char* name, Function function)
+	{
+		registry().push_back({ std::string(group) + "/" + name, function });
+		return true;
+	}
+
+	int fake_close(int handle) noexcept
+	{
+		do_not_optimize(handle);
+		return 0;
+	}
+}
+
+// Counts allocations for State::allocations(). The array and nothrow forms call these by default.
+void* operator new(size_t size)
+{
+	s_allocations.fetch_add(1, std::memory_order_relaxed);
+	if (void* p = std::malloc(size ? size : 1))
+		return p;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+	std::free(p);
+}
+
+// Usage: Benchmarks [--min-time=<ms>] [filter...]
+int main(int argc, char** argv)
+{
+	double min_time = 200e6;
+	std::vector<std::string> filters;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (std::strncmp(argv[i], "--min-time=", 11) == 0)
+			min_time = std::atof(argv[i] + 11) * 1e6;
+		else
+			filters.emplace_back(argv[i]);
+	}
+
+	std::printf("%-48s %18s %22s %12s\n", "Benchmark", "Time", "Allocations", "Iterations");
+	for (const Case& c : registry())
+	{
+		const bool selected = filters.empty() || std::any_of(filters.begin(), filters.end(),
+			[&c](const std::string& filter) { return c.name.find(filter) != std::string::npos; });
+		if (selected)
+			measure(c, min_time);
+	}
+	return 0;
+}
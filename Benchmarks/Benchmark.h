@@ -0,0 +1,66 @@
+#pragma once
+#include <cstddef>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+namespace Benchmark
+{
+	class State
+	{
+	public:
+		explicit State(size_t iterations) noexcept;
+
+		// Number of operations the benchmark must perform
+		size_t iterations() const noexcept;
+
+		// Excludes the time between pause() and resume() from the measurement
+		void pause() noexcept;
+		void resume() noexcept;
+
+		// Measured time in nanoseconds
+		double elapsed() const noexcept;
+
+		// Allocations made through operator new while measuring
+		size_t allocations() const noexcept;
+
+	private:
+		size_t m_iterations;
+		long long m_start{ 0 };
+		long long m_elapsed{ 0 };
+		size_t m_allocationsStart{ 0 };
+		size_t m_allocations{ 0 };
+	};
+
+	using Function = void(*)(State& state);
+
+	bool add(const char* group, const char* name, Function function);
+
+	// Handle release function that cannot be inlined into the benchmarks
+	int fake_close(int handle) noexcept;
+
+	// Stateless deleter calling fake_close
+	struct FakeCloser
+	{
+		int operator()(int handle) const noexcept { return fake_close(handle); }
+	};
+
+	// Prevents the compiler from optimizing away a value
+	template<typename T>
+	inline void do_not_optimize(const T& value) noexcept
+	{
+#if defined(_MSC_VER) && !defined(__clang__)
+		const volatile void* sink = &value;
+		static_cast<void>(sink);
+		_ReadWriteBarrier();
+#else
+		asm volatile("" : : "r,m"(value) : "memory");
+#endif
+	}
+}
+
+// Defines and registers a benchmark. The body receives a Benchmark::State named state.
+#define BENCHMARK(Group, Name) \
+	static void Group##_##Name(Benchmark::State& state); \
+	static const bool Group##_##Name##_registered = Benchmark::add(#Group, #Name, &Group##_##Name); \
+	static void Group##_##Name(Benchmark::State& state)
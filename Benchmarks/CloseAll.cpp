@@ -0,0 +1,100 @@
+#include "Benchmark.h"
+#include <WinHandle.h>
+#include <span>
+#include <vector>
+#if defined(__linux__)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using Benchmark::do_not_optimize;
+
+namespace
+{
+	using shared_handle = WinHandle<int, -1, int>;
+
+	constexpr size_t Group = 256;
+
+	// Fills handles with a group of open handles. Returns false when they could not be opened.
+	using Opener = bool(*)(std::vector<shared_handle>& handles);
+
+	bool openFake(std::vector<shared_handle>& handles)
+	{
+		for (size_t i = 0; i < Group; ++i)
+			handles.emplace_back(static_cast<int>(i), &Benchmark::fake_close);
+		return true;
+	}
+
+	// Runs close on groups of handles, excluding the time spent opening them
+	template<typename Close>
+	void closeGroups(Benchmark::State& state, Opener open, Close close)
+	{
+		std::vector<shared_handle> handles;
+		std::vector<int> results(Group);
+		handles.reserve(Group);
+		for (size_t done = 0; done < state.iterations(); done += Group)
+		{
+			state.pause();
+			handles.clear();
+			if (!open(handles))
+				return;
+			state.resume();
+
+			close(handles, results);
+			do_not_optimize(results.data());
+		}
+	}
+
+	void oneByOne(std::vector<shared_handle>& handles, std::vector<int>& results)
+	{
+		for (size_t i = 0; i < handles.size(); ++i)
+			results[i] = handles[i].close();
+	}
+
+	void closeAll(std::vector<shared_handle>& handles, std::vector<int>& results)
+	{
+		close_all(std::span{ handles }, results);
+	}
+}
+
+// Closing groups of handles with a release function that cannot be inlined
+
+BENCHMARK(CloseGroup, OneByOne)
+{
+	closeGroups(state, &openFake, &oneByOne);
+}
+
+BENCHMARK(CloseGroup, CloseAll)
+{
+	closeGroups(state, &openFake, &closeAll);
+}
+
+#if defined(__linux__)
+namespace
+{
+	// Opens a group of file descriptors, which are mostly contiguous in a fresh process
+	bool openFds(std::vector<shared_handle>& handles)
+	{
+		for (size_t i = 0; i < Group; ++i)
+		{
+			const int fd = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+			if (fd == -1)
+				return false;
+			handles.emplace_back(fd, &::close);
+		}
+		return true;
+	}
+}
+
+// Closing groups of file descriptors released with close
+
+BENCHMARK(CloseFds, OneByOne)
+{
+	closeGroups(state, &openFds, &oneByOne);
+}
+
+BENCHMARK(CloseFds, CloseAll)
+{
+	closeGroups(state, &openFds, &closeAll);
+}
+#endif
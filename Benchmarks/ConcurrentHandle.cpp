@@ -0,0 +1,79 @@
+#include "Benchmark.h"
+#include <WinHandle.h>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using Benchmark::do_not_optimize;
+
+namespace
+{
+	using concurrent_handle = WinHandle<int, -1, int, HandleDeleter<int, int>, ConcurrentRefCount>;
+
+	constexpr size_t Threads = 8;
+	constexpr size_t WriteEvery = 100; // Operations of the first thread per replacement
+
+	// Shared handle whose readers and writers hold a mutex
+	class MutexSlot
+	{
+	public:
+		int read() const
+		{
+			std::lock_guard lock{ m_mutex };
+			return m_handle.get();
+		}
+
+		void replace(int fd)
+		{
+			std::lock_guard lock{ m_mutex };
+			m_handle = fd;
+		}
+
+	private:
+		mutable std::mutex m_mutex;
+		WinHandle<int, -1, int> m_handle{ 0, &Benchmark::fake_close };
+	};
+
+	// Shared handle read through leases
+	class LeaseSlot
+	{
+	public:
+		int read() const { return m_handle.lease().get(); }
+		void replace(int fd) { m_handle = fd; }
+
+	private:
+		concurrent_handle m_handle{ 0, &Benchmark::fake_close };
+	};
+
+	// Reads the handle from Threads threads while the first one also replaces it in place now and
+	// then. Reported per operation over all threads.
+	template<typename Slot>
+	void rotate(Benchmark::State& state)
+	{
+		state.pause();
+		Slot slot;
+		state.resume();
+
+		std::vector<std::thread> threads;
+		for (size_t t = 0; t < Threads; ++t)
+		{
+			threads.emplace_back([&slot, &state, t]
+			{
+				const size_t count = state.iterations() / Threads;
+				for (size_t i = 0; i < count; ++i)
+				{
+					if (t == 0 && i % WriteEvery == 0)
+						slot.replace(static_cast<int>(i + 1));
+					else
+						do_not_optimize(slot.read());
+				}
+			});
+		}
+		for (std::thread& thread : threads)
+			thread.join();
+	}
+}
+
+// Reading a handle that is assigned in place now and then, from 8 threads
+BENCHMARK(RotateUnderReaders, Mutex) { rotate<MutexSlot>(state); }
+BENCHMARK(RotateUnderReaders, Lease) { rotate<LeaseSlot>(state); }
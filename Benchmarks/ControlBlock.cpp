@@ -0,0 +1,128 @@
+#include "Benchmark.h"
+#include <WinHandle.h>
+#include <memory>
+#include <utility>
+#include <vector>
+
+using Benchmark::do_not_optimize;
+
+namespace
+{
+	using shared_handle = WinHandle<int, -1, int>;
+
+	static_assert(sizeof(shared_handle) == sizeof(void*), "WinHandle must be the size of a single pointer");
+
+	// The layout WinHandle used before the intrusive control block: a std::shared_ptr
+	// to a separately reference counted impl holding the handle and the deleter.
+	class SharedPtrHandle
+	{
+	public:
+		SharedPtrHandle() = default;
+		SharedPtrHandle(int handle, HandleDeleter<int> deleter)
+			: m_impl{ std::make_shared<impl>(handle, std::move(deleter)) }
+		{
+		}
+
+		int get() const noexcept { return m_impl ? m_impl->m_handle : -1; }
+
+	private:
+		struct impl
+		{
+			impl(int handle, HandleDeleter<int> deleter) noexcept : m_handle{ handle }, m_deleter{ std::move(deleter) } {}
+			~impl() noexcept { if (m_handle != -1) m_deleter(m_handle); }
+
+			int m_handle;
+			HandleDeleter<int> m_deleter;
+		};
+
+		std::shared_ptr<impl> m_impl;
+	};
+}
+
+// Copying a handle, which only updates the reference count
+
+BENCHMARK(Copy, SharedPtrLayout)
+{
+	const SharedPtrHandle source{ 1, &Benchmark::fake_close };
+	for (size_t i = 0; i < state.iterations(); ++i)
+	{
+		SharedPtrHandle copy{ source };
+		do_not_optimize(copy);
+	}
+}
+
+BENCHMARK(Copy, IntrusiveLayout)
+{
+	const shared_handle source = make_handle<shared_handle>(1, &Benchmark::fake_close);
+	for (size_t i = 0; i < state.iterations(); ++i)
+	{
+		shared_handle copy{ source };
+		do_not_optimize(copy);
+	}
+}
+
+// Destroying the last reference, which closes the handle and frees the control block
+
+BENCHMARK(Destroy, SharedPtrLayout)
+{
+	state.pause();
+	std::vector<SharedPtrHandle> handles;
+	handles.reserve(state.iterations());
+	for (size_t i = 0; i < state.iterations(); ++i)
+		handles.emplace_back(static_cast<int>(i), &Benchmark::fake_close);
+	state.resume();
+
+	handles.clear();
+	do_not_optimize(handles.data());
+}
+
+BENCHMARK(Destroy, IntrusiveLayout)
+{
+	state.pause();
+	std::vector<shared_handle> handles;
+	handles.reserve(state.iterations());
+	for (size_t i = 0; i < state.iterations(); ++i)
+		handles.push_back(make_handle<shared_handle>(static_cast<int>(i), &Benchmark::fake_close));
+	state.resume();
+
+	handles.clear();
+	do_not_optimize(handles.data());
+}
+
+// Reading the handle value through a container of handles
+
+BENCHMARK(Get, SharedPtrLayout)
+{
+	state.pause();
+	std::vector<SharedPtrHandle> handles;
+	for (int i = 0; i < 1024; ++i)
+		handles.emplace_back(i, &Benchmark::fake_close);
+	state.resume();
+
+	int sum = 0;
+	for (size_t i = 0; i < state.iterations(); ++i)
+		sum += handles[i & 1023].get();
+	do_not_optimize(sum);
+
+	state.pause();
+	handles.clear();
+	state.resume();
+}
+
+BENCHMARK(Get, IntrusiveLayout)
+{
+	state.pause();
+	std::vector<shared_handle> handles;
+	for (int i = 0; i < 1024; ++i)
+		handles.push_back(make_handle<shared_handle>(i, &Benchmark::fake_close));
+	state.resume();
+
+	int sum = 0;
+	for (size_t i = 0; i < state.iterations(); ++i)
+		sum += handles[i & 1023].get();
+	do_not_optimize(sum);
+
+	state.pause();
+	handles.clear();
+	state.resume();
+}
@@ -0,0 +1,77 @@
+#include "Benchmark.h"
+#include <WinHandle.h>
+#include <chrono>
+#include <vector>
+
+using Benchmark::do_not_optimize;
+
+namespace
+{
+	constexpr size_t Batch = 256;
+
+	// Release function taking about a microsecond, like closing a file with pending writes
+	int slow_close(int handle) noexcept
+	{
+		const auto end = std::chrono::steady_clock::now() + std::chrono::microseconds(1);
+		while (std::chrono::steady_clock::now() < end)
+			;
+		return Benchmark::fake_close(handle);
+	}
+
+	using direct_handle = WinHandle<int, -1, int>;
+	using deferred_handle = WinHandle<int, -1, int, DeferredDeleter<int, int>>;
+
+	// Measures the time spent releasing batches of handles on the calling thread. Waiting for
+	// the closer thread to catch up is excluded, so the queue never fills up.
+	template<typename Handle, typename Flush>
+	void release(Benchmark::State& state, int(*close)(int) noexcept, Flush flush)
+	{
+		std::vector<Handle> handles;
+		handles.reserve(Batch);
+		for (size_t done = 0; done < state.iterations(); done += Batch)
+		{
+			state.pause();
+			flush();
+			for (size_t i = 0; i < Batch; ++i)
+				handles.emplace_back(static_cast<int>(i), close);
+			state.resume();
+
+			handles.clear();
+			do_not_optimize(handles.data());
+		}
+		state.pause();
+		flush();
+		state.resume();
+	}
+
+	void no_flush() noexcept
+	{
+	}
+
+	void flush_deferred() noexcept
+	{
+		deferred_handle::deleter_type::closer_type::instance().flush();
+	}
+}
+
+// Time the releasing thread spends closing handles
+
+BENCHMARK(DeferredClose, DirectFast)
+{
+	release<direct_handle>(state, &Benchmark::fake_close, &no_flush);
+}
+
+BENCHMARK(DeferredClose, DeferredFast)
+{
+	release<deferred_handle>(state, &Benchmark::fake_close, &flush_deferred);
+}
+
+BENCHMARK(DeferredClose, DirectSlow)
+{
+	release<direct_handle>(state, &slow_close, &no_flush);
+}
+
+BENCHMARK(DeferredClose, DeferredSlow)
+{
+	release<deferred_handle>(state, &slow_close, &flush_deferred);
+}
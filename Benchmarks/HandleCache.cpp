@@ -0,0 +1,76 @@
+#include "Benchmark.h"
+#include <WinHandle.h>
+#include <string>
+#include <thread>
+#include <vector>
+#if defined(__linux__)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using Benchmark::do_not_optimize;
+
+namespace
+{
+	using shared_handle = WinHandle<int, -1, int>;
+
+	constexpr size_t Threads = 4;
+	constexpr int Keys = 64;
+
+	shared_handle openFake(int key)
+	{
+		return shared_handle{ key, &Benchmark::fake_close };
+	}
+
+	// Looks up cached handles from Threads threads at once, reported per lookup
+	void lookupThreaded(Benchmark::State& state, size_t shards)
+	{
+		state.pause();
+		HandleCache<int, shared_handle> cache{ 1024, shards };
+		for (int key = 0; key < Keys; ++key)
+			cache.get(key, &openFake);
+		state.resume();
+
+		std::vector<std::thread> threads;
+		for (size_t t = 0; t < Threads; ++t)
+		{
+			threads.emplace_back([&cache, &state, t]
+			{
+				const size_t count = state.iterations() / Threads;
+				for (size_t i = 0; i < count; ++i)
+					do_not_optimize(cache.get(static_cast<int>((i * 7 + t) % Keys), &openFake));
+			});
+		}
+		for (std::thread& thread : threads)
+			thread.join();
+	}
+
+#if defined(__linux__)
+	const std::string Path = "/dev/null";
+
+	shared_handle openFile(const std::string& path)
+	{
+		return shared_handle{ ::open(path.c_str(), O_RDONLY | O_CLOEXEC), &::close };
+	}
+#endif
+}
+
+#if defined(__linux__)
+// Getting a handle to the same file again and again
+BENCHMARK(OpenFile, Direct)
+{
+	for (size_t i = 0; i < state.iterations(); ++i)
+		do_not_optimize(openFile(Path));
+}
+
+BENCHMARK(OpenFile, HandleCache)
+{
+	HandleCache<std::string, shared_handle> cache;
+	for (size_t i = 0; i < state.iterations(); ++i)
+		do_not_optimize(cache.get(Path, &openFile));
+}
+#endif
+
+// Cache hits from 4 threads, with one lock or a lock per shard
+BENCHMARK(CacheHit4Threads, OneShard) { lookupThreaded(state, 1); }
+BENCHMARK(CacheHit4Threads, Sharded) { lookupThreaded(state, 16); }
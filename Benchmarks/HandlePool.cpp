@@ -0,0 +1,66 @@
+#include "Benchmark.h"
+#include <WinHandle.h>
+#include <atomic>
+#include <memory_resource>
+#include <thread>
+#include <vector>
+
+using Benchmark::do_not_optimize;
+
+namespace
+{
+	using shared_handle = WinHandle<int, -1, int>;
+
+	constexpr size_t Threads = 4;
+	constexpr size_t Batch = 64;
+
+	// Opens and closes handles in batches on several threads at once. Only the time
+	// between releasing the threads and joining them is measured.
+	void churn(Benchmark::State& state, std::pmr::memory_resource* resource)
+	{
+		state.pause();
+		std::atomic<bool> start{ false };
+		std::vector<std::thread> threads;
+		const size_t rounds = (state.iterations() + Threads * Batch - 1) / (Threads * Batch);
+		for (size_t t = 0; t < Threads; ++t)
+		{
+			threads.emplace_back([&start, resource, rounds]()
+			{
+				std::vector<shared_handle> handles;
+				handles.reserve(Batch);
+				while (!start.load(std::memory_order_acquire))
+					std::this_thread::yield();
+
+				for (size_t round = 0; round < rounds; ++round)
+				{
+					for (size_t i = 0; i < Batch; ++i)
+					{
+						if (resource)
+							handles.push_back(allocate_handle<shared_handle>(resource, static_cast<int>(i), &Benchmark::fake_close));
+						else
+							handles.push_back(make_handle<shared_handle>(static_cast<int>(i), &Benchmark::fake_close));
+					}
+					do_not_optimize(handles.data());
+					handles.clear();
+				}
+			});
+		}
+		state.resume();
+
+		start.store(true, std::memory_order_release);
+		for (std::thread& thread : threads)
+			thread.join();
+	}
+}
+
+// Multi-threaded open and close churn. Times are per handle across all threads.
+
+BENCHMARK(Churn, DefaultAllocator)
+{
+	churn(state, nullptr);
+}
+
+BENCHMARK(Churn, HandlePool)
+{
+	churn(state, shared_handle::pool());
+}
@@ -0,0 +1,113 @@
+#include "Benchmark.h"
+#include <WinHandle.h>
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+using Benchmark::do_not_optimize;
+
+namespace
+{
+	// Handle values like file descriptors: small, dense integers
+	std::vector<int> keys(size_t count)
+	{
+		std::vector<int> result(count);
+		for (size_t i = 0; i < count; ++i)
+			result[i] = static_cast<int>(i);
+		return result;
+	}
+
+	// Keys looked up in random order, so that lookups are not served from nearby cache lines
+	const std::vector<int>& lookups(size_t count)
+	{
+		static std::unordered_map<size_t, std::vector<int>> cache;
+		std::vector<int>& result = cache[count];
+		if (result.empty())
+		{
+			result = keys(count);
+			std::shuffle(result.begin(), result.end(), std::mt19937{ 42 });
+		}
+		return result;
+	}
+
+	template<typename Map>
+	const Map& filled(size_t count)
+	{
+		static std::unordered_map<size_t, Map> cache;
+		Map& map = cache[count];
+		if (map.empty())
+		{
+			for (int key : keys(count))
+				map.emplace(key, static_cast<size_t>(key));
+		}
+		return map;
+	}
+
+	size_t value(const std::unordered_map<int, size_t>& map, int key)
+	{
+		const auto it = map.find(key);
+		return it != map.end() ? it->second : 0;
+	}
+
+	size_t value(const HandleTable<int, size_t>& map, int key)
+	{
+		const size_t* found = map.find(key);
+		return found ? *found : 0;
+	}
+
+	// Looks up present keys in a map with count entries
+	template<typename Map>
+	void lookup(Benchmark::State& state, size_t count)
+	{
+		state.pause();
+		const Map& map = filled<Map>(count);
+		const std::vector<int>& order = lookups(count);
+		state.resume();
+
+		size_t sum = 0;
+		for (size_t i = 0, j = 0; i < state.iterations(); ++i, j = j + 1 == count ? 0 : j + 1)
+			sum += value(map, order[j]);
+		do_not_optimize(sum);
+	}
+
+	// Fills empty maps with up to count entries each and destroys them
+	template<typename Map>
+	void insert(Benchmark::State& state, size_t count)
+	{
+		state.pause();
+		const std::vector<int>& order = lookups(count);
+		state.resume();
+
+		for (size_t done = 0; done < state.iterations(); done += count)
+		{
+			Map map;
+			const size_t fill = std::min(count, state.iterations() - done);
+			for (size_t i = 0; i < fill; ++i)
+				map.emplace(order[i], static_cast<size_t>(order[i]));
+			do_not_optimize(map);
+		}
+	}
+
+	using unordered_map = std::unordered_map<int, size_t>;
+	using handle_table = HandleTable<int, size_t>;
+}
+
+// Looking up raw handles
+
+BENCHMARK(Lookup10k, UnorderedMap) { lookup<unordered_map>(state, 10000); }
+BENCHMARK(Lookup10k, HandleTable) { lookup<handle_table>(state, 10000); }
+BENCHMARK(Lookup100k, UnorderedMap) { lookup<unordered_map>(state, 100000); }
+BENCHMARK(Lookup100k, HandleTable) { lookup<handle_table>(state, 100000); }
+BENCHMARK(Lookup1M, UnorderedMap) { lookup<unordered_map>(state, 1000000); }
+BENCHMARK(Lookup1M, HandleTable) { lookup<handle_table>(state, 1000000); }
+
+// Inserting raw handles into an empty map. Times are per inserted entry.
+
+BENCHMARK(Insert10k, UnorderedMap) { insert<unordered_map>(state, 10000); }
+BENCHMARK(Insert10k, HandleTable) { insert<handle_table>(state, 10000); }
+BENCHMARK(Insert100k, UnorderedMap) { insert<unordered_map>(state, 100000); }
+BENCHMARK(Insert100k, HandleTable) { insert<handle_table>(state, 100000); }
+BENCHMARK(Insert1M, UnorderedMap) { insert<unordered_map>(state, 1000000); }
+BENCHMARK(Insert1M, HandleTable) { insert<handle_table>(state, 1000000); }
@@ -0,0 +1,132 @@
+#include "Benchmark.h"
+#include <WinHandle.h>
+#include <algorithm>
+#include <vector>
+
+using Benchmark::do_not_optimize;
+
+namespace
+{
+	using shared_handle = WinHandle<int, -1, int>;
+	using handle_vector = HandleVector<int, -1, int>;
+
+	constexpr size_t Count = 100000;
+
+	void append(std::vector<shared_handle>& handles, int handle)
+	{
+		handles.emplace_back(handle, &Benchmark::fake_close);
+	}
+
+	void append(handle_vector& handles, int handle)
+	{
+		handles.push_back(handle);
+	}
+
+	void close(std::vector<shared_handle>& handles, size_t index)
+	{
+		handles[index].close();
+	}
+
+	void close(handle_vector& handles, size_t index)
+	{
+		handles.close(index);
+	}
+
+	handle_vector empty(handle_vector*)
+	{
+		return handle_vector{ &Benchmark::fake_close };
+	}
+
+	std::vector<shared_handle> empty(std::vector<shared_handle>*)
+	{
+		return {};
+	}
+
+	// Fills containers with up to Count handles each, excluding the time spent closing them
+	template<typename Container>
+	void fill(Benchmark::State& state)
+	{
+		for (size_t done = 0; done < state.iterations(); done += Count)
+		{
+			state.pause();
+			Container handles = empty(static_cast<Container*>(nullptr));
+			const size_t count = std::min(Count, state.iterations() - done);
+			state.resume();
+
+			for (size_t i = 0; i < count; ++i)
+				append(handles, static_cast<int>(i));
+			do_not_optimize(handles.size());
+
+			state.pause();
+			handles.clear();
+			state.resume();
+		}
+	}
+
+	// Closes every other handle so that scans cannot predict the valid ones
+	template<typename Container>
+	Container& halfClosed()
+	{
+		static Container handles = empty(static_cast<Container*>(nullptr));
+		if (handles.empty())
+		{
+			for (size_t i = 0; i < Count; ++i)
+				append(handles, static_cast<int>(i));
+			for (size_t i = 0; i < Count / 2; ++i)
+				close(handles, (i * 7919) % Count);
+		}
+		return handles;
+	}
+
+	size_t countValid(const std::vector<shared_handle>& handles)
+	{
+		return static_cast<size_t>(std::count_if(handles.begin(), handles.end(), [](const shared_handle& h) { return h.valid(); }));
+	}
+
+	size_t countValid(const handle_vector& handles)
+	{
+		return handles.count_valid();
+	}
+
+	// Counts the valid handles of Count handles, reported per handle
+	template<typename Container>
+	void count(Benchmark::State& state)
+	{
+		state.pause();
+		const Container& handles = halfClosed<Container>();
+		state.resume();
+
+		size_t sum = 0;
+		for (size_t done = 0; done < state.iterations(); done += Count)
+			sum += countValid(handles);
+		do_not_optimize(sum);
+	}
+
+	// Closes containers of Count handles, excluding the time spent filling them
+	template<typename Container>
+	void closeAll(Benchmark::State& state)
+	{
+		for (size_t done = 0; done < state.iterations(); done += Count)
+		{
+			state.pause();
+			Container handles = empty(static_cast<Container*>(nullptr));
+			for (size_t i = 0; i < Count; ++i)
+				append(handles, static_cast<int>(i));
+			state.resume();
+
+			handles.clear();
+		}
+	}
+}
+
+// Storing 100k handles sharing one deleter
+BENCHMARK(Fill100k, WinHandles) { fill<std::vector<shared_handle>>(state); }
+BENCHMARK(Fill100k, HandleVector) { fill<handle_vector>(state); }
+
+// Counting the valid handles of 100k handles, half of them closed
+BENCHMARK(CountValid100k, WinHandles) { count<std::vector<shared_handle>>(state); }
+BENCHMARK(CountValid100k, HandleVector) { count<handle_vector>(state); }
+
+// Closing 100k handles with a release function that cannot be inlined
+BENCHMARK(Close100k, WinHandles) { closeAll<std::vector<shared_handle>>(state); }
+BENCHMARK(Close100k, HandleVector) { closeAll<handle_vector>(state); }
@@ -0,0 +1,667 @@
+#include "Benchmark.h"
+#include <WinHandle.h>
+#if defined(__linux__)
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+
+using Benchmark::do_not_optimize;
+
+namespace
+{
+	constexpr size_t Batch = 256;
+
+	// POSIX file descriptor owned by a WinHandle released with close
+	using fd_handle = WinHandle<int, -1>;
+
+	// File descriptor handle configured by handle_traits<fd_tag>, with the release inlined
+	using traits_handle = WinHandleFor<fd_tag>;
+
+	// Nullable pointer type letting std::unique_ptr own a file descriptor without allocating
+	struct fd_pointer
+	{
+		int fd{ -1 };
+
+		fd_pointer() noexcept = default;
+		fd_pointer(std::nullptr_t) noexcept {}
+		explicit fd_pointer(int fd) noexcept : fd{ fd } {}
+
+		explicit operator bool() const noexcept { return fd != -1; }
+		friend bool operator==(fd_pointer lhs, fd_pointer rhs) noexcept { return lhs.fd == rhs.fd; }
+		friend bool operator<(fd_pointer lhs, fd_pointer rhs) noexcept { return lhs.fd < rhs.fd; }
+	};
+
+	struct fd_closer
+	{
+		using pointer = fd_pointer;
+		void operator()(fd_pointer p) const noexcept { ::close(p.fd); }
+	};
+
+	using fd_unique_ptr = std::unique_ptr<int, fd_closer>;
+
+	// Object closing a file descriptor, shared through std::shared_ptr
+	struct fd_owner
+	{
+		explicit fd_owner(int fd) noexcept : fd{ fd } {}
+		~fd_owner() { ::close(fd); }
+
+		int fd;
+	};
+
+	using fd_shared_ptr = std::shared_ptr<fd_owner>;
+
+	int openFd() noexcept
+	{
+		return ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+	}
+
+	// Runs body on batches of freshly opened descriptors, which it must close. Opening
+	// the descriptors is not measured.
+	template<typename Body>
+	void withFds(Benchmark::State& state, Body body)
+	{
+		int fds[Batch];
+		for (size_t done = 0; done < state.iterations(); done += Batch)
+		{
+			const size_t count = std::min(Batch, state.iterations() - done);
+			state.pause();
+			for (size_t i = 0; i < count; ++i)
+				fds[i] = openFd();
+			state.resume();
+
+			body(fds, count);
+		}
+	}
+
+	// Fills handles with one handle per descriptor in a batch. Nothing is measured.
+	template<typename Handle, typename Make>
+	void fill(Benchmark::State& state, std::vector<Handle>& handles, const int* fds, size_t count, Make make)
+	{
+		state.pause();
+		handles.clear();
+		for (size_t i = 0; i < count; ++i)
+			handles.push_back(make(fds[i]));
+		state.resume();
+	}
+
+	// Destroys handles without measuring it
+	template<typename Handle>
+	void drain(Benchmark::State& state, std::vector<Handle>& handles)
+	{
+		state.pause();
+		handles.clear();
+		state.resume();
+	}
+
+	fd_unique_ptr makeUnique(int fd) { return fd_unique_ptr{ fd_pointer{ fd } }; }
+	fd_shared_ptr makeShared(int fd) { return std::make_shared<fd_owner>(fd); }
+	fd_handle makeWinHandle(int fd) { return fd_handle{ fd, &::close }; }
+	traits_handle makeTraitsHandle(int fd) { return traits_handle{ fd }; }
+
+	// Acquires a descriptor through an out parameter
+	bool acquireFd(int* fd) noexcept
+	{
+		*fd = openFd();
+		return *fd != -1;
+	}
+
+	// Functions using a descriptor without keeping it, called through pointers so they are not inlined
+	int useRaw(int fd) noexcept { return fd; }
+	int useWinHandle(fd_handle handle) noexcept { return handle.get(); }
+	int useView(HandleView<int, -1> handle) noexcept { return handle.get(); }
+
+	template<typename Function, typename Handle>
+	void pass(Benchmark::State& state, Function function, const Handle& handle)
+	{
+		for (size_t i = 0; i < state.iterations(); ++i)
+		{
+			do_not_optimize(function);
+			do_not_optimize(function(handle));
+		}
+	}
+}
+
+// Default construction and destruction of an empty handle
+
+BENCHMARK(FdDefault, RawHandle)
+{
+	for (size_t i = 0; i < state.iterations(); ++i)
+	{
+		int handle = -1;
+		do_not_optimize(handle);
+	}
+}
+
+BENCHMARK(FdDefault, UniquePtr)
+{
+	for (size_t i = 0; i < state.iterations(); ++i)
+	{
+		fd_unique_ptr handle;
+		do_not_optimize(handle);
+	}
+}
+
+BENCHMARK(FdDefault, SharedPtr)
+{
+	for (size_t i = 0; i < state.iterations(); ++i)
+	{
+		fd_shared_ptr handle;
+		do_not_optimize(handle);
+	}
+}
+
+BENCHMARK(FdDefault, WinHandle)
+{
+	for (size_t i = 0; i < state.iterations(); ++i)
+	{
+		fd_handle handle;
+		do_not_optimize(handle);
+	}
+}
+
+// Taking ownership of an open descriptor and closing it again
+
+BENCHMARK(FdOwn, RawHandle)
+{
+	withFds(state, [](const int* fds, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			int handle = fds[i];
+			do_not_optimize(handle);
+			::close(handle);
+		}
+	});
+}
+
+BENCHMARK(FdOwn, UniquePtr)
+{
+	withFds(state, [](const int* fds, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			fd_unique_ptr handle = makeUnique(fds[i]);
+			do_not_optimize(handle);
+		}
+	});
+}
+
+BENCHMARK(FdOwn, SharedPtr)
+{
+	withFds(state, [](const int* fds, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			fd_shared_ptr handle = makeShared(fds[i]);
+			do_not_optimize(handle);
+		}
+	});
+}
+
+BENCHMARK(FdOwn, WinHandle)
+{
+	withFds(state, [](const int* fds, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			fd_handle handle = makeWinHandle(fds[i]);
+			do_not_optimize(handle);
+		}
+	});
+}
+
+BENCHMARK(FdOwn, WinHandleFor)
+{
+	withFds(state, [](const int* fds, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			traits_handle handle = makeTraitsHandle(fds[i]);
+			do_not_optimize(handle);
+		}
+	});
+}
+
+// Copying a handle and destroying the copy
+
+BENCHMARK(FdCopy, RawHandle)
+{
+	const int source = openFd();
+	for (size_t i = 0; i < state.iterations(); ++i)
+	{
+		int copy = source;
+		do_not_optimize(copy);
+	}
+	::close(source);
+}
+
+BENCHMARK(FdCopy, SharedPtr)
+{
+	const fd_shared_ptr source = makeShared(openFd());
+	for (size_t i = 0; i < state.iterations(); ++i)
+	{
+		fd_shared_ptr copy{ source };
+		do_not_optimize(copy);
+	}
+}
+
+BENCHMARK(FdCopy, WinHandle)
+{
+	const fd_handle source = makeWinHandle(openFd());
+	for (size_t i = 0; i < state.iterations(); ++i)
+	{
+		fd_handle copy{ source };
+		do_not_optimize(copy);
+	}
+}
+
+// Passing a descriptor to a function that only uses it
+
+BENCHMARK(FdPass, RawHandle)
+{
+	const int source = openFd();
+	pass(state, &useRaw, source);
+	::close(source);
+}
+
+BENCHMARK(FdPass, WinHandle)
+{
+	pass(state, &useWinHandle, makeWinHandle(openFd()));
+}
+
+BENCHMARK(FdPass, HandleView)
+{
+	pass(state, &useView, makeWinHandle(openFd()));
+}
+
+// Locking a weak reference to a handle and destroying the locked copy
+
+BENCHMARK(FdLock, SharedPtr)
+{
+	const fd_shared_ptr source = makeShared(openFd());
+	const std::weak_ptr<fd_owner> weak{ source };
+	for (size_t i = 0; i < state.iterations(); ++i)
+	{
+		fd_shared_ptr locked = weak.lock();
+		do_not_optimize(locked);
+	}
+}
+
+BENCHMARK(FdLock, WinHandle)
+{
+	const fd_handle source = makeWinHandle(openFd());
+	const WeakWinHandle<int, -1> weak{ source };
+	for (size_t i = 0; i < state.iterations(); ++i)
+	{
+		fd_handle locked = weak.lock();
+		do_not_optimize(locked);
+	}
+}
+
+// Moving a handle between two slots
+
+BENCHMARK(FdMove, RawHandle)
+{
+	int slots[2] = { openFd(), -1 };
+	for (size_t i = 0; i < state.iterations(); ++i)
+	{
+		slots[(i + 1) & 1] = std::exchange(slots[i & 1], -1);
+		do_not_optimize(slots);
+	}
+	::close(std::max(slots[0], slots[1]));
+}
+
+BENCHMARK(FdMove, UniquePtr)
+{
+	fd_unique_ptr slots[2] = { makeUnique(openFd()), fd_unique_ptr{} };
+	for (size_t i = 0; i < state.iterations(); ++i)
+	{
+		slots[(i + 1) & 1] = std::move(slots[i & 1]);
+		do_not_optimize(slots);
+	}
+}
+
+BENCHMARK(FdMove, SharedPtr)
+{
+	fd_shared_ptr slots[2] = { makeShared(openFd()), fd_shared_ptr{} };
+	for (size_t i = 0; i < state.iterations(); ++i)
+	{
+		slots[(i + 1) & 1] = std::move(slots[i & 1]);
+		do_not_optimize(slots);
+	}
+}
+
+BENCHMARK(FdMove, WinHandle)
+{
+	fd_handle slots[2] = { makeWinHandle(openFd()), fd_handle{} };
+	for (size_t i = 0; i < state.iterations(); ++i)
+	{
+		slots[(i + 1) & 1] = std::move(slots[i & 1]);
+		do_not_optimize(slots);
+	}
+}
+
+// Emptying a handle with reset(), which closes the descriptor
+
+BENCHMARK(FdReset, UniquePtr)
+{
+	std::vector<fd_unique_ptr> handles;
+	withFds(state, [&state, &handles](const int* fds, size_t count)
+	{
+		fill(state, handles, fds, count, &makeUnique);
+		for (fd_unique_ptr& handle : handles)
+			handle.reset();
+		do_not_optimize(handles.data());
+		drain(state, handles);
+	});
+}
+
+BENCHMARK(FdReset, SharedPtr)
+{
+	std::vector<fd_shared_ptr> handles;
+	withFds(state, [&state, &handles](const int* fds, size_t count)
+	{
+		fill(state, handles, fds, count, &makeShared);
+		for (fd_shared_ptr& handle : handles)
+			handle.reset();
+		do_not_optimize(handles.data());
+		drain(state, handles);
+	});
+}
+
+BENCHMARK(FdReset, WinHandle)
+{
+	std::vector<fd_handle> handles;
+	withFds(state, [&state, &handles](const int* fds, size_t count)
+	{
+		fill(state, handles, fds, count, &makeWinHandle);
+		for (fd_handle& handle : handles)
+			handle.reset();
+		do_not_optimize(handles.data());
+		drain(state, handles);
+	});
+}
+
+// Replacing the owned descriptor with reset(T), which closes the previous one
+
+BENCHMARK(FdResetValue, RawHandle)
+{
+	int handle = openFd();
+	withFds(state, [&handle](const int* fds, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			::close(handle);
+			handle = fds[i];
+			do_not_optimize(handle);
+		}
+	});
+	::close(handle);
+}
+
+BENCHMARK(FdResetValue, UniquePtr)
+{
+	fd_unique_ptr handle = makeUnique(openFd());
+	withFds(state, [&handle](const int* fds, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			handle.reset(fd_pointer{ fds[i] });
+			do_not_optimize(handle);
+		}
+	});
+}
+
+BENCHMARK(FdResetValue, SharedPtr)
+{
+	fd_shared_ptr handle = makeShared(openFd());
+	withFds(state, [&handle](const int* fds, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			handle = makeShared(fds[i]);
+			do_not_optimize(handle);
+		}
+	});
+}
+
+BENCHMARK(FdResetValue, WinHandle)
+{
+	fd_handle handle = makeWinHandle(openFd());
+	withFds(state, [&handle](const int* fds, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			handle.reset(fds[i]);
+			do_not_optimize(handle);
+		}
+	});
+}
+
+// Acquiring a descriptor through an out parameter. Includes opening and closing it.
+
+BENCHMARK(FdPtr, RawHandle)
+{
+	for (size_t i = 0; i < state.iterations(); ++i)
+	{
+		int handle = -1;
+		acquireFd(&handle);
+		do_not_optimize(handle);
+		::close(handle);
+	}
+}
+
+BENCHMARK(FdPtr, UniquePtr)
+{
+	for (size_t i = 0; i < state.iterations(); ++i)
+	{
+		fd_unique_ptr handle;
+		int fd = -1;
+		if (acquireFd(&fd))
+			handle.reset(fd_pointer{ fd });
+		do_not_optimize(handle);
+	}
+}
+
+BENCHMARK(FdPtr, WinHandle)
+{
+	for (size_t i = 0; i < state.iterations(); ++i)
+	{
+		fd_handle handle{ &::close };
+		acquireFd(handle.ptr());
+		do_not_optimize(handle);
+	}
+}
+
+// Acquiring descriptors in a loop into the same handle, which closes the previous one
+
+BENCHMARK(FdPtrReuse, RawHandle)
+{
+	int handle = -1;
+	for (size_t i = 0; i < state.iterations(); ++i)
+	{
+		int fd = -1;
+		acquireFd(&fd);
+		if (handle >= 0)
+			::close(handle);
+		handle = fd;
+		do_not_optimize(handle);
+	}
+	::close(handle);
+}
+
+BENCHMARK(FdPtrReuse, WinHandle)
+{
+	fd_handle handle{ &::close };
+	for (size_t i = 0; i < state.iterations(); ++i)
+	{
+		acquireFd(handle.ptr());
+		do_not_optimize(handle);
+	}
+}
+
+// Creating Batch pipes at once into fresh handles and closing them. Reported per pipe.
+
+BENCHMARK(PipeBatch, RawHandle)
+{
+	std::vector<int> fds(2 * Batch);
+	for (size_t done = 0; done < state.iterations(); done += Batch)
+	{
+		for (size_t i = 0; i < Batch; ++i)
+			::pipe(&fds[2 * i]);
+		do_not_optimize(fds.data());
+		for (int fd : fds)
+			::close(fd);
+	}
+}
+
+BENCHMARK(PipeBatch, WinHandlePtrs)
+{
+	std::vector<traits_handle> handles;
+	for (size_t done = 0; done < state.iterations(); done += Batch)
+	{
+		handles.resize(2 * Batch);
+		for (size_t i = 0; i < Batch; ++i)
+			::pipe(ptrs(handles[2 * i], handles[2 * i + 1]));
+		do_not_optimize(handles.data());
+		handles.clear();
+	}
+}
+
+BENCHMARK(PipeBatch, WinHandleGroups)
+{
+	std::vector<traits_handle> handles;
+	for (size_t done = 0; done < state.iterations(); done += Batch)
+	{
+		handles.resize(2 * Batch);
+		acquire_groups<2>(std::span(handles), [](int* fds) { return ::pipe(fds) == 0; });
+		do_not_optimize(handles.data());
+		handles.clear();
+	}
+}
+
+// Closing an open descriptor with close()
+
+BENCHMARK(FdClose, RawHandle)
+{
+	withFds(state, [](const int* fds, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+			::close(fds[i]);
+	});
+}
+
+BENCHMARK(FdClose, WinHandle)
+{
+	std::vector<fd_handle> handles;
+	withFds(state, [&state, &handles](const int* fds, size_t count)
+	{
+		fill(state, handles, fds, count, &makeWinHandle);
+		for (fd_handle& handle : handles)
+			do_not_optimize(handle.close());
+		drain(state, handles);
+	});
+}
+
+// Comparing two handles
+
+BENCHMARK(FdCompare, RawHandle)
+{
+	const int handles[2] = { openFd(), openFd() };
+	size_t less = 0;
+	for (size_t i = 0; i < state.iterations(); ++i)
+	{
+		do_not_optimize(handles);
+		less += handles[i & 1] < handles[(i + 1) & 1] || handles[0] == handles[1];
+	}
+	do_not_optimize(less);
+	::close(handles[0]);
+	::close(handles[1]);
+}
+
+BENCHMARK(FdCompare, UniquePtr)
+{
+	const fd_unique_ptr handles[2] = { makeUnique(openFd()), makeUnique(openFd()) };
+	size_t less = 0;
+	for (size_t i = 0; i < state.iterations(); ++i)
+	{
+		do_not_optimize(handles);
+		less += handles[i & 1] < handles[(i + 1) & 1] || handles[0] == handles[1];
+	}
+	do_not_optimize(less);
+}
+
+BENCHMARK(FdCompare, SharedPtr)
+{
+	const fd_shared_ptr handles[2] = { makeShared(openFd()), makeShared(openFd()) };
+	size_t less = 0;
+	for (size_t i = 0; i < state.iterations(); ++i)
+	{
+		do_not_optimize(handles);
+		less += handles[i & 1]->fd < handles[(i + 1) & 1]->fd || handles[0]->fd == handles[1]->fd;
+	}
+	do_not_optimize(less);
+}
+
+BENCHMARK(FdCompare, WinHandle)
+{
+	const fd_handle handles[2] = { makeWinHandle(openFd()), makeWinHandle(openFd()) };
+	size_t less = 0;
+	for (size_t i = 0; i < state.iterations(); ++i)
+	{
+		do_not_optimize(handles);
+		less += handles[i & 1] < handles[(i + 1) & 1] || handles[0] == handles[1];
+	}
+	do_not_optimize(less);
+}
+
+// Destroying the last reference, which closes the descriptor
+
+BENCHMARK(FdDestroyLast, UniquePtr)
+{
+	std::vector<fd_unique_ptr> handles;
+	withFds(state, [&state, &handles](const int* fds, size_t count)
+	{
+		fill(state, handles, fds, count, &makeUnique);
+		handles.clear();
+		do_not_optimize(handles.data());
+	});
+}
+
+BENCHMARK(FdDestroyLast, SharedPtr)
+{
+	std::vector<fd_shared_ptr> handles;
+	withFds(state, [&state, &handles](const int* fds, size_t count)
+	{
+		fill(state, handles, fds, count, &makeShared);
+		handles.clear();
+		do_not_optimize(handles.data());
+	});
+}
+
+BENCHMARK(FdDestroyLast, WinHandle)
+{
+	std::vector<fd_handle> handles;
+	withFds(state, [&state, &handles](const int* fds, size_t count)
+	{
+		fill(state, handles, fds, count, &makeWinHandle);
+		handles.clear();
+		do_not_optimize(handles.data());
+	});
+}
+
+BENCHMARK(FdDestroyLast, WinHandleFor)
+{
+	std::vector<traits_handle> handles;
+	withFds(state, [&state, &handles](const int* fds, size_t count)
+	{
+		fill(state, handles, fds, count, &makeTraitsHandle);
+		handles.clear();
+		do_not_optimize(handles.data());
+	});
+}
+#endif
@@ -0,0 +1,81 @@
+#include "Benchmark.h"
+#include <WinHandle.h>
+#include <utility>
+
+using Benchmark::do_not_optimize;
+
+namespace
+{
+	using atomic_handle = WinHandle<int, -1, int, HandleDeleter<int>, AtomicRefCount>;
+	using local_handle = WinHandle<int, -1, int, HandleDeleter<int>, LocalRefCount>;
+}
+
+// Copy construction and destruction of a second reference
+
+BENCHMARK(RefCountCopy, Atomic)
+{
+	const atomic_handle source{ 1, &Benchmark::fake_close };
+	for (size_t i = 0; i < state.iterations(); ++i)
+	{
+		atomic_handle copy{ source };
+		do_not_optimize(copy);
+	}
+}
+
+BENCHMARK(RefCountCopy, Local)
+{
+	const local_handle source{ 1, &Benchmark::fake_close };
+	for (size_t i = 0; i < state.iterations(); ++i)
+	{
+		local_handle copy{ source };
+		do_not_optimize(copy);
+	}
+}
+
+// Copy assignment alternating between two shared handles
+
+BENCHMARK(RefCountAssign, Atomic)
+{
+	const atomic_handle sources[2] = { atomic_handle{ 1, &Benchmark::fake_close }, atomic_handle{ 2, &Benchmark::fake_close } };
+	atomic_handle target;
+	for (size_t i = 0; i < state.iterations(); ++i)
+	{
+		target = sources[i & 1];
+		do_not_optimize(target);
+	}
+}
+
+BENCHMARK(RefCountAssign, Local)
+{
+	const local_handle sources[2] = { local_handle{ 1, &Benchmark::fake_close }, local_handle{ 2, &Benchmark::fake_close } };
+	local_handle target;
+	for (size_t i = 0; i < state.iterations(); ++i)
+	{
+		target = sources[i & 1];
+		do_not_optimize(target);
+	}
+}
+
+// Swapping two handles, which never touches the reference count
+
+BENCHMARK(RefCountSwap, Atomic)
+{
+	atomic_handle h1{ 1, &Benchmark::fake_close };
+	atomic_handle h2{ 2, &Benchmark::fake_close };
+	for (size_t i = 0; i < state.iterations(); ++i)
+	{
+		h1.swap(h2);
+		do_not_optimize(h1);
+	}
+}
+
+BENCHMARK(RefCountSwap, Local)
+{
+	local_handle h1{ 1, &Benchmark::fake_close };
+	local_handle h2{ 2, &Benchmark::fake_close };
+	for (size_t i = 0; i < state.iterations(); ++i)
+	{
+		h1.swap(h2);
+		do_not_optimize(h1);
+	}
+}
@@ -0,0 +1,86 @@
+#include "Benchmark.h"
+#include <WinHandle.h>
+#include <algorithm>
+#include <type_traits>
+#include <vector>
+
+using Benchmark::do_not_optimize;
+
+namespace
+{
+	using shared_handle = WinHandle<int, -1, int>;
+	using small_vector = SmallHandleVector<shared_handle>;
+
+	constexpr size_t Count = 1000;
+
+	std::vector<shared_handle> handles(size_t count)
+	{
+		std::vector<shared_handle> handles;
+		handles.reserve(count);
+		for (size_t i = 0; i < count; ++i)
+			handles.emplace_back(static_cast<int>(i), &Benchmark::fake_close);
+		return handles;
+	}
+
+	// Moves up to Count handles into containers that start empty, excluding the time spent moving them
+	// back. Small containers keep the storage in the allocator's caches, so page faults do not hide the
+	// cost of relocating.
+	template<typename Container>
+	void grow(Benchmark::State& state)
+	{
+		state.pause();
+		std::vector<shared_handle> source = handles(Count);
+		state.resume();
+
+		for (size_t done = 0; done < state.iterations(); done += Count)
+		{
+			const size_t count = std::min(Count, state.iterations() - done);
+			Container target;
+			for (size_t i = 0; i < count; ++i)
+				target.push_back(std::move(source[i]));
+			do_not_optimize(target.size());
+
+			state.pause();
+			for (size_t i = 0; i < count; ++i)
+				source[i] = std::move(target[i]);
+			state.resume();
+		}
+	}
+
+	// Erases the first of Count handles and appends it again, so every handle after it moves down
+	template<typename Container>
+	void eraseFront(Benchmark::State& state)
+	{
+		using value_type = typename Container::value_type;
+
+		state.pause();
+		std::vector<shared_handle> source = handles(Count);
+		Container container;
+		for (shared_handle& handle : source)
+		{
+			if constexpr (std::is_same_v<value_type, shared_handle>)
+				container.push_back(std::move(handle));
+			else
+				container.push_back(handle.get());
+		}
+		state.resume();
+
+		for (size_t i = 0; i < state.iterations(); ++i)
+		{
+			value_type front = std::move(container.front());
+			container.erase(container.begin());
+			container.push_back(std::move(front));
+		}
+		do_not_optimize(container.size());
+	}
+}
+
+// Growing a container to 1000 handles, moving each existing handle on every reallocation
+BENCHMARK(Grow1000, Vector) { grow<std::vector<shared_handle>>(state); }
+BENCHMARK(Grow1000, SmallHandleVector) { grow<small_vector>(state); }
+
+// Erasing the first of 1000 handles. RawHandle is the floor: moving a handle must stay a plain copy
+// of its pointer, without touching reference counts.
+BENCHMARK(EraseFront1000, RawHandle) { eraseFront<std::vector<int>>(state); }
+BENCHMARK(EraseFront1000, Vector) { eraseFront<std::vector<shared_handle>>(state); }
+BENCHMARK(EraseFront1000, SmallHandleVector) { eraseFront<small_vector>(state); }
@@ -0,0 +1,137 @@
+#include "Benchmark.h"
+#include <WinHandle.h>
+#include <utility>
+#include <vector>
+
+using Benchmark::do_not_optimize;
+
+namespace
+{
+	using unique_handle = UniqueWinHandle<int, -1, int, Benchmark::FakeCloser>;
+	using shared_handle = WinHandle<int, -1, int>;
+
+	static_assert(sizeof(unique_handle) == sizeof(int), "UniqueWinHandle with a stateless deleter must be the size of the handle");
+
+	int closeRaw(int& handle) noexcept
+	{
+		int result = 0;
+		if (handle != -1)
+			result = Benchmark::fake_close(std::exchange(handle, -1));
+		return result;
+	}
+}
+
+// Construction and destruction of an owning handle
+
+BENCHMARK(Construct, RawHandle)
+{
+	for (size_t i = 0; i < state.iterations(); ++i)
+	{
+		int handle = static_cast<int>(i);
+		do_not_optimize(handle);
+		closeRaw(handle);
+	}
+}
+
+BENCHMARK(Construct, UniqueWinHandle)
+{
+	for (size_t i = 0; i < state.iterations(); ++i)
+	{
+		unique_handle handle{ static_cast<int>(i) };
+		do_not_optimize(handle);
+	}
+}
+
+BENCHMARK(Construct, WinHandle)
+{
+	for (size_t i = 0; i < state.iterations(); ++i)
+	{
+		shared_handle handle{ static_cast<int>(i), &Benchmark::fake_close };
+		do_not_optimize(handle);
+	}
+}
+
+// Moving a handle between two slots
+
+BENCHMARK(Move, RawHandle)
+{
+	int slots[2] = { 1, -1 };
+	for (size_t i = 0; i < state.iterations(); ++i)
+	{
+		slots[(i + 1) & 1] = std::exchange(slots[i & 1], -1);
+		do_not_optimize(slots);
+	}
+	closeRaw(slots[state.iterations() & 1]);
+}
+
+BENCHMARK(Move, UniqueWinHandle)
+{
+	unique_handle slots[2] = { unique_handle{ 1 }, unique_handle{} };
+	for (size_t i = 0; i < state.iterations(); ++i)
+	{
+		slots[(i + 1) & 1] = std::move(slots[i & 1]);
+		do_not_optimize(slots);
+	}
+}
+
+BENCHMARK(Move, WinHandle)
+{
+	shared_handle slots[2] = { shared_handle{ 1, &Benchmark::fake_close }, shared_handle{} };
+	for (size_t i = 0; i < state.iterations(); ++i)
+	{
+		slots[(i + 1) & 1] = std::move(slots[i & 1]);
+		do_not_optimize(slots);
+	}
+}
+
+// Closing an open handle
+
+BENCHMARK(Close, RawHandle)
+{
+	state.pause();
+	std::vector<int> handles(state.iterations());
+	for (size_t i = 0; i < handles.size(); ++i)
+		handles[i] = static_cast<int>(i);
+	state.resume();
+
+	for (int& handle : handles)
+		closeRaw(handle);
+
+	do_not_optimize(handles.data());
+}
+
+BENCHMARK(Close, UniqueWinHandle)
+{
+	state.pause();
+	std::vector<unique_handle> handles;
+	handles.reserve(state.iterations());
+	for (size_t i = 0; i < state.iterations(); ++i)
+		handles.emplace_back(static_cast<int>(i));
+	state.resume();
+
+	for (unique_handle& handle : handles)
+		handle.close();
+
+	do_not_optimize(handles.data());
+	state.pause();
+	handles.clear();
+	state.resume();
+}
+
+BENCHMARK(Close, WinHandle)
+{
+	state.pause();
+	std::vector<shared_handle> handles;
+	handles.reserve(state.iterations());
+	for (size_t i = 0; i < state.iterations(); ++i)
+		handles.emplace_back(static_cast<int>(i), &Benchmark::fake_close);
+	state.resume();
+
+	for (shared_handle& handle : handles)
+		handle.close();
+
+	do_not_optimize(handles.data());
+	state.pause();
+	handles.clear();
+	state.resume();
+}
@@ -0,0 +1,117 @@
+#include "Benchmark.h"
+#include <WinHandle.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+#if defined(__linux__)
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
+using Benchmark::do_not_optimize;
+
+namespace
+{
+	using shared_handle = WinHandle<int, -1, int>;
+
+#if defined(__linux__)
+	using entry_type = pollfd;
+#else
+	using entry_type = int;
+#endif
+	using wait_set = HandleWaitSet<shared_handle, entry_type>;
+
+	// Raw handles looked up in random order
+	std::vector<int> lookups(size_t count)
+	{
+		std::vector<int> result(count);
+		for (size_t i = 0; i < count; ++i)
+			result[i] = static_cast<int>(i);
+		std::shuffle(result.begin(), result.end(), std::mt19937{ 42 });
+		return result;
+	}
+
+	// Finds the index of handles in count handles by searching the handles themselves
+	void findHandles(Benchmark::State& state, size_t count)
+	{
+		state.pause();
+		std::vector<shared_handle> handles;
+		for (size_t i = 0; i < count; ++i)
+			handles.emplace_back(static_cast<int>(i), &Benchmark::fake_close);
+		const std::vector<int> order = lookups(count);
+		state.resume();
+
+		size_t sum = 0;
+		for (size_t i = 0, j = 0; i < state.iterations(); ++i, j = j + 1 == count ? 0 : j + 1)
+		{
+			const int handle = order[j];
+			sum += std::find_if(handles.begin(), handles.end(), [handle](const shared_handle& h) { return h.get() == handle; }) - handles.begin();
+		}
+		do_not_optimize(sum);
+	}
+
+	// Finds the index of handles in a wait set of count handles
+	void findWaitSet(Benchmark::State& state, size_t count)
+	{
+		state.pause();
+		wait_set set;
+		for (size_t i = 0; i < count; ++i)
+			set.add(shared_handle{ static_cast<int>(i), &Benchmark::fake_close });
+		const std::vector<int> order = lookups(count);
+		state.resume();
+
+		size_t sum = 0;
+		for (size_t i = 0, j = 0; i < state.iterations(); ++i, j = j + 1 == count ? 0 : j + 1)
+			sum += set.find(order[j]);
+		do_not_optimize(sum);
+	}
+
+#if defined(__linux__)
+	constexpr size_t Polled = 256;
+
+	// Polls Polled idle eventfds, copying the raw handles into a pollfd array before each call
+	void pollCopy(Benchmark::State& state)
+	{
+		state.pause();
+		std::vector<shared_handle> handles;
+		for (size_t i = 0; i < Polled; ++i)
+			handles.emplace_back(::eventfd(0, EFD_CLOEXEC), &::close);
+		std::vector<pollfd> entries;
+		state.resume();
+
+		for (size_t i = 0; i < state.iterations(); ++i)
+		{
+			entries.clear();
+			for (const shared_handle& handle : handles)
+				entries.push_back({ handle.get(), POLLIN, 0 });
+			do_not_optimize(::poll(entries.data(), entries.size(), 0));
+		}
+	}
+
+	// Polls Polled idle eventfds held by a wait set
+	void pollWaitSet(Benchmark::State& state)
+	{
+		state.pause();
+		wait_set set;
+		for (size_t i = 0; i < Polled; ++i)
+			set.add(shared_handle{ ::eventfd(0, EFD_CLOEXEC), &::close }, POLLIN);
+		state.resume();
+
+		for (size_t i = 0; i < state.iterations(); ++i)
+			do_not_optimize(::poll(set.data(), set.size(), 0));
+	}
+#endif
+}
+
+// Finding the entry of a raw handle, e.g. one reported by an event loop
+BENCHMARK(Find64, Handles) { findHandles(state, 64); }
+BENCHMARK(Find64, WaitSet) { findWaitSet(state, 64); }
+BENCHMARK(Find1024, Handles) { findHandles(state, 1024); }
+BENCHMARK(Find1024, WaitSet) { findWaitSet(state, 1024); }
+
+#if defined(__linux__)
+// A poll() loop iteration on 256 handles
+BENCHMARK(Poll256, Copy) { pollCopy(state); }
+BENCHMARK(Poll256, WaitSet) { pollWaitSet(state); }
+#endif
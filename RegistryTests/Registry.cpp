@@ -0,0 +1,97 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include <WinHandle.h>
+#include <algorithm>
+#include <numeric>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+
+namespace Registry
+{
+	// Handle types that are not used anywhere else
+	enum class registry_handle : INT_PTR { null = 0, handle1 = 1234, handle2 = 4321 };
+	enum class peak_handle : INT_PTR { null = 0, handle1 = 1234, handle2 = 4321 };
+	enum class unique_handle : INT_PTR { null = 0, handle1 = 1234, handle2 = 4321 };
+
+	TEST_CLASS(HandleRegistryTests)
+	{
+	public:
+		using winhandle_type = WinHandle<registry_handle, registry_handle::null, BOOL>;
+
+		static BOOL __stdcall Close(registry_handle)
+		{
+			return TRUE;
+		}
+
+		template<typename Handle>
+		static HandleStatistics Find()
+		{
+			const std::vector<HandleStatistics> snapshot = HandleRegistry::snapshot();
+			auto it = std::find_if(snapshot.begin(), snapshot.end(), [](const HandleStatistics& s) { return *s.type == typeid(Handle); });
+			Assert::IsTrue(it != snapshot.end());
+			return *it;
+		}
+
+		TEST_METHOD(CountsHandles)
+		{
+			{
+				winhandle_type h1{ registry_handle::handle1, &Close };
+				winhandle_type h2{ h1 };
+				winhandle_type h3{ &Close };
+
+				Assert::AreEqual(1ll, Find<winhandle_type>().live);
+				h3 = registry_handle::handle2;
+				Assert::AreEqual(2ll, Find<winhandle_type>().live);
+				h1.close();
+			}
+
+			const HandleStatistics statistics = Find<winhandle_type>();
+			Assert::AreEqual(0ll, statistics.live);
+			Assert::AreEqual(2ull, statistics.acquired);
+			Assert::AreEqual(2ull, statistics.released);
+			Assert::AreEqual(2ull, std::accumulate(statistics.latency.begin(), statistics.latency.end(), 0ull));
+		}
+
+		TEST_METHOD(Peak)
+		{
+			using peak_type = WinHandle<peak_handle, peak_handle::null, BOOL>;
+			{
+				peak_type h1{ peak_handle::handle1, [](peak_handle) { return TRUE; } };
+				peak_type h2{ peak_handle::handle2, [](peak_handle) { return TRUE; } };
+			}
+			{
+				peak_type h1{ peak_handle::handle1, [](peak_handle) { return TRUE; } };
+			}
+
+			const HandleStatistics statistics = Find<peak_type>();
+			Assert::AreEqual(0ll, statistics.live);
+			Assert::AreEqual(2ll, statistics.peak);
+			Assert::AreEqual(3ull, statistics.acquired);
+		}
+
+		TEST_METHOD(UniqueHandles)
+		{
+			using unique_type = UniqueWinHandle<unique_handle, unique_handle::null, BOOL>;
+			using shared_type = WinHandle<unique_handle, unique_handle::null, BOOL>;
+			{
+				// Moving a unique handle is not counted, promoting it acquires the handle once
+				unique_type u1{ unique_handle::handle1, [](unique_handle) { return TRUE; } };
+				unique_type u2{ std::move(u1) };
+				unique_type u3;
+				u3 = std::move(u2);
+				shared_type h{ std::move(u3) };
+
+				const HandleStatistics statistics = Find<shared_type>();
+				Assert::AreEqual(1ll, statistics.live);
+				Assert::AreEqual(1ull, statistics.acquired);
+				Assert::AreEqual(0ull, statistics.released);
+			}
+
+			const HandleStatistics statistics = Find<shared_type>();
+			Assert::AreEqual(0ll, statistics.live);
+			Assert::AreEqual(1ull, statistics.acquired);
+			Assert::AreEqual(1ull, statistics.released);
+		}
+	};
+}
@@ -0,0 +1,57 @@
+#include "pch.h"
+#include "AllocationCounter.h"
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+	thread_local size_t g_allocations = 0;
+
+	void* counted_alloc(size_t size)
+	{
+		++g_allocations;
+		if (void* p = std::malloc(size == 0 ? 1 : size))
+			return p;
+		throw std::bad_alloc();
+	}
+}
+
+void* operator new(size_t size)
+{
+	return counted_alloc(size);
+}
+
+void* operator new[](size_t size)
+{
+	return counted_alloc(size);
+}
+
+void operator delete(void* p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+	std::free(p);
+}
+
+AllocationCounter::AllocationCounter() noexcept
+	: m_start{ g_allocations }
+{
+}
+
+size_t AllocationCounter::allocations() const noexcept
+{
+	return g_allocations - m_start;
+}
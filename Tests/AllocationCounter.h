@@ -0,0 +1,20 @@
+#pragma once
+#include <cstddef>
+
+// Counts calls to the global operator new made by the current thread while the
+// counter is alive. The replacement operators are defined in AllocationCounter.cpp.
+class AllocationCounter
+{
+public:
+	AllocationCounter() noexcept;
+	~AllocationCounter() = default;
+
+	AllocationCounter(const AllocationCounter&) = delete;
+	AllocationCounter& operator=(const AllocationCounter&) = delete;
+
+	// Number of allocations since construction
+	size_t allocations() const noexcept;
+
+private:
+	size_t m_start;
+};
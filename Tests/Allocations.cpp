@@ -0,0 +1,529 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include "AllocationCounter.h"
+#include "MockDeleter.h"
+#include <WinHandle.h>
+#include <deque>
+#include <utility>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+
+namespace Allocations
+{
+	TEST_CLASS(Move)
+	{
+	public:
+		inline static const HANDLE Handle1 = reinterpret_cast<HANDLE>(1234);
+		inline static const HANDLE Handle2 = reinterpret_cast<HANDLE>(4321);
+
+		using handle_type = std::remove_cv_t<decltype(Handle1)>;
+
+		TEST_METHOD(MoveConstructor)
+		{
+			MockDeleter<handle_type> deleter{ std::vector<handle_type>{ Handle1 } };
+			WinHandle<handle_type> h1{ Handle1, &MockDeleter<handle_type>::Delete, &deleter };
+
+			AllocationCounter counter;
+			WinHandle<handle_type> h2{ std::move(h1) };
+
+			Assert::AreEqual(static_cast<size_t>(0), counter.allocations());
+			Assert::IsFalse(h1.valid());
+			Assert::AreEqual(Handle1, h2.get());
+		}
+
+		TEST_METHOD(MoveAssignment)
+		{
+			MockDeleter<handle_type> deleter{ std::vector<handle_type>{ Handle2, Handle1 } };
+			WinHandle<handle_type> h1{ Handle1, &MockDeleter<handle_type>::Delete, &deleter };
+			WinHandle<handle_type> h2{ Handle2, &MockDeleter<handle_type>::Delete, &deleter };
+
+			AllocationCounter counter;
+			h2 = std::move(h1);
+
+			Assert::AreEqual(static_cast<size_t>(0), counter.allocations());
+			Assert::AreEqual(static_cast<size_t>(1), deleter.called());
+			Assert::IsFalse(h1.valid());
+			Assert::AreEqual(Handle1, h2.get());
+		}
+
+		TEST_METHOD(SelfMoveAssignment)
+		{
+			MockDeleter<handle_type> deleter{ std::vector<handle_type>{ Handle1 } };
+			WinHandle<handle_type> h1{ Handle1, &MockDeleter<handle_type>::Delete, &deleter };
+			WinHandle<handle_type>& alias = h1;
+
+			h1 = std::move(alias);
+
+			Assert::AreEqual(Handle1, h1.get());
+			Assert::AreEqual(static_cast<size_t>(0), deleter.called());
+		}
+
+		TEST_METHOD(MovedFromState)
+		{
+			MockDeleter<handle_type> deleter{ std::vector<handle_type>{ Handle2, Handle1 } };
+			WinHandle<handle_type> h1{ Handle1, &MockDeleter<handle_type>::Delete, &deleter };
+			WinHandle<handle_type> h2{ std::move(h1) };
+
+			Assert::IsFalse(h1.valid());
+			Assert::AreEqual(static_cast<handle_type>(0), h1.get());
+			Assert::AreEqual(1l, h1.use_count());
+			Assert::AreEqual(static_cast<handle_type>(0), *std::as_const(h1).ptr());
+
+			// Closing and resetting a moved-from handle is a no-op
+			h1.close();
+			h1.reset();
+			Assert::IsFalse(h1.valid());
+			Assert::AreEqual(static_cast<size_t>(0), deleter.called());
+
+			// A moved-from handle can be reused and keeps the deleter
+			h1 = Handle2;
+			Assert::AreEqual(Handle2, h1.get());
+			h1.reset();
+			Assert::AreEqual(static_cast<size_t>(1), deleter.called());
+		}
+
+		TEST_METHOD(MovedFromKeepsDeleter)
+		{
+			MockDeleter<handle_type> deleter{ std::vector<handle_type>{ Handle2, Handle1, Handle2 } };
+			WinHandle<handle_type> h1{ Handle1, &MockDeleter<handle_type>::Delete, &deleter };
+			WinHandle<handle_type> h2;
+			h2 = std::move(h1);
+
+			// Values stored through reset() and ptr() are released with the deleter of the moved handle
+			h1.reset(Handle2);
+			h1.close();
+			*h1.ptr() = Handle2;
+
+			// The moved-from handle does not keep the value of the moved handle
+			h2.reset();
+			Assert::AreEqual(static_cast<size_t>(2), deleter.called());
+			Assert::AreEqual(Handle2, h1.get());
+		}
+
+		TEST_METHOD(MovedFromKeepsOwnDeleter)
+		{
+			MockDeleter<handle_type> deleter1{ std::vector<handle_type>{ Handle2, Handle1 } };
+			MockDeleter<handle_type> deleter2{ std::vector<handle_type>{ Handle2 } };
+			{
+				WinHandle<handle_type> h1{ Handle1, &MockDeleter<handle_type>::Delete, &deleter1 };
+				WinHandle<handle_type> h2{ Handle2, &MockDeleter<handle_type>::Delete, &deleter2 };
+
+				// The handle moved to has another deleter, so the moved-from handle does not take over its impl
+				h2 = std::move(h1);
+				Assert::AreEqual(static_cast<size_t>(1), deleter2.called());
+				h1 = Handle2;
+				h1.reset();
+				Assert::AreEqual(static_cast<size_t>(1), deleter1.called());
+			}
+			Assert::AreEqual(static_cast<size_t>(2), deleter1.called());
+		}
+
+		TEST_METHOD(MovedFromDoesNotShare)
+		{
+			MockDeleter<handle_type> deleter{ std::vector<handle_type>{ Handle1, Handle2 } };
+			WinHandle<handle_type> h1{ Handle1, &MockDeleter<handle_type>::Delete, &deleter };
+			WinHandle<handle_type> h2{ std::move(h1) };
+
+			// The moved-from handle only keeps the deleter, so the impl is still reused in place
+			AllocationCounter counter;
+			h2.reset(Handle2);
+
+			Assert::AreEqual(static_cast<size_t>(0), counter.allocations());
+			Assert::AreEqual(static_cast<size_t>(1), deleter.called());
+			Assert::AreEqual(1l, h2.use_count());
+		}
+
+		TEST_METHOD(VectorGrowth)
+		{
+			const auto release = [](handle_type) { return TRUE; };
+			std::vector<WinHandle<handle_type>> handles;
+			handles.emplace_back(Handle1, release);
+
+			size_t reallocations = 0;
+			AllocationCounter counter;
+			for (size_t i = 0; i < 64; ++i)
+			{
+				const size_t capacity = handles.capacity();
+				handles.emplace_back(Handle2, release);
+				if (handles.capacity() != capacity)
+					++reallocations;
+			}
+
+			// One allocation per new impl plus the vector's own buffer growth; relocated elements are free
+			Assert::AreEqual(64 + reallocations, counter.allocations());
+			Assert::AreEqual(Handle1, handles.front().get());
+			Assert::AreEqual(1l, handles.front().use_count());
+		}
+
+		TEST_METHOD(QueueRoundTrip)
+		{
+			MockDeleter<handle_type> deleter{ std::vector<handle_type>{ Handle1 } };
+			std::deque<WinHandle<handle_type>> queue;
+			queue.emplace_back(Handle1, &MockDeleter<handle_type>::Delete, &deleter);
+
+			AllocationCounter counter;
+			WinHandle<handle_type> h1{ std::move(queue.front()) };
+			queue.pop_front();
+
+			Assert::AreEqual(static_cast<size_t>(0), counter.allocations());
+			Assert::AreEqual(Handle1, h1.get());
+			Assert::AreEqual(static_cast<size_t>(0), deleter.called());
+		}
+	};
+
+	TEST_CLASS(Empty)
+	{
+	public:
+		inline static const HANDLE Handle1 = reinterpret_cast<HANDLE>(1234);
+		inline static const HANDLE Handle2 = reinterpret_cast<HANDLE>(4321);
+
+		using handle_type = std::remove_cv_t<decltype(Handle1)>;
+
+		TEST_METHOD(DefaultConstructor)
+		{
+			AllocationCounter counter;
+			WinHandle<handle_type> h1;
+			WinHandle<handle_type, INVALID_HANDLE_VALUE> h2;
+
+			Assert::AreEqual(static_cast<size_t>(0), counter.allocations());
+			Assert::IsFalse(h1.valid());
+			Assert::IsFalse(h2.valid());
+			Assert::AreEqual(static_cast<handle_type>(0), h1.get());
+			Assert::AreEqual(INVALID_HANDLE_VALUE, h2.get());
+			Assert::AreEqual(1l, h1.use_count());
+			Assert::AreEqual(1l, h2.use_count());
+		}
+
+		TEST_METHOD(NullNonOwningConstructor)
+		{
+			AllocationCounter counter;
+			WinHandle<handle_type, INVALID_HANDLE_VALUE> h1{ INVALID_HANDLE_VALUE, nullptr };
+
+			Assert::AreEqual(static_cast<size_t>(0), counter.allocations());
+			Assert::IsFalse(h1.valid());
+		}
+
+		TEST_METHOD(NonOwningConstructor)
+		{
+			// Non-owning handles take their impl from the pool, which allocates slabs of blocks at once
+			std::vector<WinHandle<handle_type>> handles;
+			handles.reserve(1000);
+
+			AllocationCounter counter;
+			for (size_t i = 0; i < 1000; ++i)
+				handles.emplace_back(Handle1, nullptr);
+
+			Assert::IsTrue(counter.allocations() <= 1000 / (HandlePool<1>::slab_size - 1) + 1);
+			Assert::AreEqual(Handle1, handles.back().get());
+		}
+
+		TEST_METHOD(PresizedArray)
+		{
+			std::vector<WinHandle<handle_type, INVALID_HANDLE_VALUE>> handles;
+			handles.reserve(1000);
+
+			AllocationCounter counter;
+			handles.resize(1000);
+			Assert::AreEqual(static_cast<size_t>(0), counter.allocations());
+
+			// Copying an empty handle creates the impl the copies share
+			WinHandle<handle_type, INVALID_HANDLE_VALUE> copy = handles.back();
+			Assert::AreEqual(static_cast<size_t>(1), counter.allocations());
+			Assert::IsFalse(copy.valid());
+		}
+
+		TEST_METHOD(CopyThenAssign)
+		{
+			WinHandle<handle_type, INVALID_HANDLE_VALUE> h1;
+			WinHandle<handle_type, INVALID_HANDLE_VALUE> h2{ h1 };
+			WinHandle<handle_type, INVALID_HANDLE_VALUE> h3;
+			h3 = h2;
+
+			// Copies of an empty handle share the values assigned to any of them
+			Assert::AreEqual(3l, h1.use_count());
+			Assert::AreEqual(3l, h3.use_count());
+
+			AllocationCounter counter;
+			h1 = Handle1;
+			Assert::AreEqual(static_cast<size_t>(0), counter.allocations());
+			Assert::AreEqual(Handle1, h2.get());
+			Assert::AreEqual(Handle1, h3.get());
+
+			h3 = Handle2;
+			Assert::AreEqual(Handle2, h1.get());
+		}
+
+		TEST_METHOD(CopyMovedFrom)
+		{
+			MockDeleter<handle_type> deleter{ std::vector<handle_type>{ Handle1 } };
+			WinHandle<handle_type> h1{ Handle2, nullptr };
+			WinHandle<handle_type> h2{ &MockDeleter<handle_type>::Delete, &deleter };
+			h1 = std::move(h2);
+
+			// A copy of a moved-from handle shares the values assigned to it and keeps the deleter
+			WinHandle<handle_type> h3{ h2 };
+			Assert::AreEqual(2l, h2.use_count());
+			h3 = Handle1;
+			Assert::AreEqual(Handle1, h2.get());
+			h2.reset();
+			Assert::AreEqual(static_cast<size_t>(0), deleter.called());
+			h3.reset();
+			Assert::AreEqual(static_cast<size_t>(1), deleter.called());
+		}
+
+		TEST_METHOD(AllocateOnAssignment)
+		{
+			WinHandle<handle_type> h1;
+
+			AllocationCounter counter;
+			h1 = static_cast<handle_type>(0);
+			Assert::AreEqual(static_cast<size_t>(0), counter.allocations());
+
+			h1 = Handle1;
+			Assert::AreEqual(static_cast<size_t>(1), counter.allocations());
+			Assert::AreEqual(Handle1, h1.get());
+		}
+
+		TEST_METHOD(AllocateOnReset)
+		{
+			WinHandle<handle_type> h1;
+
+			AllocationCounter counter;
+			h1.reset();
+			h1.reset(static_cast<handle_type>(0));
+			Assert::AreEqual(static_cast<size_t>(0), counter.allocations());
+
+			h1.reset(Handle1);
+			Assert::AreEqual(static_cast<size_t>(1), counter.allocations());
+			Assert::AreEqual(Handle1, h1.get());
+
+			// Resetting a non-owning handle drops the impl instead of replacing it
+			h1.reset();
+			Assert::AreEqual(static_cast<size_t>(1), counter.allocations());
+			Assert::IsFalse(h1.valid());
+		}
+
+		TEST_METHOD(AllocateOnPtr)
+		{
+			WinHandle<handle_type> h1;
+
+			AllocationCounter counter;
+			TestPointerAssignment(h1.ptr(), static_cast<handle_type>(0));
+			Assert::AreEqual(static_cast<size_t>(0), counter.allocations());
+
+			TestPointerAssignment(h1.ptr(), Handle2);
+			Assert::AreEqual(static_cast<size_t>(1), counter.allocations());
+			Assert::AreEqual(Handle2, h1.get());
+		}
+
+		TEST_METHOD(ReuseOnPtr)
+		{
+			std::vector<handle_type> expect;
+			for (size_t i = 0; i < 100; ++i)
+				expect.push_back(i % 2 ? Handle2 : Handle1);
+			MockDeleter<handle_type> deleter{ expect };
+			WinHandle<handle_type> h1{ &MockDeleter<handle_type>::Delete, &deleter };
+
+			// Acquiring in a loop closes the previous handle and keeps the control block
+			AllocationCounter counter;
+			for (size_t i = 0; i < 100; ++i)
+				TestPointerAssignment(h1.ptr(), i % 2 ? Handle2 : Handle1);
+
+			Assert::AreEqual(static_cast<size_t>(0), counter.allocations());
+			Assert::AreEqual(static_cast<size_t>(99), deleter.called());
+			Assert::AreEqual(Handle2, h1.get());
+		}
+
+		TEST_METHOD(DetachOnSharedPtr)
+		{
+			MockDeleter<handle_type> deleter{ std::vector<handle_type>{ Handle1, Handle2 } };
+			WinHandle<handle_type> h1{ Handle1, &MockDeleter<handle_type>::Delete, &deleter };
+			{
+				WinHandle<handle_type> h2{ h1 };
+
+				// Copies keep the value they share
+				AllocationCounter counter;
+				TestPointerAssignment(h1.ptr(), Handle2);
+
+				Assert::AreEqual(static_cast<size_t>(1), counter.allocations());
+				Assert::AreEqual(Handle2, h1.get());
+				Assert::AreEqual(Handle1, h2.get());
+				Assert::AreEqual(static_cast<size_t>(0), deleter.called());
+			}
+			Assert::AreEqual(static_cast<size_t>(1), deleter.called());
+		}
+
+		TEST_METHOD(OwningEmptyHandle)
+		{
+			// The deleter of an empty owning handle must be kept for the values stored later
+			MockDeleter<handle_type> deleter{ std::vector<handle_type>{ Handle1 } };
+			WinHandle<handle_type> h1{ &MockDeleter<handle_type>::Delete, &deleter };
+
+			h1 = Handle1;
+			h1.reset();
+
+			Assert::IsFalse(h1.valid());
+		}
+
+	private:
+		void TestPointerAssignment(handle_type* h, handle_type new_value)
+		{
+			*h = new_value;
+		}
+	};
+
+	TEST_CLASS(Deleters)
+	{
+	public:
+		inline static const HANDLE Handle1 = reinterpret_cast<HANDLE>(1234);
+		inline static const HANDLE Handle2 = reinterpret_cast<HANDLE>(4321);
+		inline static const DWORD Param1 = 17;
+		inline static const DWORD Param2 = 42;
+
+		using handle_type = std::remove_cv_t<decltype(Handle1)>;
+
+		static BOOL __stdcall fp2(handle_type, DWORD p1, DWORD p2)
+		{
+			Assert::AreEqual(Param1, p1);
+			Assert::AreEqual(Param2, p2);
+			return TRUE;
+		}
+
+		BOOL __stdcall mfp2(handle_type, DWORD p1, DWORD p2)
+		{
+			Assert::AreEqual(Param1, p1);
+			Assert::AreEqual(Param2, p2);
+			return TRUE;
+		}
+
+		TEST_METHOD(BoundFunctionPointer)
+		{
+			AllocationCounter counter;
+			WinHandle<handle_type, static_cast<handle_type>(0), BOOL> h1{ Handle1, &fp2, static_cast<DWORD>(Param1), static_cast<DWORD>(Param2) };
+
+			// Only the impl is allocated; the deleter and its arguments are stored inline
+			Assert::AreEqual(static_cast<size_t>(1), counter.allocations());
+		}
+
+		TEST_METHOD(BoundMemberFunctionPointer)
+		{
+			using Class = std::remove_reference_t<decltype(*this)>;
+
+			AllocationCounter counter;
+			WinHandle<handle_type, static_cast<handle_type>(0), BOOL> h1{ Handle1, &Class::mfp2, this, static_cast<DWORD>(Param1), static_cast<DWORD>(Param2) };
+
+			Assert::AreEqual(static_cast<size_t>(1), counter.allocations());
+		}
+
+		TEST_METHOD(ResetCopiesDeleterInline)
+		{
+			WinHandle<handle_type, static_cast<handle_type>(0), BOOL> h1{ Handle1, &fp2, static_cast<DWORD>(Param1), static_cast<DWORD>(Param2) };
+			WinHandle<handle_type, static_cast<handle_type>(0), BOOL> h2{ h1 };
+
+			AllocationCounter counter;
+			h1.reset(Handle2);
+
+			Assert::AreEqual(static_cast<size_t>(1), counter.allocations());
+			Assert::AreEqual(Handle2, h1.get());
+		}
+
+		TEST_METHOD(ResetReusesUnsharedImpl)
+		{
+			MockDeleter<handle_type> deleter{ std::vector<handle_type>{ Handle1, Handle2, Handle1 } };
+			WinHandle<handle_type> h1{ Handle1, &MockDeleter<handle_type>::Delete, &deleter };
+
+			// The sole owner closes the handle and stores the new one in the same impl
+			AllocationCounter counter;
+			h1.reset(Handle2);
+			Assert::AreEqual(static_cast<size_t>(1), deleter.called());
+			Assert::AreEqual(Handle2, h1.get());
+
+			h1.reset();
+			Assert::AreEqual(static_cast<size_t>(2), deleter.called());
+			Assert::IsFalse(h1.valid());
+
+			h1.reset(Handle1);
+			Assert::AreEqual(static_cast<size_t>(0), counter.allocations());
+		}
+	};
+
+	TEST_CLASS(ControlBlock)
+	{
+	public:
+		inline static const HANDLE Handle1 = reinterpret_cast<HANDLE>(1234);
+		inline static const DWORD Param1 = 17;
+
+		using handle_type = std::remove_cv_t<decltype(Handle1)>;
+		using handle_t = WinHandle<handle_type, static_cast<handle_type>(0), BOOL>;
+
+		static BOOL __stdcall fp1(handle_type, DWORD p1)
+		{
+			Assert::AreEqual(Param1, p1);
+			return TRUE;
+		}
+
+		TEST_METHOD(PointerSized)
+		{
+			Assert::AreEqual(sizeof(void*), sizeof(handle_t));
+		}
+
+		TEST_METHOD(MakeHandleSingleAllocation)
+		{
+			AllocationCounter counter;
+			handle_t h1 = make_handle<handle_t>(Handle1, [](handle_type h) { return fp1(h, Param1); });
+
+			Assert::AreEqual(static_cast<size_t>(1), counter.allocations());
+			Assert::AreEqual(Handle1, h1.get());
+			Assert::AreEqual(1l, h1.use_count());
+		}
+
+		TEST_METHOD(MakeHandleNullDeleter)
+		{
+			handle_t h1 = make_handle<handle_t>(Handle1, nullptr);
+
+			Assert::AreEqual(Handle1, h1.get());
+			Assert::AreEqual(static_cast<BOOL>(0), h1.close());
+		}
+
+		TEST_METHOD(CopyDoesNotAllocate)
+		{
+			handle_t h1{ Handle1, &fp1, static_cast<DWORD>(Param1) };
+
+			AllocationCounter counter;
+			handle_t h2{ h1 };
+			handle_t h3;
+			h3 = h2;
+
+			Assert::AreEqual(static_cast<size_t>(0), counter.allocations());
+			Assert::AreEqual(3l, h1.use_count());
+			Assert::AreEqual(Handle1, h3.get());
+		}
+
+		TEST_METHOD(LastReferenceCloses)
+		{
+			MockDeleter<handle_type> deleter{ std::vector<handle_type>{ Handle1 } };
+			{
+				WinHandle<handle_type> h1{ Handle1, &MockDeleter<handle_type>::Delete, &deleter };
+				WinHandle<handle_type> h2{ h1 };
+
+				h1.reset();
+				Assert::AreEqual(static_cast<size_t>(0), deleter.called());
+				Assert::AreEqual(1l, h2.use_count());
+			}
+			Assert::AreEqual(static_cast<size_t>(1), deleter.called());
+		}
+
+		TEST_METHOD(SelfCopyAssignment)
+		{
+			handle_t h1{ Handle1, &fp1, static_cast<DWORD>(Param1) };
+			handle_t& alias = h1;
+
+			h1 = alias;
+
+			Assert::AreEqual(Handle1, h1.get());
+			Assert::AreEqual(1l, h1.use_count());
+		}
+	};
+}
@@ -0,0 +1,133 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include "MockDeleter.h"
+#include <WinHandle.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+
+namespace Atomic
+{
+	TEST_CLASS(AtomicWinHandleTests)
+	{
+	public:
+		inline static const HANDLE Handle1 = reinterpret_cast<HANDLE>(1234);
+		inline static const HANDLE Handle2 = reinterpret_cast<HANDLE>(4321);
+
+		using handle_type = std::remove_cv_t<decltype(Handle1)>;
+		using winhandle_type = WinHandle<handle_type>;
+		using atomic_type = AtomicWinHandle<handle_type>;
+
+		TEST_METHOD(DefaultConstructor)
+		{
+			atomic_type a1;
+
+			Assert::IsFalse(a1.load().valid());
+		}
+
+		TEST_METHOD(LoadAndStore)
+		{
+			MockDeleter<handle_type> deleter{ std::vector<handle_type>{ Handle1, Handle2 } };
+			{
+				atomic_type a1{ winhandle_type{ Handle1, &MockDeleter<handle_type>::Delete, &deleter } };
+				winhandle_type h1 = a1.load();
+				Assert::AreEqual(Handle1, h1.get());
+
+				a1.store(winhandle_type{ Handle2, &MockDeleter<handle_type>::Delete, &deleter });
+				Assert::AreEqual(Handle2, a1.load().get());
+				Assert::AreEqual(static_cast<size_t>(0), deleter.called());
+
+				h1.reset();
+				Assert::AreEqual(static_cast<size_t>(1), deleter.called());
+			}
+			Assert::AreEqual(static_cast<size_t>(2), deleter.called());
+		}
+
+		TEST_METHOD(Exchange)
+		{
+			MockDeleter<handle_type> deleter{ std::vector<handle_type>{ Handle1 } };
+			atomic_type a1{ winhandle_type{ Handle1, &MockDeleter<handle_type>::Delete, &deleter } };
+
+			winhandle_type h1 = a1.exchange(winhandle_type{ Handle2, nullptr });
+			Assert::AreEqual(Handle1, h1.get());
+			Assert::AreEqual(Handle2, a1.load().get());
+
+			h1.reset();
+			Assert::AreEqual(static_cast<size_t>(1), deleter.called());
+		}
+
+		TEST_METHOD(CompareExchange)
+		{
+			atomic_type a1{ winhandle_type{ Handle1, nullptr } };
+			winhandle_type expected{ Handle1, nullptr }; // Same value, other control block
+
+			Assert::IsFalse(a1.compare_exchange_strong(expected, winhandle_type{ Handle2, nullptr }));
+			Assert::AreEqual(Handle1, a1.load().get());
+
+			Assert::IsTrue(a1.compare_exchange_strong(expected, winhandle_type{ Handle2, nullptr }));
+			Assert::AreEqual(Handle2, a1.load().get());
+		}
+
+		TEST_METHOD(LoadedHandleNotReused)
+		{
+			atomic_type a1{ winhandle_type{ Handle1, nullptr } };
+			winhandle_type h1 = a1.load();
+
+			// The atomic handle still refers to the block, so resetting the loaded handle must not change it
+			h1.reset(Handle2);
+			Assert::AreEqual(Handle1, a1.load().get());
+			Assert::AreEqual(Handle2, h1.get());
+		}
+
+		TEST_METHOD(ConcurrentCompareExchange)
+		{
+			std::atomic<int> closed{ 0 };
+			const auto close = [&closed](handle_type) { ++closed; return TRUE; };
+			{
+				atomic_type a1{ winhandle_type{ Handle1, close } };
+				std::atomic<bool> done{ false };
+				std::thread reader([&a1, &done]
+				{
+					while (!done.load())
+						static_cast<void>(a1.load());
+				});
+
+				// Loads change the word but never make compare_exchange_strong() fail
+				for (int i = 0; i < 10000; ++i)
+				{
+					winhandle_type expected = a1.load();
+					Assert::IsTrue(a1.compare_exchange_strong(expected, winhandle_type{ Handle2, close }));
+				}
+				done.store(true);
+				reader.join();
+			}
+			Assert::AreEqual(10001, closed.load());
+		}
+
+		TEST_METHOD(ConcurrentLoads)
+		{
+			std::atomic<int> closed{ 0 };
+			const auto close = [&closed](handle_type) { ++closed; return TRUE; };
+			{
+				atomic_type a1{ winhandle_type{ Handle1, close } };
+				std::vector<std::thread> threads;
+				for (int t = 0; t < 4; ++t)
+				{
+					threads.emplace_back([&a1]
+					{
+						for (int i = 0; i < 100000; ++i)
+							Assert::IsTrue(a1.load().valid());
+					});
+				}
+				for (int i = 0; i < 1000; ++i)
+					a1.store(winhandle_type{ Handle2, close });
+				for (std::thread& thread : threads)
+					thread.join();
+			}
+			Assert::AreEqual(1001, closed.load());
+		}
+	};
+}
@@ -0,0 +1,91 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include "MockDeleter.h"
+#include <WinHandle.h>
+#include <span>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+
+namespace BulkClose
+{
+	TEST_CLASS(CloseAll)
+	{
+	public:
+		inline static const HANDLE Handle1 = reinterpret_cast<HANDLE>(1234);
+		inline static const HANDLE Handle2 = reinterpret_cast<HANDLE>(4321);
+		inline static const HANDLE Handle3 = reinterpret_cast<HANDLE>(5678);
+
+		using handle_type = std::remove_cv_t<decltype(Handle1)>;
+		using winhandle_type = WinHandle<handle_type, static_cast<handle_type>(0), BOOL>;
+
+		static BOOL __stdcall Succeed(handle_type)
+		{
+			return TRUE;
+		}
+
+		static BOOL __stdcall Fail(handle_type)
+		{
+			return FALSE;
+		}
+
+		TEST_METHOD(ClosesEveryHandle)
+		{
+			MockDeleter<handle_type> deleter{ std::vector<handle_type>{ Handle1, Handle2 } };
+			std::vector<winhandle_type> handles;
+			handles.emplace_back(Handle1, &MockDeleter<handle_type>::Delete, &deleter);
+			handles.emplace_back();
+			handles.emplace_back(Handle2, &MockDeleter<handle_type>::Delete, &deleter);
+
+			Assert::AreEqual(static_cast<size_t>(2), close_all(std::span{ handles }));
+			Assert::AreEqual(static_cast<size_t>(2), deleter.called());
+			for (const winhandle_type& handle : handles)
+				Assert::IsFalse(handle.valid());
+		}
+
+		TEST_METHOD(Results)
+		{
+			std::vector<winhandle_type> handles;
+			handles.emplace_back(Handle1, &Succeed);
+			handles.emplace_back(Handle2, &Fail);
+			handles.emplace_back();
+			handles.emplace_back(Handle3, &Succeed);
+
+			std::vector<BOOL> results(handles.size(), -1);
+			Assert::AreEqual(static_cast<size_t>(3), close_all(std::span{ handles }, results));
+
+			Assert::AreEqual(TRUE, results[0]);
+			Assert::AreEqual(FALSE, results[1]);
+			Assert::AreEqual(static_cast<BOOL>(0), results[2]);
+			Assert::AreEqual(TRUE, results[3]);
+		}
+
+		TEST_METHOD(ShortResultBuffer)
+		{
+			std::vector<winhandle_type> handles;
+			handles.emplace_back(Handle1, &Succeed);
+			handles.emplace_back(Handle2, &Fail);
+
+			BOOL results[1] = { -1 };
+			Assert::AreEqual(static_cast<size_t>(2), close_all(std::span{ handles }, results));
+
+			Assert::AreEqual(TRUE, results[0]);
+			Assert::IsFalse(handles[1].valid());
+		}
+
+		TEST_METHOD(SharedHandleClosedOnce)
+		{
+			MockDeleter<handle_type> deleter{ std::vector<handle_type>{ Handle1 } };
+			std::vector<winhandle_type> handles;
+			handles.emplace_back(Handle1, &MockDeleter<handle_type>::Delete, &deleter);
+			handles.push_back(handles.front());
+
+			winhandle_type outside{ handles.front() };
+			Assert::AreEqual(static_cast<size_t>(1), close_all(std::span{ handles }));
+
+			Assert::AreEqual(static_cast<size_t>(1), deleter.called());
+			Assert::IsFalse(outside.valid());
+		}
+	};
+}
@@ -0,0 +1,114 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include "MockDeleter.h"
+#include <WinHandle.h>
+#include <atomic>
+#include <thread>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+
+namespace Concurrent
+{
+	// Stateless deleter counting the number of calls from any thread
+	struct CountingDeleter
+	{
+		inline static std::atomic<size_t> calls = 0;
+
+		BOOL operator()(HANDLE) const noexcept
+		{
+			++calls;
+			return TRUE;
+		}
+	};
+
+	TEST_CLASS(ConcurrentHandleTests)
+	{
+	public:
+		inline static const HANDLE Handle1 = reinterpret_cast<HANDLE>(1234);
+		inline static const HANDLE Handle2 = reinterpret_cast<HANDLE>(4321);
+
+		using handle_type = std::remove_cv_t<decltype(Handle1)>;
+		using winhandle_type = WinHandle<handle_type, static_cast<handle_type>(0), BOOL, HandleDeleter<handle_type, BOOL>, ConcurrentRefCount>;
+		using counted_type = WinHandle<handle_type, static_cast<handle_type>(0), BOOL, CountingDeleter, ConcurrentRefCount>;
+
+		TEST_METHOD(Lease)
+		{
+			winhandle_type h1;
+			winhandle_type h2{ Handle1, nullptr };
+
+			Assert::IsFalse(h1.lease().valid());
+			auto lease = h2.lease();
+			Assert::IsTrue(lease.valid());
+			Assert::AreEqual(Handle1, lease.get());
+		}
+
+		TEST_METHOD(Assignment)
+		{
+			MockDeleter<handle_type> deleter{ std::vector<handle_type>{ Handle1, Handle2 } };
+			winhandle_type h1{ Handle1, &MockDeleter<handle_type>::Delete, &deleter };
+			winhandle_type h2{ h1 };
+
+			h1 = Handle2;
+			Assert::AreEqual(Handle2, h2.get());
+			Assert::AreEqual(static_cast<size_t>(1), deleter.called());
+
+			h2.close();
+			Assert::IsFalse(h1.valid());
+			Assert::AreEqual(static_cast<size_t>(2), deleter.called());
+		}
+
+		TEST_METHOD(AssignmentWaitsForLeases)
+		{
+			CountingDeleter::calls = 0;
+			counted_type h1{ Handle1 };
+			counted_type h2{ h1 };
+			std::atomic<bool> replaced{ false };
+			std::thread writer;
+			{
+				auto lease = h1.lease();
+				writer = std::thread([&h2, &replaced]
+				{
+					h2 = Handle2;
+					replaced = true;
+				});
+
+				// The new value is visible at once, the old one stays open until the lease ends
+				while (h1.get() != Handle2)
+					std::this_thread::yield();
+				std::this_thread::sleep_for(std::chrono::milliseconds(10));
+				Assert::AreEqual(Handle1, lease.get());
+				Assert::IsFalse(replaced.load());
+				Assert::AreEqual(static_cast<size_t>(0), CountingDeleter::calls.load());
+			}
+			writer.join();
+			Assert::IsTrue(replaced.load());
+			Assert::AreEqual(static_cast<size_t>(1), CountingDeleter::calls.load());
+		}
+
+		TEST_METHOD(ConcurrentReadersAndWriters)
+		{
+			CountingDeleter::calls = 0;
+			{
+				counted_type h1{ Handle1 };
+				std::vector<std::thread> threads;
+				for (int t = 0; t < 4; ++t)
+				{
+					threads.emplace_back([h1, t]() mutable
+					{
+						for (int i = 0; i < 1000; ++i)
+						{
+							if (t == 0)
+								h1 = i % 2 ? Handle1 : Handle2;
+							else
+								Assert::IsTrue(h1.lease().valid());
+						}
+					});
+				}
+				for (std::thread& thread : threads)
+					thread.join();
+			}
+			Assert::AreEqual(static_cast<size_t>(1001), CountingDeleter::calls.load()); // 1000 replacements and the last value
+		}
+	};
+}
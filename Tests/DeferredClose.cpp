@@ -0,0 +1,195 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include "MockDeleter.h"
+#include <WinHandle.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+
+namespace DeferredClosing
+{
+	TEST_CLASS(DeferredClose)
+	{
+	public:
+		inline static const HANDLE Handle1 = reinterpret_cast<HANDLE>(1234);
+		inline static const HANDLE Handle2 = reinterpret_cast<HANDLE>(4321);
+
+		using handle_type = std::remove_cv_t<decltype(Handle1)>;
+		using closer_type = DeferredCloser<handle_type, BOOL>;
+		using deleter_type = DeferredDeleter<handle_type, BOOL>;
+		using winhandle_type = WinHandle<handle_type, static_cast<handle_type>(0), BOOL, deleter_type>;
+
+		inline static std::atomic<DWORD> s_closedOn{ 0 };
+
+		static BOOL __stdcall RecordThread(handle_type)
+		{
+			s_closedOn = GetCurrentThreadId();
+			return TRUE;
+		}
+
+		static BOOL __stdcall Sleep10(handle_type)
+		{
+			Sleep(10);
+			return TRUE;
+		}
+
+		static BOOL __stdcall SlowRecordThread(handle_type h)
+		{
+			Sleep(10);
+			return RecordThread(h);
+		}
+
+		// Deleter whose copies throw, as a HandleDeleter may when it allocates
+		struct ThrowingCopy
+		{
+			ThrowingCopy() = default;
+			ThrowingCopy(const ThrowingCopy&) { throw std::bad_alloc(); }
+			ThrowingCopy(ThrowingCopy&&) noexcept = default;
+
+			BOOL operator()(handle_type h) const { return RecordThread(h); }
+		};
+
+		TEST_METHOD(ClosesOnCloserThread)
+		{
+			closer_type closer;
+			s_closedOn = 0;
+			{
+				winhandle_type h{ Handle1, deleter_type{ &RecordThread, closer } };
+			}
+			closer.flush();
+
+			Assert::AreNotEqual(static_cast<DWORD>(0), s_closedOn.load());
+			Assert::AreNotEqual(GetCurrentThreadId(), s_closedOn.load());
+		}
+
+		TEST_METHOD(FlushClosesEveryHandle)
+		{
+			closer_type closer;
+			MockDeleter<handle_type> deleter{ std::vector<handle_type>{ Handle1, Handle2 } };
+			{
+				winhandle_type h1{ Handle1, deleter_type{ [&deleter](handle_type h) { return deleter.Delete(h); }, closer } };
+				winhandle_type h2{ h1 };
+				h1 = Handle2;
+			}
+			closer.flush();
+
+			Assert::AreEqual(static_cast<size_t>(2), deleter.called());
+			Assert::AreEqual(static_cast<size_t>(0), closer.pending());
+		}
+
+		TEST_METHOD(DeferredCloseReturnsDefault)
+		{
+			closer_type closer;
+			winhandle_type h{ Handle1, deleter_type{ &RecordThread, closer } };
+
+			Assert::AreEqual(FALSE, h.close());
+			Assert::IsFalse(h.valid());
+			closer.flush();
+		}
+
+		TEST_METHOD(FullQueueWaits)
+		{
+			closer_type closer{ 2 };
+			std::atomic<size_t> closed{ 0 };
+			for (int i = 1; i <= 16; ++i)
+				winhandle_type h{ reinterpret_cast<handle_type>(static_cast<INT_PTR>(i)), deleter_type{ [&closed](handle_type) { ++closed; return TRUE; }, closer } };
+
+			closer.flush();
+			Assert::AreEqual(static_cast<size_t>(16), closed.load());
+		}
+
+		TEST_METHOD(FullQueueClosesInline)
+		{
+			closer_type closer{ 2, closer_type::backpressure::close_inline };
+			s_closedOn = 0;
+			{
+				// Both slots stay occupied while the first handle is being closed
+				winhandle_type blocker1{ Handle1, deleter_type{ &Sleep10, closer } };
+				winhandle_type blocker2{ Handle1, deleter_type{ &Sleep10, closer } };
+			}
+			{
+				winhandle_type h{ Handle2, deleter_type{ &RecordThread, closer } };
+			}
+
+			Assert::AreEqual(GetCurrentThreadId(), s_closedOn.load());
+			closer.flush();
+		}
+
+		TEST_METHOD(ThresholdClosesFastHandlesInline)
+		{
+			closer_type closer{ closer_type::default_capacity, closer_type::backpressure::wait, std::chrono::milliseconds(5) };
+			s_closedOn = 0;
+			{
+				winhandle_type h{ Handle1, deleter_type{ &RecordThread, closer } };
+			}
+
+			Assert::AreEqual(GetCurrentThreadId(), s_closedOn.load());
+			Assert::AreEqual(static_cast<size_t>(0), closer.pending());
+		}
+
+		TEST_METHOD(ThresholdDefersSlowHandles)
+		{
+			closer_type closer{ closer_type::default_capacity, closer_type::backpressure::wait, std::chrono::milliseconds(1) };
+			for (int i = 0; i < 16 && closer.average_latency(&SlowRecordThread) < std::chrono::milliseconds(1); ++i)
+				winhandle_type h{ Handle1, deleter_type{ &SlowRecordThread, closer } };
+
+			s_closedOn = 0;
+			{
+				winhandle_type h{ Handle2, deleter_type{ &SlowRecordThread, closer } };
+			}
+			closer.flush();
+
+			Assert::AreNotEqual(GetCurrentThreadId(), s_closedOn.load());
+		}
+
+		TEST_METHOD(ThresholdPerDeleter)
+		{
+			closer_type closer{ closer_type::default_capacity, closer_type::backpressure::wait, std::chrono::milliseconds(1) };
+			for (int i = 0; i < 16 && closer.average_latency(&Sleep10) < std::chrono::milliseconds(1); ++i)
+				winhandle_type h{ Handle1, deleter_type{ &Sleep10, closer } };
+
+			// Other deleters are timed on their own and still closed inline
+			s_closedOn = 0;
+			{
+				winhandle_type h{ Handle2, deleter_type{ &RecordThread, closer } };
+			}
+
+			Assert::AreEqual(GetCurrentThreadId(), s_closedOn.load());
+			Assert::IsTrue(closer.average_latency(&RecordThread) < std::chrono::milliseconds(1));
+			closer.flush();
+		}
+
+		TEST_METHOD(ThrowingCopyClosesInline)
+		{
+			DeferredCloser<handle_type, BOOL, ThrowingCopy> closer;
+			s_closedOn = 0;
+
+			Assert::AreEqual(TRUE, closer.close(Handle1, ThrowingCopy{}));
+			Assert::AreEqual(GetCurrentThreadId(), s_closedOn.load());
+			Assert::AreEqual(static_cast<size_t>(0), closer.pending());
+		}
+
+		TEST_METHOD(DefaultCloser)
+		{
+			MockDeleter<handle_type> deleter{ std::vector<handle_type>{ Handle1 } };
+			{
+				winhandle_type h{ Handle1, [&deleter](handle_type h) { return deleter.Delete(h); } };
+			}
+			closer_type::instance().flush();
+
+			Assert::AreEqual(static_cast<size_t>(1), deleter.called());
+		}
+
+		TEST_METHOD(EmptyDeleter)
+		{
+			winhandle_type h{ Handle1, nullptr };
+
+			Assert::IsFalse(static_cast<bool>(deleter_type{}));
+			Assert::AreEqual(FALSE, h.close());
+		}
+	};
+}
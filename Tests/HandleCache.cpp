@@ -0,0 +1,108 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include "MockDeleter.h"
+#include <WinHandle.h>
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+
+namespace Caches
+{
+	TEST_CLASS(HandleCacheTests)
+	{
+	public:
+		using handle_type = HANDLE;
+		using winhandle_type = WinHandle<handle_type>;
+		using cache_type = HandleCache<int, winhandle_type>;
+
+		static handle_type Handle(int key)
+		{
+			return reinterpret_cast<handle_type>(static_cast<std::intptr_t>(1000 + key));
+		}
+
+		TEST_METHOD(MissOpensOnce)
+		{
+			int opened = 0;
+			const auto open = [&opened](int key) { ++opened; return winhandle_type{ Handle(key), nullptr }; };
+			cache_type cache{ 16, 4 };
+
+			winhandle_type h1 = cache.get(1, open);
+			winhandle_type h2 = cache.get(1, open);
+
+			Assert::AreEqual(1, opened);
+			Assert::AreEqual(Handle(1), h2.get());
+			Assert::AreEqual(3l, h1.use_count());
+			Assert::AreEqual(static_cast<size_t>(1), cache.size());
+		}
+
+		TEST_METHOD(EvictsLeastRecentlyUsedIdle)
+		{
+			MockDeleter<handle_type> deleter{ std::vector<handle_type>{ Handle(2), Handle(3), Handle(4), Handle(1) } };
+			const auto open = [&deleter](int key) { return winhandle_type{ Handle(key), &MockDeleter<handle_type>::Delete, &deleter }; };
+			cache_type cache{ 3, 1 };
+
+			winhandle_type h1 = cache.get(1, open); // Least recently used, but in use
+			cache.get(2, open);
+			cache.get(3, open);
+			cache.get(4, open);
+
+			Assert::AreEqual(static_cast<size_t>(1), deleter.called());
+			Assert::AreEqual(static_cast<size_t>(3), cache.size());
+			Assert::IsTrue(cache.find(1).valid());
+			Assert::IsFalse(cache.find(2).valid());
+
+			h1.reset();
+			Assert::AreEqual(static_cast<size_t>(3), cache.trim());
+		}
+
+		TEST_METHOD(InUseHandlesExceedBudget)
+		{
+			const auto open = [](int key) { return winhandle_type{ Handle(key), nullptr }; };
+			cache_type cache{ 1, 1 };
+
+			winhandle_type h1 = cache.get(1, open);
+			winhandle_type h2 = cache.get(2, open);
+			Assert::AreEqual(static_cast<size_t>(2), cache.size());
+
+			h1.reset();
+			h2.reset();
+			Assert::AreEqual(static_cast<size_t>(2), cache.trim());
+			Assert::AreEqual(static_cast<size_t>(0), cache.size());
+		}
+
+		TEST_METHOD(FailuresAreNotCached)
+		{
+			cache_type cache{ 16, 1 };
+
+			Assert::IsFalse(cache.get(1, [](int) { return winhandle_type{}; }).valid());
+			Assert::ExpectException<std::runtime_error>([&cache] { cache.get(2, [](int) -> winhandle_type { throw std::runtime_error("open"); }); });
+			Assert::AreEqual(static_cast<size_t>(0), cache.size());
+
+			Assert::IsTrue(cache.get(1, [](int key) { return winhandle_type{ Handle(key), nullptr }; }).valid());
+		}
+
+		TEST_METHOD(ConcurrentMissesOpenOnce)
+		{
+			std::atomic<int> opened{ 0 };
+			const auto open = [&opened](int key)
+			{
+				++opened;
+				std::this_thread::sleep_for(std::chrono::milliseconds(10));
+				return winhandle_type{ Handle(key), nullptr };
+			};
+			cache_type cache{ 16, 4 };
+
+			std::vector<std::thread> threads;
+			for (int i = 0; i < 8; ++i)
+				threads.emplace_back([&cache, &open] { Assert::AreEqual(Handle(1), cache.get(1, open).get()); });
+			for (std::thread& thread : threads)
+				thread.join();
+
+			Assert::AreEqual(1, opened.load());
+		}
+	};
+}
@@ -0,0 +1,109 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include "AllocationCounter.h"
+#include <WinHandle.h>
+#include <array>
+#include <memory>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+
+namespace HandleDeleters
+{
+	TEST_CLASS(HandleDeleter)
+	{
+	public:
+		inline static const HANDLE Handle1 = reinterpret_cast<HANDLE>(1234);
+
+		using handle_type = std::remove_cv_t<decltype(Handle1)>;
+		using deleter_type = ::HandleDeleter<handle_type, BOOL>;
+
+		static BOOL __stdcall fp0(handle_type h)
+		{
+			Assert::AreEqual(Handle1, h);
+			return TRUE;
+		}
+
+		TEST_METHOD(Empty)
+		{
+			deleter_type d1;
+			deleter_type d2{ nullptr };
+			deleter_type d3{ std::function<BOOL(handle_type)>{} };
+			deleter_type d4{ static_cast<BOOL(__stdcall*)(handle_type)>(nullptr) };
+
+			Assert::IsFalse(static_cast<bool>(d1));
+			Assert::IsFalse(static_cast<bool>(d2));
+			Assert::IsFalse(static_cast<bool>(d3));
+			Assert::IsFalse(static_cast<bool>(d4));
+		}
+
+		TEST_METHOD(FunctionPointer)
+		{
+			AllocationCounter counter;
+			deleter_type d1{ &fp0 };
+
+			Assert::IsTrue(static_cast<bool>(d1));
+			Assert::AreEqual(TRUE, d1(Handle1));
+			Assert::AreEqual(static_cast<size_t>(0), counter.allocations());
+		}
+
+		TEST_METHOD(Lambda)
+		{
+			int calls = 0;
+			deleter_type d1{ [&calls](handle_type) -> BOOL { ++calls; return TRUE; } };
+
+			d1(Handle1);
+			Assert::AreEqual(1, calls);
+		}
+
+		TEST_METHOD(CopyAndMove)
+		{
+			auto counter = std::make_shared<int>(0);
+			deleter_type d1{ [counter](handle_type) -> BOOL { ++*counter; return TRUE; } };
+			Assert::AreEqual(2l, counter.use_count());
+
+			deleter_type d2{ d1 };
+			Assert::AreEqual(3l, counter.use_count());
+
+			deleter_type d3{ std::move(d1) };
+			Assert::IsFalse(static_cast<bool>(d1));
+			Assert::AreEqual(3l, counter.use_count());
+
+			d2 = nullptr;
+			Assert::AreEqual(2l, counter.use_count());
+
+			d3(Handle1);
+			Assert::AreEqual(1, *counter);
+		}
+
+		TEST_METHOD(LargeCallable)
+		{
+			// Callables exceeding the inline storage are still supported, but allocate
+			std::array<char, deleter_type::inline_size + 1> payload{};
+			payload[0] = 42;
+			auto large = [payload](handle_type) -> BOOL { return payload[0]; };
+			static_assert(!deleter_type::stored_inline<decltype(large)>);
+
+			deleter_type d1{ large };
+			deleter_type d2{ d1 };
+			deleter_type d3{ std::move(d1) };
+
+			Assert::AreEqual(42, d2(Handle1));
+			Assert::AreEqual(42, d3(Handle1));
+		}
+
+		TEST_METHOD(Target)
+		{
+			using function_type = BOOL(__stdcall*)(handle_type);
+
+			deleter_type d1{ &fp0 };
+			deleter_type d2{ [](handle_type) -> BOOL { return TRUE; } };
+			deleter_type d3;
+
+			Assert::IsNotNull(d1.target<function_type>());
+			Assert::IsTrue(*d1.target<function_type>() == &fp0);
+			Assert::IsNull(d2.target<function_type>());
+			Assert::IsNull(d3.target<function_type>());
+		}
+	};
+}
@@ -0,0 +1,155 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include "AllocationCounter.h"
+#include "MockDeleter.h"
+#include <WinHandle.h>
+#include <atomic>
+#include <memory_resource>
+#include <thread>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+
+namespace Pools
+{
+	// Memory resource counting the blocks it hands out
+	class CountingResource : public std::pmr::memory_resource
+	{
+	public:
+		size_t allocated() const noexcept { return m_allocated; }
+		size_t outstanding() const noexcept { return m_allocated - m_deallocated; }
+
+	private:
+		void* do_allocate(size_t bytes, size_t alignment) override
+		{
+			++m_allocated;
+			return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+		}
+
+		void do_deallocate(void* p, size_t bytes, size_t alignment) override
+		{
+			++m_deallocated;
+			std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+		}
+
+		bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+		{
+			return this == &other;
+		}
+
+		size_t m_allocated{ 0 };
+		size_t m_deallocated{ 0 };
+	};
+
+	TEST_CLASS(AllocateHandle)
+	{
+	public:
+		inline static const HANDLE Handle1 = reinterpret_cast<HANDLE>(1234);
+		inline static const HANDLE Handle2 = reinterpret_cast<HANDLE>(4321);
+
+		using handle_type = std::remove_cv_t<decltype(Handle1)>;
+		using winhandle_type = WinHandle<handle_type>;
+
+		TEST_METHOD(UsesResource)
+		{
+			CountingResource resource;
+			MockDeleter<handle_type> deleter{ std::vector<handle_type>{ Handle1 } };
+			{
+				winhandle_type h1 = allocate_handle<winhandle_type>(&resource, Handle1, [&deleter](handle_type h) { return deleter.Delete(h); });
+				winhandle_type h2{ h1 };
+
+				Assert::AreEqual(static_cast<size_t>(1), resource.allocated());
+				Assert::AreEqual(Handle1, h2.get());
+				Assert::AreEqual(2l, h1.use_count());
+			}
+			Assert::AreEqual(static_cast<size_t>(1), deleter.called());
+			Assert::AreEqual(static_cast<size_t>(0), resource.outstanding());
+		}
+
+		TEST_METHOD(ResetKeepsResource)
+		{
+			CountingResource resource;
+			MockDeleter<handle_type> deleter{ std::vector<handle_type>{ Handle1, Handle2 } };
+			{
+				winhandle_type h1 = allocate_handle<winhandle_type>(&resource, Handle1, [&deleter](handle_type h) { return deleter.Delete(h); });
+				winhandle_type h2{ h1 };
+
+				h1.reset(Handle2);
+				Assert::AreEqual(static_cast<size_t>(2), resource.allocated());
+				Assert::AreEqual(static_cast<size_t>(0), deleter.called());
+			}
+			Assert::AreEqual(static_cast<size_t>(2), deleter.called());
+			Assert::AreEqual(static_cast<size_t>(0), resource.outstanding());
+		}
+
+		TEST_METHOD(NoGlobalAllocation)
+		{
+			CountingResource resource;
+
+			AllocationCounter counter;
+			winhandle_type h1 = allocate_handle<winhandle_type>(&resource, Handle1, nullptr);
+
+			Assert::AreEqual(static_cast<size_t>(0), counter.allocations());
+			Assert::AreEqual(Handle1, h1.get());
+		}
+	};
+
+	TEST_CLASS(HandlePool)
+	{
+	public:
+		inline static const HANDLE Handle1 = reinterpret_cast<HANDLE>(1234);
+
+		using handle_type = std::remove_cv_t<decltype(Handle1)>;
+		using winhandle_type = WinHandle<handle_type>;
+
+		TEST_METHOD(SharedPerHandleType)
+		{
+			Assert::IsTrue(winhandle_type::pool() == winhandle_type::pool());
+			Assert::IsTrue(winhandle_type::pool()->is_equal(*winhandle_type::pool()));
+		}
+
+		TEST_METHOD(ReusesBlocks)
+		{
+			winhandle_type h1 = allocate_handle<winhandle_type>(winhandle_type::pool(), Handle1, nullptr);
+			const handle_type* block = std::as_const(h1).ptr();
+			h1 = winhandle_type{};
+
+			AllocationCounter counter;
+			winhandle_type h2 = allocate_handle<winhandle_type>(winhandle_type::pool(), Handle1, nullptr);
+
+			Assert::AreEqual(static_cast<size_t>(0), counter.allocations());
+			Assert::IsTrue(block == std::as_const(h2).ptr());
+		}
+
+		TEST_METHOD(OversizedRequests)
+		{
+			std::pmr::memory_resource* pool = winhandle_type::pool();
+			void* p = pool->allocate(4096);
+			pool->deallocate(p, 4096);
+		}
+
+		TEST_METHOD(ConcurrentChurn)
+		{
+			std::atomic<size_t> closed{ 0 };
+			std::vector<std::thread> threads;
+			for (int t = 0; t < 4; ++t)
+			{
+				threads.emplace_back([&closed]()
+				{
+					std::vector<winhandle_type> handles;
+					for (int round = 0; round < 50; ++round)
+					{
+						for (int i = 0; i < 100; ++i)
+							handles.push_back(allocate_handle<winhandle_type>(winhandle_type::pool(), Handle1, [&closed](handle_type) { ++closed; return TRUE; }));
+						handles.clear();
+					}
+				});
+			}
+			for (std::thread& thread : threads)
+				thread.join();
+
+			Assert::AreEqual(static_cast<size_t>(4 * 50 * 100), closed.load());
+		}
+	};
+}
@@ -0,0 +1,118 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include "MockDeleter.h"
+#include <WinHandle.h>
+#include <string>
+#include <unordered_set>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+
+namespace Tables
+{
+	TEST_CLASS(HandleHash)
+	{
+	public:
+		inline static const HANDLE Handle1 = reinterpret_cast<HANDLE>(1234);
+
+		using handle_type = std::remove_cv_t<decltype(Handle1)>;
+		using winhandle_type = WinHandle<handle_type>;
+
+		TEST_METHOD(HashOfRawValue)
+		{
+			winhandle_type h1{ Handle1, nullptr };
+
+			Assert::AreEqual(std::hash<handle_type>{}(Handle1), std::hash<winhandle_type>{}(h1));
+		}
+
+		TEST_METHOD(TransparentLookup)
+		{
+			std::unordered_set<winhandle_type, std::hash<winhandle_type>, std::equal_to<>> handles;
+			handles.emplace(Handle1, nullptr);
+
+			Assert::IsTrue(handles.find(Handle1) != handles.end());
+		}
+	};
+
+	TEST_CLASS(HandleTableTests)
+	{
+	public:
+		inline static const HANDLE Handle1 = reinterpret_cast<HANDLE>(1234);
+		inline static const HANDLE Handle2 = reinterpret_cast<HANDLE>(4321);
+
+		using handle_type = std::remove_cv_t<decltype(Handle1)>;
+		using winhandle_type = WinHandle<handle_type>;
+
+		TEST_METHOD(EmplaceAndFind)
+		{
+			HandleTable<handle_type, int> table;
+			Assert::IsNull(table.find(Handle1));
+
+			auto [value, inserted] = table.emplace(Handle1, 42);
+			Assert::IsTrue(inserted);
+			Assert::AreEqual(42, *value);
+			Assert::IsFalse(table.emplace(Handle1, 43).second);
+
+			Assert::AreEqual(42, *table.find(Handle1));
+			Assert::IsNull(table.find(Handle2));
+			Assert::AreEqual(static_cast<size_t>(1), table.size());
+		}
+
+		TEST_METHOD(Erase)
+		{
+			HandleTable<handle_type, int> table;
+			table.emplace(Handle1, 1);
+			table.emplace(Handle2, 2);
+
+			Assert::IsTrue(table.erase(Handle1));
+			Assert::IsFalse(table.erase(Handle1));
+			Assert::IsFalse(table.contains(Handle1));
+			Assert::IsTrue(table.contains(Handle2));
+			Assert::AreEqual(static_cast<size_t>(1), table.size());
+		}
+
+		TEST_METHOD(Growth)
+		{
+			HandleTable<int, std::string> table;
+			for (int i = 0; i < 10000; ++i)
+				table.emplace(i * 4, std::to_string(i));
+			for (int i = 0; i < 10000; i += 2)
+				table.erase(i * 4);
+
+			Assert::AreEqual(static_cast<size_t>(5000), table.size());
+			for (int i = 0; i < 10000; ++i)
+			{
+				const std::string* value = table.find(i * 4);
+				if (i % 2)
+					Assert::AreEqual(std::to_string(i), *value);
+				else
+					Assert::IsNull(value);
+			}
+		}
+
+		TEST_METHOD(LookupByHandle)
+		{
+			MockDeleter<handle_type> deleter{ std::vector<handle_type>{ Handle1 } };
+			{
+				winhandle_type h1{ Handle1, &MockDeleter<handle_type>::Delete, &deleter };
+				HandleTable<handle_type, winhandle_type> table;
+				table.emplace(h1.get(), h1);
+
+				Assert::IsNotNull(table.find(h1));
+				Assert::AreEqual(2l, h1.use_count());
+			}
+			Assert::AreEqual(static_cast<size_t>(1), deleter.called());
+		}
+
+		TEST_METHOD(ForEach)
+		{
+			HandleTable<handle_type, int> table;
+			table.emplace(Handle1, 1);
+			table.emplace(Handle2, 2);
+
+			int sum = 0;
+			table.for_each([&sum](handle_type, int& value) { sum += value; });
+			Assert::AreEqual(3, sum);
+		}
+	};
+}
@@ -0,0 +1,103 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include "Specializations.h"
+#include <WinHandle.h>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+
+namespace Traits
+{
+	struct kernel_tag {};
+
+	inline size_t s_calls = 0;
+	inline HANDLE s_last = nullptr;
+}
+
+// Kernel object handle where both NULL and INVALID_HANDLE_VALUE mean no handle
+template<>
+struct handle_traits<Traits::kernel_tag>
+{
+	using type = HANDLE;
+	using result_type = BOOL;
+	static constexpr HANDLE null_value = nullptr;
+
+	static BOOL close(HANDLE h) noexcept
+	{
+		++Traits::s_calls;
+		Traits::s_last = h;
+		return TRUE;
+	}
+
+	static bool is_null(HANDLE h) noexcept
+	{
+		return h == INVALID_HANDLE_VALUE;
+	}
+};
+
+namespace Traits
+{
+	TEST_CLASS(HandleTraits)
+	{
+	public:
+		inline static const HANDLE Handle1 = reinterpret_cast<HANDLE>(1234);
+		inline static const HANDLE Handle2 = reinterpret_cast<HANDLE>(4321);
+
+		using winhandle_type = WinHandleFor<kernel_tag>;
+		using unique_type = UniqueWinHandleFor<kernel_tag>;
+
+		TEST_METHOD_INITIALIZE(Initialize)
+		{
+			s_calls = 0;
+			s_last = nullptr;
+		}
+
+		TEST_METHOD(Types)
+		{
+			static_assert(std::is_same_v<winhandle_type::element_type, HANDLE>);
+			static_assert(std::is_empty_v<winhandle_type::deleter_type>);
+			static_assert(sizeof(unique_type) == sizeof(HANDLE));
+		}
+
+		TEST_METHOD(Ownership)
+		{
+			{
+				winhandle_type h1{ Handle1 };
+				winhandle_type h2{ h1 };
+				Assert::IsTrue(h2.valid());
+			}
+			Assert::AreEqual(static_cast<size_t>(1), s_calls);
+			Assert::AreEqual(Handle1, s_last);
+		}
+
+		TEST_METHOD(NonOwning)
+		{
+			{
+				winhandle_type h1{ Handle1, nullptr };
+				Assert::AreEqual(FALSE, h1.close());
+				Assert::IsFalse(h1.valid());
+			}
+			Assert::AreEqual(static_cast<size_t>(0), s_calls);
+		}
+
+		TEST_METHOD(Unique)
+		{
+			{
+				unique_type h1{ Handle1 };
+				h1 = Handle2;
+				Assert::AreEqual(Handle1, s_last);
+			}
+			Assert::AreEqual(static_cast<size_t>(2), s_calls);
+			Assert::AreEqual(Handle2, s_last);
+		}
+
+		TEST_METHOD(AlternateNullValue)
+		{
+			{
+				winhandle_type h1{ INVALID_HANDLE_VALUE };
+				Assert::AreEqual(FALSE, h1.close());
+			}
+			Assert::AreEqual(static_cast<size_t>(0), s_calls);
+		}
+	};
+}
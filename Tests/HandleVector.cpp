@@ -0,0 +1,119 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include "MockDeleter.h"
+#include <WinHandle.h>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+
+namespace Vectors
+{
+	TEST_CLASS(HandleVectorTests)
+	{
+	public:
+		inline static const HANDLE Handle1 = reinterpret_cast<HANDLE>(1234);
+		inline static const HANDLE Handle2 = reinterpret_cast<HANDLE>(4321);
+		inline static const HANDLE Handle3 = reinterpret_cast<HANDLE>(5678);
+
+		using handle_type = std::remove_cv_t<decltype(Handle1)>;
+		using vector_type = HandleVector<handle_type>;
+
+		static vector_type Vector(MockDeleter<handle_type>& deleter)
+		{
+			return vector_type{ [&deleter](handle_type h) { return deleter.Delete(h); } };
+		}
+
+		TEST_METHOD(Size)
+		{
+			static_assert(sizeof(HandleVector<handle_type, static_cast<handle_type>(0), int, StaticDeleter<&CloseHandle>>) == sizeof(std::vector<handle_type>));
+			static_assert(!std::is_copy_constructible_v<vector_type>);
+			static_assert(std::is_nothrow_move_constructible_v<vector_type>);
+		}
+
+		TEST_METHOD(DestructorClosesAll)
+		{
+			MockDeleter<handle_type> deleter{ std::vector<handle_type>{ Handle1, Handle2 } };
+			{
+				vector_type handles = Vector(deleter);
+				handles.push_back(Handle1);
+				handles.push_back(Handle2);
+				Assert::AreEqual(static_cast<size_t>(2), handles.size());
+			}
+			Assert::AreEqual(static_cast<size_t>(2), deleter.called());
+		}
+
+		TEST_METHOD(Close)
+		{
+			MockDeleter<handle_type> deleter{ std::vector<handle_type>{ Handle1, Handle2 } };
+			vector_type handles = Vector(deleter);
+			handles.push_back(Handle1);
+			handles.push_back(Handle2);
+
+			handles.close(0);
+			Assert::AreEqual(static_cast<size_t>(1), deleter.called());
+			Assert::IsFalse(handles.valid(0));
+			Assert::IsTrue(handles.valid(1));
+
+			handles.close(0);
+			Assert::AreEqual(static_cast<size_t>(1), deleter.called());
+		}
+
+		TEST_METHOD(Release)
+		{
+			MockDeleter<handle_type> deleter{ std::vector<handle_type>{}, false };
+			{
+				vector_type handles = Vector(deleter);
+				handles.push_back(Handle1);
+
+				Assert::IsTrue(Handle1 == handles.release(0));
+				Assert::IsFalse(handles.valid(0));
+			}
+			Assert::AreEqual(static_cast<size_t>(0), deleter.called());
+		}
+
+		TEST_METHOD(Extract)
+		{
+			MockDeleter<handle_type> deleter{ std::vector<handle_type>{ Handle1 } };
+			vector_type handles = Vector(deleter);
+			handles.push_back(Handle1);
+			{
+				WinHandle<handle_type> h1 = handles.extract(0);
+				Assert::IsTrue(Handle1 == h1.get());
+				Assert::IsFalse(handles.valid(0));
+				Assert::AreEqual(static_cast<size_t>(0), deleter.called());
+			}
+			Assert::AreEqual(static_cast<size_t>(1), deleter.called());
+		}
+
+		TEST_METHOD(CloseAll)
+		{
+			MockDeleter<handle_type> deleter{ std::vector<handle_type>{ Handle1, Handle3 } };
+			vector_type handles = Vector(deleter);
+			handles.push_back(Handle1);
+			handles.push_back(Handle2);
+			handles.push_back(Handle3);
+			handles.release(1);
+
+			std::vector<int> results(3, -1);
+			Assert::AreEqual(static_cast<size_t>(2), handles.close_all(results));
+			Assert::AreEqual(static_cast<size_t>(2), deleter.called());
+			Assert::AreEqual(0, results[1]);
+			Assert::AreEqual(static_cast<size_t>(3), handles.size());
+			Assert::AreEqual(static_cast<size_t>(0), handles.count_valid());
+		}
+
+		TEST_METHOD(Scans)
+		{
+			HandleVector<int, -1> handles{ nullptr };
+			for (int i = 0; i < 100; ++i)
+				handles.push_back(i);
+			for (size_t i = 0; i < 100; i += 3)
+				handles.release(i);
+
+			Assert::AreEqual(static_cast<size_t>(66), handles.count_valid());
+			Assert::AreEqual(static_cast<size_t>(1), handles.next_valid(0));
+			Assert::AreEqual(static_cast<size_t>(4), handles.next_valid(3));
+			Assert::AreEqual(handles.size(), handles.next_valid(100));
+		}
+	};
+}
@@ -0,0 +1,81 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include "MockDeleter.h"
+#include <WinHandle.h>
+#include <unordered_set>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+
+namespace Views
+{
+	TEST_CLASS(HandleViewTests)
+	{
+	public:
+		inline static const HANDLE Handle1 = reinterpret_cast<HANDLE>(1234);
+		inline static const HANDLE Handle2 = reinterpret_cast<HANDLE>(4321);
+
+		using handle_type = std::remove_cv_t<decltype(Handle1)>;
+		using view_type = HandleView<handle_type>;
+
+		// Function using a handle without owning it
+		static handle_type Use(view_type handle)
+		{
+			return handle.get();
+		}
+
+		TEST_METHOD(Traits)
+		{
+			static_assert(std::is_trivially_copyable_v<view_type>);
+			static_assert(sizeof(view_type) == sizeof(handle_type));
+			static_assert(!std::is_convertible_v<WinHandle<handle_type, INVALID_HANDLE_VALUE>, view_type>);
+		}
+
+		TEST_METHOD(DefaultConstructor)
+		{
+			view_type v1;
+
+			Assert::IsFalse(v1.valid());
+			Assert::IsFalse(static_cast<bool>(v1));
+			Assert::AreEqual(static_cast<handle_type>(0), v1.get());
+		}
+
+		TEST_METHOD(FromHandles)
+		{
+			MockDeleter<handle_type> deleter{ std::vector<handle_type>{ Handle1 } };
+			WinHandle<handle_type> h1{ Handle1, &MockDeleter<handle_type>::Delete, &deleter };
+			UniqueWinHandle<handle_type, static_cast<handle_type>(0), BOOL> h2{ Handle2, [](handle_type) { return TRUE; } };
+
+			Assert::AreEqual(Handle1, Use(h1));
+			Assert::AreEqual(Handle2, Use(h2));
+			Assert::AreEqual(Handle2, Use(Handle2));
+
+			// Views do not take part in reference counting
+			view_type v1 = h1;
+			Assert::AreEqual(1l, h1.use_count());
+			Assert::IsTrue(v1.valid());
+		}
+
+		TEST_METHOD(Comparison)
+		{
+			const WinHandle<handle_type> h1{ Handle1, nullptr };
+			const view_type v1 = h1;
+			const view_type v2{ Handle2 };
+
+			Assert::IsTrue(v1 == h1);
+			Assert::IsTrue(h1 == v1);
+			Assert::IsTrue(v1 == Handle1);
+			Assert::IsTrue(v1 != v2);
+			Assert::IsTrue(v1 < v2);
+			Assert::IsTrue(v2 >= h1);
+		}
+
+		TEST_METHOD(Hash)
+		{
+			std::unordered_set<view_type> views{ view_type{ Handle1 }, view_type{ Handle2 } };
+
+			Assert::AreEqual(static_cast<size_t>(1), views.count(view_type{ Handle1 }));
+			Assert::AreEqual(std::hash<handle_type>{}(Handle1), std::hash<view_type>{}(Handle1));
+		}
+	};
+}
@@ -0,0 +1,171 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include "AllocationCounter.h"
+#include "MockDeleter.h"
+#include <WinHandle.h>
+#include <span>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+
+namespace OutParameters
+{
+	// Stateless deleter counting the number of calls
+	struct CountingDeleter
+	{
+		inline static size_t calls = 0;
+
+		BOOL operator()(HANDLE) const noexcept
+		{
+			++calls;
+			return TRUE;
+		}
+	};
+
+	TEST_CLASS(MutableHandlesTests)
+	{
+	public:
+		inline static const HANDLE Handle1 = reinterpret_cast<HANDLE>(1234);
+		inline static const HANDLE Handle2 = reinterpret_cast<HANDLE>(4321);
+		inline static const HANDLE Handle3 = reinterpret_cast<HANDLE>(5678);
+
+		using handle_type = std::remove_cv_t<decltype(Handle1)>;
+		using winhandle_type = WinHandle<handle_type, static_cast<handle_type>(0), BOOL>;
+		using counted_type = WinHandle<handle_type, static_cast<handle_type>(0), BOOL, CountingDeleter>;
+		using unique_type = UniqueWinHandle<handle_type, static_cast<handle_type>(0), BOOL, CountingDeleter>;
+
+		// Produces a pair of handles through one array, like CreatePipe or socketpair
+		static BOOL CreatePair(handle_type* pair)
+		{
+			pair[0] = Handle1;
+			pair[1] = Handle2;
+			return TRUE;
+		}
+
+		TEST_METHOD(FillsAllHandles)
+		{
+			MockDeleter<handle_type> deleter{ std::vector<handle_type>{ Handle3, Handle2, Handle1 } };
+			winhandle_type h1{ Handle3, &MockDeleter<handle_type>::Delete, &deleter };
+			winhandle_type h2{ &MockDeleter<handle_type>::Delete, &deleter };
+
+			AllocationCounter counter;
+			Assert::IsTrue(CreatePair(ptrs(h1, h2)));
+
+			Assert::AreEqual(static_cast<size_t>(0), counter.allocations());
+			Assert::AreEqual(Handle1, h1.get());
+			Assert::AreEqual(Handle2, h2.get());
+			Assert::AreEqual(static_cast<size_t>(1), deleter.called());
+		}
+
+		TEST_METHOD(SharedHandlesDetach)
+		{
+			CountingDeleter::calls = 0;
+			counted_type h1{ Handle3 };
+			counted_type h2;
+			counted_type copy{ h1 };
+
+			CreatePair(ptrs(h1, h2));
+
+			Assert::AreEqual(Handle1, h1.get());
+			Assert::AreEqual(Handle2, h2.get());
+			Assert::AreEqual(Handle3, copy.get());
+			Assert::AreEqual(static_cast<size_t>(0), CountingDeleter::calls);
+		}
+
+		TEST_METHOD(UniqueHandles)
+		{
+			CountingDeleter::calls = 0;
+			{
+				unique_type h1;
+				unique_type h2;
+
+				CreatePair(ptrs(h1, h2));
+
+				Assert::AreEqual(Handle1, h1.get());
+				Assert::AreEqual(Handle2, h2.get());
+			}
+			Assert::AreEqual(static_cast<size_t>(2), CountingDeleter::calls);
+		}
+
+		TEST_METHOD(Span)
+		{
+			counted_type h1;
+			counted_type h2;
+			counted_type h3;
+			{
+				auto out = ptrs(h1, h2, h3);
+				std::span<handle_type> values = out;
+
+				Assert::AreEqual(static_cast<size_t>(3), values.size());
+				values[2] = Handle3;
+
+				// Nothing is stored before the out parameter is destroyed
+				Assert::IsFalse(h3.valid());
+			}
+			Assert::IsFalse(h1.valid());
+			Assert::AreEqual(Handle3, h3.get());
+		}
+
+		TEST_METHOD(Cancel)
+		{
+			CountingDeleter::calls = 0;
+			counted_type h1{ Handle3 };
+			counted_type h2;
+			{
+				auto out = ptrs(h1, h2);
+				CreatePair(out);
+				out.cancel();
+			}
+			Assert::AreEqual(Handle3, h1.get());
+			Assert::IsFalse(h2.valid());
+			Assert::AreEqual(static_cast<size_t>(0), CountingDeleter::calls);
+		}
+
+		TEST_METHOD(AcquireGroups)
+		{
+			CountingDeleter::calls = 0;
+			std::vector<counted_type> handles(7);
+
+			// The last handle does not make a full group
+			Assert::AreEqual(static_cast<size_t>(3), acquire_groups<2>(std::span(handles), &CreatePair));
+			for (size_t i = 0; i < 6; ++i)
+				Assert::AreEqual(i % 2 ? Handle2 : Handle1, handles[i].get());
+			Assert::IsFalse(handles[6].valid());
+
+			// Reacquiring keeps the control blocks and closes the previous handles
+			AllocationCounter counter;
+			const auto createOther = [](handle_type* pair)
+			{
+				pair[0] = Handle3;
+				pair[1] = Handle3;
+				return true;
+			};
+			Assert::AreEqual(static_cast<size_t>(3), acquire_groups<2>(std::span(handles), createOther));
+			Assert::AreEqual(static_cast<size_t>(0), counter.allocations());
+			Assert::AreEqual(static_cast<size_t>(6), CountingDeleter::calls);
+		}
+
+		TEST_METHOD(AcquireGroupsStopsOnFailure)
+		{
+			std::vector<counted_type> handles(6);
+			size_t calls = 0;
+
+			const size_t groups = acquire_groups<2>(std::span(handles), [&calls](handle_type* pair)
+			{
+				if (++calls == 2)
+				{
+					pair[0] = Handle3; // Written despite the failure
+					return false;
+				}
+				return static_cast<bool>(CreatePair(pair));
+			});
+
+			Assert::AreEqual(static_cast<size_t>(1), groups);
+			Assert::AreEqual(static_cast<size_t>(2), calls);
+			Assert::AreEqual(Handle1, handles[0].get());
+			Assert::IsFalse(handles[2].valid());
+			Assert::IsFalse(handles[4].valid());
+		}
+	};
+}
@@ -0,0 +1,89 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include "MockDeleter.h"
+#include <WinHandle.h>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+
+namespace RefCounts
+{
+	TEST_CLASS(LocalRefCount)
+	{
+	public:
+		inline static const HANDLE Handle1 = reinterpret_cast<HANDLE>(1234);
+		inline static const HANDLE Handle2 = reinterpret_cast<HANDLE>(4321);
+
+		using handle_type = std::remove_cv_t<decltype(Handle1)>;
+		using winhandle_type = WinHandle<handle_type, static_cast<handle_type>(0), BOOL, HandleDeleter<handle_type, BOOL>, ::LocalRefCount>;
+
+		TEST_METHOD(DefaultIsAtomic)
+		{
+			static_assert(std::is_same_v<WinHandle<handle_type>::refcount_type, AtomicRefCount>);
+			static_assert(std::is_same_v<winhandle_type::refcount_type, ::LocalRefCount>);
+		}
+
+		TEST_METHOD(UseCount)
+		{
+			winhandle_type h1{ Handle1, nullptr };
+			Assert::AreEqual(1l, h1.use_count());
+			{
+				winhandle_type h2{ h1 };
+				Assert::AreEqual(2l, h1.use_count());
+				Assert::AreEqual(2l, h2.use_count());
+			}
+			Assert::AreEqual(1l, h1.use_count());
+		}
+
+		TEST_METHOD(CopyAssignment)
+		{
+			MockDeleter<handle_type> deleter{ std::vector<handle_type>{ Handle2, Handle1 } };
+			winhandle_type h1{ Handle1, &MockDeleter<handle_type>::Delete, &deleter };
+			winhandle_type h2{ Handle2, &MockDeleter<handle_type>::Delete, &deleter };
+
+			h2 = h1;
+			Assert::AreEqual(static_cast<size_t>(1), deleter.called());
+			Assert::AreEqual(Handle1, h2.get());
+			Assert::AreEqual(2l, h1.use_count());
+
+			h1.reset();
+			h2.reset();
+			Assert::AreEqual(static_cast<size_t>(2), deleter.called());
+		}
+
+		TEST_METHOD(Swap)
+		{
+			winhandle_type h1{ Handle1, nullptr };
+			winhandle_type h2{ Handle2, nullptr };
+			winhandle_type h3{ h2 };
+
+			h1.swap(h2);
+
+			Assert::AreEqual(Handle2, h1.get());
+			Assert::AreEqual(Handle1, h2.get());
+			Assert::AreEqual(2l, h1.use_count());
+			Assert::AreEqual(1l, h2.use_count());
+		}
+
+		TEST_METHOD(Reset)
+		{
+			MockDeleter<handle_type> deleter{ std::vector<handle_type>{ Handle1, Handle2 } };
+			winhandle_type h1{ Handle1, &MockDeleter<handle_type>::Delete, &deleter };
+			winhandle_type h2{ h1 };
+
+			// Resetting one copy detaches it and leaves the shared handle open
+			h1.reset(Handle2);
+			Assert::AreEqual(static_cast<size_t>(0), deleter.called());
+			Assert::AreEqual(1l, h1.use_count());
+			Assert::AreEqual(1l, h2.use_count());
+			Assert::AreEqual(Handle1, h2.get());
+
+			h2.reset();
+			Assert::AreEqual(static_cast<size_t>(1), deleter.called());
+
+			h1.reset();
+			Assert::AreEqual(static_cast<size_t>(2), deleter.called());
+		}
+	};
+}
@@ -0,0 +1,157 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include "AllocationCounter.h"
+#include <WinHandle.h>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+
+namespace Relocation
+{
+	// Stateless deleter counting the number of calls
+	struct CountingDeleter
+	{
+		inline static size_t calls = 0;
+
+		BOOL operator()(HANDLE) const noexcept
+		{
+			++calls;
+			return TRUE;
+		}
+	};
+
+	TEST_CLASS(SmallHandleVectorTests)
+	{
+	public:
+		inline static const HANDLE Handle1 = reinterpret_cast<HANDLE>(1234);
+		inline static const HANDLE Handle2 = reinterpret_cast<HANDLE>(4321);
+		inline static const HANDLE Handle3 = reinterpret_cast<HANDLE>(5678);
+
+		using handle_type = std::remove_cv_t<decltype(Handle1)>;
+		using winhandle_type = WinHandle<handle_type, static_cast<handle_type>(0), BOOL, CountingDeleter>;
+		using unique_type = UniqueWinHandle<handle_type, static_cast<handle_type>(0), BOOL, CountingDeleter>;
+		using vector_type = SmallHandleVector<winhandle_type, 2>;
+
+		TEST_METHOD(Traits)
+		{
+			static_assert(is_trivially_relocatable_v<handle_type>);
+			static_assert(is_trivially_relocatable_v<winhandle_type>);
+			static_assert(is_trivially_relocatable_v<WinHandle<handle_type>>);
+			static_assert(is_trivially_relocatable_v<unique_type>);
+			static_assert(is_trivially_relocatable_v<UniqueWinHandle<handle_type, static_cast<handle_type>(0), BOOL, StaticDeleter<&CloseHandle>>>);
+
+			// The default deleter stores callables inline, which may refer to themselves
+			static_assert(!is_trivially_relocatable_v<UniqueWinHandle<handle_type>>);
+		}
+
+		TEST_METHOD(Growth)
+		{
+			CountingDeleter::calls = 0;
+			{
+				vector_type handles;
+				winhandle_type h1{ Handle1 };
+				for (size_t i = 0; i < 100; ++i)
+					handles.push_back(h1);
+
+				Assert::IsFalse(handles.is_inline());
+				Assert::AreEqual(static_cast<size_t>(100), handles.size());
+				Assert::AreEqual(101l, h1.use_count());
+				for (const winhandle_type& handle : handles)
+					Assert::AreEqual(Handle1, handle.get());
+				Assert::AreEqual(static_cast<size_t>(0), CountingDeleter::calls);
+			}
+			Assert::AreEqual(static_cast<size_t>(1), CountingDeleter::calls);
+		}
+
+		TEST_METHOD(EmplaceFromElement)
+		{
+			vector_type handles;
+			handles.emplace_back(Handle1);
+			handles.emplace_back(Handle2);
+
+			// The vector is full, so the copy is made before the elements are relocated
+			handles.push_back(handles[0]);
+
+			Assert::AreEqual(static_cast<size_t>(3), handles.size());
+			Assert::AreEqual(Handle1, handles.back().get());
+			Assert::AreEqual(2l, handles.front().use_count());
+		}
+
+		TEST_METHOD(Erase)
+		{
+			CountingDeleter::calls = 0;
+			vector_type handles{ winhandle_type{ Handle1 }, winhandle_type{ Handle2 }, winhandle_type{ Handle3 } };
+			Assert::AreEqual(static_cast<size_t>(0), CountingDeleter::calls);
+
+			auto next = handles.erase(handles.begin());
+			Assert::AreEqual(static_cast<size_t>(1), CountingDeleter::calls);
+			Assert::AreEqual(Handle2, next->get());
+			Assert::AreEqual(static_cast<size_t>(2), handles.size());
+			Assert::AreEqual(Handle3, handles[1].get());
+
+			handles.erase(handles.begin(), handles.end());
+			Assert::AreEqual(static_cast<size_t>(3), CountingDeleter::calls);
+			Assert::IsTrue(handles.empty());
+		}
+
+		TEST_METHOD(UniqueHandles)
+		{
+			CountingDeleter::calls = 0;
+			{
+				SmallHandleVector<unique_type> handles;
+				for (size_t i = 0; i < 10; ++i)
+					handles.emplace_back(Handle1);
+				handles.pop_back();
+				Assert::AreEqual(static_cast<size_t>(1), CountingDeleter::calls);
+			}
+			Assert::AreEqual(static_cast<size_t>(10), CountingDeleter::calls);
+		}
+
+		TEST_METHOD(InlineStorage)
+		{
+			winhandle_type h1{ Handle1 };
+			vector_type handles;
+
+			AllocationCounter counter;
+			handles.push_back(h1);
+			handles.push_back(std::move(h1));
+			handles.erase(handles.begin());
+
+			Assert::IsTrue(handles.is_inline());
+			Assert::AreEqual(static_cast<size_t>(0), counter.allocations());
+		}
+
+		TEST_METHOD(Move)
+		{
+			CountingDeleter::calls = 0;
+			vector_type small{ winhandle_type{ Handle1 } };
+			vector_type large{ winhandle_type{ Handle1 }, winhandle_type{ Handle2 }, winhandle_type{ Handle3 } };
+			const winhandle_type* data = large.data();
+
+			// Allocated storage changes owners, inline elements are relocated
+			vector_type moved{ std::move(large) };
+			Assert::AreEqual(data, static_cast<const winhandle_type*>(moved.data()));
+			Assert::IsTrue(large.empty());
+
+			small.swap(moved);
+			Assert::AreEqual(static_cast<size_t>(3), small.size());
+			Assert::IsTrue(moved.is_inline());
+			Assert::AreEqual(Handle1, moved[0].get());
+
+			small = std::move(moved);
+			Assert::AreEqual(static_cast<size_t>(1), small.size());
+			Assert::AreEqual(static_cast<size_t>(3), CountingDeleter::calls);
+		}
+
+		TEST_METHOD(Copy)
+		{
+			vector_type handles{ winhandle_type{ Handle1 }, winhandle_type{ Handle2 }, winhandle_type{ Handle3 } };
+			vector_type copy{ handles };
+
+			Assert::AreEqual(static_cast<size_t>(3), copy.size());
+			Assert::AreEqual(2l, handles[2].use_count());
+			Assert::IsTrue(copy[2] == handles[2]);
+		}
+	};
+}
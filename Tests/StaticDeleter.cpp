@@ -0,0 +1,155 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include "AllocationCounter.h"
+#include <WinHandle.h>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+
+namespace Static
+{
+	TEST_CLASS(StaticDeleter)
+	{
+	public:
+		inline static const HANDLE Handle1 = reinterpret_cast<HANDLE>(1234);
+		inline static const HANDLE Handle2 = reinterpret_cast<HANDLE>(4321);
+
+		using handle_type = std::remove_cv_t<decltype(Handle1)>;
+
+		inline static size_t s_calls = 0;
+		inline static handle_type s_last = nullptr;
+
+		static BOOL __stdcall CountingClose(handle_type h)
+		{
+			++s_calls;
+			s_last = h;
+			return TRUE;
+		}
+
+		using deleter_type = ::StaticDeleter<&CountingClose>;
+		using winhandle_type = WinHandle<handle_type, static_cast<handle_type>(0), BOOL, deleter_type>;
+
+		TEST_METHOD_INITIALIZE(Initialize)
+		{
+			s_calls = 0;
+			s_last = nullptr;
+		}
+
+		TEST_METHOD(Stateless)
+		{
+			static_assert(std::is_empty_v<deleter_type>);
+			static_assert(sizeof(UniqueWinHandle<handle_type, static_cast<handle_type>(0), BOOL, deleter_type>) == sizeof(handle_type));
+		}
+
+		TEST_METHOD(RawHandleConstructor)
+		{
+			// Only deleters that release handles when default constructed take ownership of a raw handle
+			static_assert(std::is_constructible_v<winhandle_type, handle_type>);
+			static_assert(!std::is_constructible_v<WinHandle<handle_type, static_cast<handle_type>(0), BOOL>, handle_type>);
+			static_assert(std::is_constructible_v<WinHandle<handle_type, static_cast<handle_type>(0), BOOL>, handle_type, std::nullptr_t>);
+			static_assert(std::is_constructible_v<winhandle_type, handle_type, std::nullptr_t>);
+		}
+
+		TEST_METHOD(NonOwning)
+		{
+			{
+				winhandle_type h1{ Handle1, nullptr };
+				winhandle_type h2{ h1 };
+				Assert::AreEqual(Handle1, h2.get());
+			}
+			Assert::AreEqual(static_cast<size_t>(0), s_calls);
+
+			// Only the handle given to the constructor is not owned
+			{
+				winhandle_type h1{ Handle1, nullptr };
+				h1 = Handle2;
+				Assert::AreEqual(static_cast<size_t>(0), s_calls);
+			}
+			Assert::AreEqual(static_cast<size_t>(1), s_calls);
+			Assert::AreEqual(Handle2, s_last);
+		}
+
+		TEST_METHOD(Ownership)
+		{
+			{
+				winhandle_type h1{ Handle1 };
+				Assert::IsTrue(h1.valid());
+			}
+			Assert::AreEqual(static_cast<size_t>(1), s_calls);
+			Assert::AreEqual(Handle1, s_last);
+		}
+
+		TEST_METHOD(Assignment)
+		{
+			{
+				winhandle_type h1;
+				h1 = Handle1;
+				h1 = Handle2;
+
+				Assert::AreEqual(static_cast<size_t>(1), s_calls);
+				Assert::AreEqual(Handle1, s_last);
+			}
+			Assert::AreEqual(static_cast<size_t>(2), s_calls);
+			Assert::AreEqual(Handle2, s_last);
+		}
+
+		TEST_METHOD(SharedOwnership)
+		{
+			winhandle_type h1{ Handle1 };
+			{
+				winhandle_type h2{ h1 };
+				Assert::AreEqual(2l, h1.use_count());
+			}
+			Assert::AreEqual(static_cast<size_t>(0), s_calls);
+
+			h1.reset();
+			Assert::AreEqual(static_cast<size_t>(1), s_calls);
+		}
+
+		TEST_METHOD(Ptr)
+		{
+			winhandle_type h1;
+			TestPointerAssignment(h1.ptr(), Handle1);
+
+			Assert::AreEqual(Handle1, h1.get());
+			h1.close();
+			Assert::AreEqual(static_cast<size_t>(1), s_calls);
+		}
+
+		TEST_METHOD(NoImplWhenEmpty)
+		{
+			AllocationCounter counter;
+			winhandle_type h1;
+			h1.reset();
+			Assert::AreEqual(static_cast<size_t>(0), counter.allocations());
+
+			h1 = Handle1;
+			Assert::AreEqual(static_cast<size_t>(1), counter.allocations());
+
+			// The deleter is implied by the type, so reset() does not need a new impl
+			h1.reset();
+			Assert::AreEqual(static_cast<size_t>(1), counter.allocations());
+			Assert::AreEqual(static_cast<size_t>(1), s_calls);
+
+			h1 = Handle2;
+			h1.close();
+			Assert::AreEqual(static_cast<size_t>(2), s_calls);
+		}
+
+		TEST_METHOD(Promotion)
+		{
+			UniqueWinHandle<handle_type, static_cast<handle_type>(0), BOOL, deleter_type> h1{ Handle1 };
+			{
+				winhandle_type h2{ std::move(h1) };
+				Assert::AreEqual(Handle1, h2.get());
+			}
+			Assert::AreEqual(static_cast<size_t>(1), s_calls);
+		}
+
+	private:
+		void TestPointerAssignment(handle_type* h, handle_type new_value)
+		{
+			*h = new_value;
+		}
+	};
+}
@@ -0,0 +1,198 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include "MockDeleter.h"
+#include <WinHandle.h>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+
+namespace Unique
+{
+	// Stateless deleter counting the number of calls
+	struct CountingDeleter
+	{
+		inline static size_t calls = 0;
+
+		BOOL operator()(HANDLE) const noexcept
+		{
+			++calls;
+			return TRUE;
+		}
+	};
+
+	TEST_CLASS(Operations)
+	{
+	public:
+		inline static const HANDLE Handle1 = reinterpret_cast<HANDLE>(1234);
+		inline static const HANDLE Handle2 = reinterpret_cast<HANDLE>(4321);
+
+		using handle_type = std::remove_cv_t<decltype(Handle1)>;
+		using unique_type = UniqueWinHandle<handle_type, static_cast<handle_type>(0), BOOL>;
+
+		static std::function<BOOL(handle_type)> Deleter(MockDeleter<handle_type>& deleter)
+		{
+			return [&deleter](handle_type h) { return deleter.Delete(h); };
+		}
+
+		TEST_METHOD(Size)
+		{
+			static_assert(sizeof(UniqueWinHandle<handle_type, static_cast<handle_type>(0), BOOL, CountingDeleter>) == sizeof(handle_type));
+			static_assert(!std::is_copy_constructible_v<unique_type>);
+			static_assert(std::is_nothrow_move_constructible_v<unique_type>);
+		}
+
+		TEST_METHOD(DefaultConstructor)
+		{
+			unique_type h1;
+
+			Assert::IsFalse(h1.valid());
+			Assert::AreEqual(static_cast<handle_type>(0), h1.get());
+		}
+
+		TEST_METHOD(Destructor)
+		{
+			MockDeleter<handle_type> deleter{ std::vector<handle_type>{ Handle1 } };
+			{
+				unique_type h1{ Handle1, Deleter(deleter) };
+				Assert::IsTrue(h1.valid());
+			}
+			Assert::AreEqual(static_cast<size_t>(1), deleter.called());
+		}
+
+		TEST_METHOD(Close)
+		{
+			MockDeleter<handle_type> deleter{ std::vector<handle_type>{ Handle1 } };
+			unique_type h1{ Handle1, Deleter(deleter) };
+
+			h1.close();
+
+			Assert::IsFalse(h1.valid());
+			Assert::AreEqual(static_cast<size_t>(1), deleter.called());
+		}
+
+		TEST_METHOD(MoveConstructor)
+		{
+			MockDeleter<handle_type> deleter{ std::vector<handle_type>{ Handle1 } };
+			unique_type h1{ Handle1, Deleter(deleter) };
+			unique_type h2{ std::move(h1) };
+
+			Assert::IsFalse(h1.valid());
+			Assert::AreEqual(Handle1, h2.get());
+			Assert::AreEqual(static_cast<size_t>(0), deleter.called());
+		}
+
+		TEST_METHOD(MoveAssignment)
+		{
+			MockDeleter<handle_type> deleter{ std::vector<handle_type>{ Handle2, Handle1 } };
+			unique_type h1{ Handle1, Deleter(deleter) };
+			unique_type h2{ Handle2, Deleter(deleter) };
+
+			h2 = std::move(h1);
+
+			Assert::IsFalse(h1.valid());
+			Assert::AreEqual(Handle1, h2.get());
+			Assert::AreEqual(static_cast<size_t>(1), deleter.called());
+		}
+
+		TEST_METHOD(Assignment)
+		{
+			MockDeleter<handle_type> deleter{ std::vector<handle_type>{ Handle1, Handle2 } };
+			unique_type h1{ Deleter(deleter) };
+
+			h1 = Handle1;
+			h1 = Handle2;
+
+			Assert::AreEqual(Handle2, h1.get());
+			Assert::AreEqual(static_cast<size_t>(1), deleter.called());
+		}
+
+		TEST_METHOD(Reset)
+		{
+			MockDeleter<handle_type> deleter{ std::vector<handle_type>{ Handle1, Handle2 } };
+			unique_type h1{ Handle1, Deleter(deleter) };
+
+			h1.reset(Handle2);
+			Assert::AreEqual(Handle2, h1.get());
+			Assert::AreEqual(static_cast<size_t>(1), deleter.called());
+
+			h1.reset();
+			Assert::IsFalse(h1.valid());
+			Assert::AreEqual(static_cast<size_t>(2), deleter.called());
+		}
+
+		TEST_METHOD(Release)
+		{
+			MockDeleter<handle_type> deleter{ false };
+			unique_type h1{ Handle1, Deleter(deleter) };
+
+			Assert::AreEqual(Handle1, h1.release());
+			Assert::IsFalse(h1.valid());
+			Assert::AreEqual(static_cast<size_t>(0), deleter.called());
+		}
+
+		TEST_METHOD(Swap)
+		{
+			unique_type h1{ Handle1 };
+			unique_type h2{ Handle2 };
+
+			h1.swap(h2);
+
+			Assert::AreEqual(Handle2, h1.get());
+			Assert::AreEqual(Handle1, h2.get());
+		}
+
+		TEST_METHOD(Ptr)
+		{
+			MockDeleter<handle_type> deleter{ std::vector<handle_type>{ Handle1, Handle2 } };
+			unique_type h1{ Handle1, Deleter(deleter) };
+
+			TestPointerAssignment(h1.ptr(), Handle2);
+
+			Assert::AreEqual(Handle2, h1.get());
+			Assert::AreEqual(static_cast<size_t>(1), deleter.called());
+		}
+
+		TEST_METHOD(OperatorBool)
+		{
+			unique_type h1;
+			unique_type h2{ Handle1 };
+
+			Assert::IsFalse(static_cast<bool>(h1));
+			Assert::IsTrue(static_cast<bool>(h2));
+		}
+
+		TEST_METHOD(StatelessDeleter)
+		{
+			CountingDeleter::calls = 0;
+			{
+				UniqueWinHandle<handle_type, static_cast<handle_type>(0), BOOL, CountingDeleter> h1{ Handle1 };
+				auto h2 = std::move(h1);
+				h2.reset(Handle2);
+				Assert::AreEqual(static_cast<size_t>(1), CountingDeleter::calls);
+			}
+			Assert::AreEqual(static_cast<size_t>(2), CountingDeleter::calls);
+		}
+
+		TEST_METHOD(Promotion)
+		{
+			MockDeleter<handle_type> deleter{ std::vector<handle_type>{ Handle1 } };
+			unique_type h1{ Handle1, Deleter(deleter) };
+			{
+				WinHandle<handle_type, static_cast<handle_type>(0), BOOL> h2{ std::move(h1) };
+				WinHandle<handle_type, static_cast<handle_type>(0), BOOL> h3{ h2 };
+
+				Assert::IsFalse(h1.valid());
+				Assert::AreEqual(Handle1, h2.get());
+				Assert::AreEqual(2l, h2.use_count());
+				Assert::AreEqual(static_cast<size_t>(0), deleter.called());
+			}
+			Assert::AreEqual(static_cast<size_t>(1), deleter.called());
+		}
+
+	private:
+		void TestPointerAssignment(handle_type* h, handle_type new_value)
+		{
+			*h = new_value;
+		}
+	};
+}
@@ -0,0 +1,110 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include "MockDeleter.h"
+#include <WinHandle.h>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+
+namespace WaitSets
+{
+	TEST_CLASS(HandleWaitSetTests)
+	{
+	public:
+		inline static const HANDLE Handle1 = reinterpret_cast<HANDLE>(1234);
+		inline static const HANDLE Handle2 = reinterpret_cast<HANDLE>(4321);
+		inline static const HANDLE Handle3 = reinterpret_cast<HANDLE>(5678);
+
+		using handle_type = std::remove_cv_t<decltype(Handle1)>;
+		using winhandle_type = WinHandle<handle_type>;
+		using unique_type = UniqueWinHandle<handle_type, static_cast<handle_type>(0), BOOL>;
+
+		TEST_METHOD(ContiguousRawHandles)
+		{
+			HandleWaitSet<winhandle_type> set;
+			set.add(winhandle_type{ Handle1, nullptr });
+			set.add(winhandle_type{ Handle2, nullptr });
+
+			Assert::AreEqual(static_cast<size_t>(2), set.size());
+			Assert::IsTrue(Handle1 == set.data()[0]);
+			Assert::IsTrue(Handle2 == set.data()[1]);
+		}
+
+		TEST_METHOD(Find)
+		{
+			HandleWaitSet<winhandle_type> set;
+			set.add(winhandle_type{ Handle1, nullptr });
+			set.add(winhandle_type{ Handle2, nullptr });
+
+			Assert::AreEqual(static_cast<size_t>(1), set.find(Handle2));
+			Assert::AreEqual(set.npos, set.find(Handle3));
+		}
+
+		TEST_METHOD(FindMany)
+		{
+			HandleWaitSet<WinHandle<int, -1>> set;
+			for (int i = 0; i < 100; ++i)
+				set.add(WinHandle<int, -1>{ i * 3, nullptr });
+
+			for (int i = 0; i < 300; ++i)
+				Assert::AreEqual(i % 3 ? set.npos : static_cast<size_t>(i / 3), set.find(i));
+		}
+
+		TEST_METHOD(RefreshesChangedHandles)
+		{
+			HandleWaitSet<winhandle_type> set;
+			winhandle_type shared{ Handle1, nullptr };
+			set.add(shared);
+			set.add(winhandle_type{ Handle2, nullptr });
+
+			// Assigned through the set and through a copy sharing the handle
+			set.handle(1) = Handle3;
+			shared = Handle2;
+
+			Assert::IsTrue(Handle2 == set.data()[0]);
+			Assert::IsTrue(Handle3 == set.data()[1]);
+			Assert::AreEqual(static_cast<size_t>(1), set.find(Handle3));
+			Assert::AreEqual(static_cast<size_t>(0), set.find(Handle2));
+		}
+
+		TEST_METHOD(RemoveMovesLast)
+		{
+			MockDeleter<handle_type> deleter{ std::vector<handle_type>{ Handle1 } };
+			HandleWaitSet<winhandle_type> set;
+			set.add(winhandle_type{ Handle1, &MockDeleter<handle_type>::Delete, &deleter });
+			set.add(winhandle_type{ Handle2, nullptr });
+			set.add(winhandle_type{ Handle3, nullptr });
+
+			set.remove(0);
+			Assert::AreEqual(static_cast<size_t>(1), deleter.called());
+			Assert::AreEqual(static_cast<size_t>(2), set.size());
+			Assert::IsTrue(Handle3 == set.data()[0]);
+			Assert::IsTrue(Handle3 == set.handle(0).get());
+			Assert::AreEqual(set.npos, set.find(Handle1));
+		}
+
+		TEST_METHOD(RemoveReturnsHandle)
+		{
+			MockDeleter<handle_type> deleter{ std::vector<handle_type>{ Handle1 } };
+			HandleWaitSet<winhandle_type> set;
+			set.add(winhandle_type{ Handle1, &MockDeleter<handle_type>::Delete, &deleter });
+			{
+				winhandle_type h1 = set.remove(0);
+				Assert::IsTrue(set.empty());
+				Assert::AreEqual(static_cast<size_t>(0), deleter.called());
+			}
+			Assert::AreEqual(static_cast<size_t>(1), deleter.called());
+		}
+
+		TEST_METHOD(ClearClosesHandles)
+		{
+			MockDeleter<handle_type> deleter{ std::vector<handle_type>{ Handle1, Handle2 } };
+			HandleWaitSet<unique_type> set;
+			set.add(unique_type{ Handle1, [&deleter](handle_type h) { return deleter.Delete(h); } });
+			set.add(unique_type{ Handle2, [&deleter](handle_type h) { return deleter.Delete(h); } });
+
+			set.clear();
+			Assert::AreEqual(static_cast<size_t>(2), deleter.called());
+		}
+	};
+}
@@ -0,0 +1,99 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include "MockDeleter.h"
+#include <WinHandle.h>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+
+namespace Weak
+{
+	TEST_CLASS(WeakWinHandleTests)
+	{
+	public:
+		inline static const HANDLE Handle1 = reinterpret_cast<HANDLE>(1234);
+		inline static const HANDLE Handle2 = reinterpret_cast<HANDLE>(4321);
+
+		using handle_type = std::remove_cv_t<decltype(Handle1)>;
+		using winhandle_type = WinHandle<handle_type>;
+		using weak_type = WeakWinHandle<handle_type>;
+
+		TEST_METHOD(DefaultConstructor)
+		{
+			weak_type w1;
+
+			Assert::IsTrue(w1.expired());
+			Assert::AreEqual(0l, w1.use_count());
+			Assert::IsFalse(w1.lock().valid());
+		}
+
+		TEST_METHOD(Lock)
+		{
+			MockDeleter<handle_type> deleter{ std::vector<handle_type>{ Handle1 } };
+			winhandle_type h1{ Handle1, &MockDeleter<handle_type>::Delete, &deleter };
+			weak_type w1{ h1 };
+
+			Assert::IsFalse(w1.expired());
+			Assert::AreEqual(1l, w1.use_count());
+
+			winhandle_type h2 = w1.lock();
+			Assert::AreEqual(Handle1, h2.get());
+			Assert::AreEqual(2l, h1.use_count());
+		}
+
+		TEST_METHOD(DoesNotExtendLifetime)
+		{
+			MockDeleter<handle_type> deleter{ std::vector<handle_type>{ Handle1 } };
+			weak_type w1;
+			{
+				winhandle_type h1{ Handle1, &MockDeleter<handle_type>::Delete, &deleter };
+				w1 = h1;
+			}
+			Assert::AreEqual(static_cast<size_t>(1), deleter.called());
+			Assert::IsTrue(w1.expired());
+			Assert::IsFalse(w1.lock().valid());
+		}
+
+		TEST_METHOD(CopyAndMove)
+		{
+			MockDeleter<handle_type> deleter{ std::vector<handle_type>{ Handle1 } };
+			winhandle_type h1{ Handle1, &MockDeleter<handle_type>::Delete, &deleter };
+			weak_type w1{ h1 };
+
+			weak_type w2{ w1 };
+			weak_type w3{ std::move(w1) };
+			Assert::IsTrue(w1.expired());
+			Assert::IsFalse(w2.expired());
+			Assert::IsFalse(w3.expired());
+
+			h1.reset();
+			Assert::AreEqual(static_cast<size_t>(1), deleter.called());
+			Assert::IsTrue(w2.expired());
+			Assert::IsTrue(w3.expired());
+		}
+
+		TEST_METHOD(ObservedImplIsNotReused)
+		{
+			MockDeleter<handle_type> deleter{ std::vector<handle_type>{ Handle1, Handle2 } };
+			winhandle_type h1{ Handle1, &MockDeleter<handle_type>::Delete, &deleter };
+			winhandle_type h2{ std::move(h1) };
+			weak_type w1{ h2 };
+
+			// Storing another handle detaches from the observed impl, which expires
+			h2.reset(Handle2);
+			Assert::IsTrue(w1.expired());
+			Assert::AreEqual(Handle2, h2.get());
+			Assert::AreEqual(static_cast<size_t>(1), deleter.called());
+		}
+
+		TEST_METHOD(Reset)
+		{
+			winhandle_type h1{ Handle1, nullptr };
+			weak_type w1{ h1 };
+
+			w1.reset();
+			Assert::IsTrue(w1.expired());
+			Assert::AreEqual(1l, h1.use_count());
+		}
+	};
+}
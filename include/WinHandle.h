@@ -23,74 +23,728 @@ SOFTWARE.
 */
 
 #pragma once
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cassert>
+#include <chrono>
+#include <concepts>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <functional>
 #include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <new>
+#include <span>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#if __cpp_impl_three_way_comparison
+#include <compare>
+#endif
+#if defined(WINHANDLE_REGISTRY)
+#include <array>
+#include <typeinfo>
+#endif
+#if defined(__linux__)
+#include <cstdio>
+#include <dirent.h>
+#include <poll.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Group probing in HandleTable uses SSE2 where the target supports it
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define WINHANDLE_SSE2
+#include <emmintrin.h>
+#endif
+
+// Targets whose pointers may carry tags in their upper byte: ARM memory tagging, hardware-assisted
+// AddressSanitizer and AArch64 Android, which tags heap pointers. AtomicWinHandle needs those bits.
+#if defined(__ARM_FEATURE_MEMORY_TAGGING) || defined(__SANITIZE_HWADDRESS__) || (defined(__ANDROID__) && defined(__aarch64__))
+#define WINHANDLE_TAGGED_POINTERS
+#elif defined(__has_feature)
+#if __has_feature(hwaddress_sanitizer)
+#define WINHANDLE_TAGGED_POINTERS
+#endif
+#endif
+
+// Compiler builtin telling whether a type is trivially relocatable, where there is one
+#if defined(__has_builtin)
+#if __has_builtin(__builtin_is_cpp_trivially_relocatable)
+#define WINHANDLE_TRIVIALLY_RELOCATABLE(T) __builtin_is_cpp_trivially_relocatable(T)
+#elif __has_builtin(__is_trivially_relocatable)
+#define WINHANDLE_TRIVIALLY_RELOCATABLE(T) __is_trivially_relocatable(T)
+#endif
+#endif
+#if !defined(WINHANDLE_TRIVIALLY_RELOCATABLE)
+#define WINHANDLE_TRIVIALLY_RELOCATABLE(T) std::is_trivially_copyable_v<T>
+#endif
+
+// Calling convention of plain and member function deleters. Only meaningful on Windows.
+#if defined(_WIN32)
+#define WINHANDLE_STDCALL __stdcall
+#else
+#define WINHANDLE_STDCALL
+#endif
+
+
+template<typename T, typename RT = int>
+class HandleDeleter;
+
+template<typename T, T NullValue = static_cast<T>(0), typename RT = int, typename Deleter = HandleDeleter<T, RT>>
+class UniqueWinHandle;
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+class WeakWinHandle;
+
+template<typename T, T NullValue, typename RT, typename Deleter>
+class AtomicWinHandle;
+
+// Deleter calling a release function that is fixed at compile time, e.g. StaticDeleter<&CloseHandle>.
+// It is stateless, so handles using it store no deleter and the release call can be inlined.
+template<auto Function>
+struct StaticDeleter
+{
+	template<typename T>
+	auto operator()(T handle) const noexcept(noexcept(Function(handle)))
+	{
+		return Function(handle);
+	}
+};
+
+// True for types whose objects can be relocated with memcpy: the bytes copied to new storage form
+// the same object, and the original is not destroyed (P1144). Holds for trivially copyable types,
+// types the compiler knows to be trivially relocatable, and WinHandle. Specialize it for others.
+template<typename T>
+struct is_trivially_relocatable : std::bool_constant<std::is_trivially_copyable_v<T> || WINHANDLE_TRIVIALLY_RELOCATABLE(T)> {};
+
+template<typename T>
+constexpr bool is_trivially_relocatable_v = is_trivially_relocatable<T>::value;
+
+// Thread-safe reference count shared by all copies of a WinHandle. This is the default.
+class AtomicRefCount
+{
+public:
+	explicit AtomicRefCount(long count) noexcept : m_count{ count } {}
+
+	void increment() noexcept { m_count.fetch_add(1, std::memory_order_relaxed); }
+	bool decrement() noexcept { return m_count.fetch_sub(1, std::memory_order_acq_rel) == 1; } // True when the count drops to zero
+	void increment(long count) noexcept { m_count.fetch_add(count, std::memory_order_relaxed); }
+	bool decrement(long count) noexcept { return m_count.fetch_sub(count, std::memory_order_acq_rel) == count; }
+	bool increment_nonzero() noexcept // False when the count already dropped to zero
+	{
+		long count = m_count.load(std::memory_order_relaxed);
+		while (count != 0 && !m_count.compare_exchange_weak(count, count + 1, std::memory_order_acquire, std::memory_order_relaxed))
+			;
+		return count != 0;
+	}
+	long count() const noexcept { return m_count.load(std::memory_order_relaxed); }
+
+private:
+	std::atomic<long> m_count;
+};
+
+// Plain reference count for handles whose copies never leave the thread that created them
+class LocalRefCount
+{
+public:
+	explicit LocalRefCount(long count) noexcept : m_count{ count } {}
+
+	void increment() noexcept { ++m_count; }
+	bool decrement() noexcept { return --m_count == 0; } // True when the count drops to zero
+	void increment(long count) noexcept { m_count += count; }
+	bool decrement(long count) noexcept { return (m_count -= count) == 0; }
+	bool increment_nonzero() noexcept { return m_count != 0 && ++m_count; } // False when the count already dropped to zero
+	long count() const noexcept { return m_count; }
+
+private:
+	long m_count;
+};
+
+// Thread-safe reference count for handles that are assigned or closed while copies on other threads
+// use them. Readers take a lease (see WinHandle::lease()), which costs one atomic increment and
+// decrement. A replacement stores the new value atomically and releases the old one only after
+// every lease that may have seen it has ended. Replacements of the same handle are serialized.
+class ConcurrentRefCount : public AtomicRefCount
+{
+public:
+	using AtomicRefCount::AtomicRefCount;
+
+	// Leases. enter() returns the slot to pass to leave().
+	unsigned enter() noexcept
+	{
+		const unsigned slot = m_epoch.load(std::memory_order_seq_cst) & 1;
+		m_leases[slot].fetch_add(1, std::memory_order_seq_cst);
+		return slot;
+	}
+	void leave(unsigned slot) noexcept { m_leases[slot].fetch_sub(1, std::memory_order_release); }
+
+	// Waits until the leases entered before the call have ended. Each flip of the epoch sends new
+	// leases to the other slot, so neither wait is held up by leases entered after it started.
+	void synchronize() noexcept
+	{
+		for (int flip = 0; flip < 2; ++flip)
+		{
+			const unsigned slot = m_epoch.fetch_add(1, std::memory_order_seq_cst) & 1;
+			while (m_leases[slot].load(std::memory_order_seq_cst) != 0)
+				std::this_thread::yield();
+		}
+	}
+
+	// Serializes replacements
+	void lock() noexcept
+	{
+		while (m_replacing.exchange(true, std::memory_order_acquire))
+			std::this_thread::yield();
+	}
+	void unlock() noexcept { m_replacing.store(false, std::memory_order_release); }
+
+private:
+	std::atomic<unsigned> m_epoch{ 0 };
+	std::atomic<long> m_leases[2]{};
+	std::atomic<bool> m_replacing{ false };
+};
+
+// Memory resource handing out blocks of one size, e.g. WinHandle control blocks (see WinHandle::pool()).
+// Freed blocks are cached per thread and exchanged between threads through a lock-free list. Memory
+// is taken from the system in slabs and kept for the lifetime of the process. Requests for larger
+// blocks are passed on to std::pmr::new_delete_resource().
+template<std::size_t BlockSize, std::size_t Alignment = alignof(std::max_align_t)>
+class HandlePool final : public std::pmr::memory_resource
+{
+public:
+	static constexpr std::size_t cache_size = 64; // Freed blocks a thread keeps before sharing them
+	static constexpr std::size_t slab_size = 64; // Blocks taken from the system at once
+
+	static HandlePool& instance() noexcept;
+
+	// Copy and move
+	HandlePool(const HandlePool&) = delete;
+	HandlePool(HandlePool&&) = delete;
+	HandlePool& operator=(const HandlePool&) = delete;
+	HandlePool& operator=(HandlePool&&) = delete;
+
+private:
+	struct node
+	{
+		node* next;
+	};
+
+	// Blocks owned by a single thread. Freed blocks are kept apart so they can be shared as one chain.
+	struct cache
+	{
+		~cache();
+
+		node* refilled{ nullptr };
+		node* freed{ nullptr };
+		node* freed_tail{ nullptr };
+		std::size_t freed_count{ 0 };
+	};
+
+	static constexpr std::size_t s_alignment = Alignment < alignof(node) ? alignof(node) : Alignment;
+	static constexpr std::size_t s_blockSize = ((BlockSize < sizeof(node) ? sizeof(node) : BlockSize) + s_alignment - 1) / s_alignment * s_alignment;
+
+	HandlePool() noexcept = default;
+	~HandlePool() override = default;
+
+	void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+	void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override;
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+	static cache& local() noexcept;
+	void share(node* head, node* tail) noexcept;
+	node* allocate_slab();
+
+	std::atomic<node*> m_shared{ nullptr };
+	std::atomic<node*> m_slabs{ nullptr }; // Keeps the slabs reachable
+};
+
+#if defined(WINHANDLE_REGISTRY)
+// Statistics of one WinHandle<T, NullValue, RT> instantiation, as returned by HandleRegistry::snapshot()
+struct HandleStatistics
+{
+	// Bucket i of latency counts release calls taking from 2^i up to 2^(i+1) nanoseconds. Bucket 0
+	// also counts calls below one nanosecond and the last bucket everything above its lower bound.
+	static constexpr std::size_t histogram_size = 32;
+
+	const std::type_info* type; // typeid(WinHandle<T, NullValue, RT>)
+	long long live; // Handles currently owned
+	long long peak; // Highest number of handles owned at once
+	unsigned long long acquired; // Handles that have been stored
+	unsigned long long released; // Handles that have been released, including those closed by close_all
+	std::array<unsigned long long, histogram_size> latency;
+};
+
+// Process wide statistics of the handles owned by WinHandles, compiled in when WINHANDLE_REGISTRY is
+// defined. Each WinHandle<T, NullValue, RT> instantiation registers its counters the first time it
+// stores a handle. Handles owned by a UniqueWinHandle are counted once it is promoted to a WinHandle.
+// Counters are updated with relaxed atomic operations and the registry is never locked, so
+// snapshot() may be called at any time without stalling threads using handles.
+class HandleRegistry
+{
+public:
+	class counters
+	{
+	public:
+		explicit counters(const std::type_info& type) noexcept;
+
+		// Copy and move
+		counters(const counters&) = delete;
+		counters& operator=(const counters&) = delete;
+
+		void acquire() noexcept;
+		void release() noexcept; // Released without calling the deleter
+		void release(std::chrono::nanoseconds latency) noexcept;
+		HandleStatistics statistics() const noexcept;
+
+	private:
+		friend class HandleRegistry;
+
+		const std::type_info& m_type;
+		std::atomic<long long> m_live{ 0 };
+		std::atomic<long long> m_peak{ 0 };
+		std::atomic<unsigned long long> m_acquired{ 0 };
+		std::atomic<unsigned long long> m_released{ 0 };
+		std::array<std::atomic<unsigned long long>, HandleStatistics::histogram_size> m_latency{};
+		counters* m_next{ nullptr };
+	};
+
+	// Counters of WinHandle<T, NullValue, RT>
+	template<typename T, T NullValue, typename RT>
+	static counters& get() noexcept;
+
+	// Statistics of every instantiation that has stored a handle
+	static std::vector<HandleStatistics> snapshot();
+
+private:
+	static std::atomic<counters*>& head() noexcept;
+};
+#endif
+
+namespace winhandle_detail
+{
+	// Deleter storage that takes up no space for stateless deleters (empty base optimization)
+	template<typename Deleter, bool = std::is_empty_v<Deleter> && !std::is_final_v<Deleter>>
+	class deleter_storage : private Deleter
+	{
+	public:
+		deleter_storage() = default;
+		explicit deleter_storage(const Deleter& deleter) : Deleter(deleter) {}
+		explicit deleter_storage(Deleter&& deleter) noexcept : Deleter(std::move(deleter)) {}
+
+		template<typename... Args>
+		explicit deleter_storage(std::in_place_t, Args&&... args) : Deleter(std::forward<Args>(args)...) {}
+
+		Deleter& deleter() noexcept { return *this; }
+		const Deleter& deleter() const noexcept { return *this; }
+	};
+
+	template<typename Deleter>
+	class deleter_storage<Deleter, false>
+	{
+	public:
+		deleter_storage() = default;
+		explicit deleter_storage(const Deleter& deleter) : m_deleter(deleter) {}
+		explicit deleter_storage(Deleter&& deleter) noexcept : m_deleter(std::move(deleter)) {}
+
+		template<typename... Args>
+		explicit deleter_storage(std::in_place_t, Args&&... args) : m_deleter(std::forward<Args>(args)...) {}
+
+		Deleter& deleter() noexcept { return m_deleter; }
+		const Deleter& deleter() const noexcept { return m_deleter; }
+
+	private:
+		Deleter m_deleter{};
+	};
+
+	// Function pointer deleter with additional arguments passed after the handle
+	template<typename Function, typename... Args>
+	struct bound_function
+	{
+		Function function;
+		mutable std::tuple<Args...> args;
+
+		template<typename T>
+		auto operator()(T handle) const
+		{
+			return std::apply([this, handle](Args&... a) { return function(handle, a...); }, args);
+		}
+	};
+
+	// Member function pointer deleter with the instance it is called on and additional arguments
+	template<typename Member, typename Class, typename... Args>
+	struct bound_member
+	{
+		Member member;
+		Class* instance;
+		mutable std::tuple<Args...> args;
+
+		template<typename T>
+		auto operator()(T handle) const
+		{
+			return std::apply([this, handle](Args&... a) { return (instance->*member)(handle, a...); }, args);
+		}
+	};
+
+	// True for reference counts supporting leases, like ConcurrentRefCount
+	template<typename RefCount>
+	constexpr bool is_concurrent = requires (RefCount& refs) { refs.enter(); refs.synchronize(); };
+
+	// True where pointers may be tagged (see WINHANDLE_TAGGED_POINTERS). Depends on T so that only
+	// instantiating a class that relies on untagged pointers fails.
+	template<typename T>
+#if defined(WINHANDLE_TAGGED_POINTERS)
+	constexpr bool tagged_pointers = true;
+#else
+	constexpr bool tagged_pointers = false;
+#endif
+
+	// True for deleters that release handles when default constructed, like StaticDeleter. Deleters
+	// that can be empty, like HandleDeleter, release nothing until they are given a function.
+	template<typename Deleter>
+	constexpr bool releases_by_default = std::is_default_constructible_v<Deleter> && !std::is_constructible_v<bool, const Deleter&>;
+
+	template<typename Deleter>
+	struct is_handle_deleter : std::false_type {};
+
+	template<typename T, typename RT>
+	struct is_handle_deleter<HandleDeleter<T, RT>> : std::true_type {};
+
+	// True when both deleters are known to release handles in the same way. Deleters that cannot be
+	// compared are assumed to differ.
+	template<typename Deleter>
+	bool same_deleter(const Deleter& a, const Deleter& b) noexcept
+	{
+		if constexpr (std::is_empty_v<Deleter>)
+			return true;
+		else if constexpr (is_handle_deleter<Deleter>::value)
+			return a.same_target(b);
+		else if constexpr (requires { { a == b } noexcept -> std::convertible_to<bool>; })
+			return static_cast<bool>(a == b);
+		else
+			return false;
+	}
+
+	// Hash that is equal for deleters same_deleter() reports as the same. Other deleters hash to zero.
+	template<typename Deleter>
+	std::size_t deleter_hash(const Deleter& deleter) noexcept
+	{
+		if constexpr (is_handle_deleter<Deleter>::value)
+			return deleter.hash_target();
+		else
+			return 0;
+	}
+
+	// Creates a deleter from one of the bound deleters above. A HandleDeleter is guaranteed to store them inline.
+	template<typename Deleter, typename Function>
+	Deleter make_deleter(Function&& function)
+	{
+		if constexpr (is_handle_deleter<Deleter>::value)
+			static_assert(Deleter::template stored_inline<std::decay_t<Function>>, "Deleter and bound arguments exceed the inline storage of HandleDeleter");
+		return Deleter(std::forward<Function>(function));
+	}
+
+	// Calls the deleter unless it is empty (e.g. a null function pointer or an empty HandleDeleter)
+	template<typename RT, typename Deleter, typename T>
+	RT invoke_deleter(Deleter& deleter, T handle) noexcept
+	{
+		if constexpr (std::is_constructible_v<bool, const Deleter&>)
+		{
+			if (!static_cast<bool>(deleter))
+				return RT{};
+		}
+		return static_cast<RT>(deleter(handle));
+	}
+
+#if defined(__linux__) && defined(SYS_close_range)
+	struct fd_traits;
+
+	template<typename Deleter, typename = void>
+	struct is_fd_traits_deleter : std::false_type {};
+
+	template<typename Deleter>
+	struct is_fd_traits_deleter<Deleter, std::void_t<typename Deleter::traits>> : std::is_base_of<fd_traits, typename Deleter::traits> {};
+
+	// True when the deleter is known to call the POSIX close function
+	template<typename Deleter>
+	bool calls_posix_close(const Deleter& deleter) noexcept
+	{
+		if constexpr (std::is_same_v<Deleter, StaticDeleter<&::close>> || is_fd_traits_deleter<Deleter>::value)
+			return true;
+		else if constexpr (std::is_same_v<Deleter, HandleDeleter<int, int>>)
+		{
+			const auto target = deleter.template target<decltype(&::close)>();
+			return target && *target == &::close;
+		}
+		else
+			return false;
+	}
+
+	// Closes all file descriptors from first to last with a single system call
+	inline bool close_fd_range(int first, int last) noexcept
+	{
+		return ::syscall(SYS_close_range, static_cast<unsigned int>(first), static_cast<unsigned int>(last), 0u) == 0;
+	}
+#endif
+}
+
+
+// Type erased deleter used by WinHandle and UniqueWinHandle unless another deleter type is given.
+// Callables up to inline_size bytes, which includes function pointers, member function pointers with
+// their instance and bound arguments, are stored inline and never allocate. Callables that can be
+// copied bitwise are copied without an indirect call.
+template<typename T, typename RT>
+class HandleDeleter
+{
+public:
+	static constexpr std::size_t inline_size = 6 * sizeof(void*);
+
+	template<typename F>
+	static constexpr bool stored_inline = sizeof(F) <= inline_size && alignof(F) <= alignof(std::max_align_t) && std::is_nothrow_move_constructible_v<F>;
+
+	// Constructors
+	HandleDeleter() noexcept = default;
+	HandleDeleter(std::nullptr_t) noexcept;
+
+	template<typename F, typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, HandleDeleter> && std::is_invocable_v<const std::decay_t<F>&, T>>>
+	HandleDeleter(F&& function);
+
+	// Copy and move
+	HandleDeleter(const HandleDeleter& copy);
+	HandleDeleter(HandleDeleter&& move) noexcept;
+	HandleDeleter& operator=(const HandleDeleter& copy);
+	HandleDeleter& operator=(HandleDeleter&& move) noexcept;
+
+	// Destructor
+	~HandleDeleter() noexcept;
+
+	// Invocation. Must not be called on an empty deleter.
+	RT operator()(T handle) const;
+	explicit operator bool() const noexcept;
+
+	// Stored callable if it has type F, otherwise nullptr
+	template<typename F>
+	const F* target() const noexcept;
+
+	// True when both deleters are empty or hold equal bytes of the same bitwise copyable callable,
+	// e.g. copies of one function pointer. Other callables are never reported as the same.
+	bool same_target(const HandleDeleter& other) const noexcept;
+	std::size_t hash_target() const noexcept; // Equal for deleters same_target() reports as the same
+
+private:
+	enum class operation { copy, move, destroy };
+
+	using invoke_type = RT(*)(const void* storage, T handle);
+	using manage_type = void(*)(operation op, void* target, void* source);
+
+	template<typename F>
+	static constexpr bool bitwise_copyable = std::is_trivially_copy_constructible_v<F> && std::is_trivially_destructible_v<F>;
+
+	template<typename F> static RT invoke_inline(const void* storage, T handle);
+	template<typename F> static RT invoke_heap(const void* storage, T handle);
+	template<typename F> static void manage_inline(operation op, void* target, void* source);
+	template<typename F> static void manage_heap(operation op, void* target, void* source);
+
+	void copy_from(const HandleDeleter& other);
+	void move_from(HandleDeleter& other) noexcept;
+	void clear() noexcept;
+
+	alignas(std::max_align_t) unsigned char m_storage[inline_size]{}; // Zeroed so that same_target() compares no indeterminate bytes
+	invoke_type m_invoke{ nullptr };
+	manage_type m_manage{ nullptr }; // Not set when the storage is copied bitwise
+};
+
+
+// Closes handles on a background thread so that releasing the last reference never waits for the
+// release function. Handles are passed to the thread through a bounded lock-free queue. When the
+// queue is full, close() either waits for room or closes the handle on the calling thread. With a
+// threshold, release functions are timed and handles are only deferred while the average release
+// time of their deleter is above the threshold, so a slow deleter does not get fast ones deferred.
+// Used through DeferredDeleter.
+template<typename T, typename RT = int, typename Deleter = HandleDeleter<T, RT>>
+class DeferredCloser
+{
+public:
+	static constexpr std::size_t default_capacity = 1024;
+
+	// What close() does when the queue is full
+	enum class backpressure { wait, close_inline };
+
+	// Constructors. The capacity is rounded up to a power of two of at least two.
+	explicit DeferredCloser(std::size_t capacity = default_capacity, backpressure full = backpressure::wait, std::chrono::nanoseconds threshold = {});
+
+	// Shared instance used by default constructed DeferredDeleters. It is never destroyed, so
+	// handles still queued when the process exits are not closed unless flush() is called.
+	static DeferredCloser& instance();
+
+	// Copy and move
+	DeferredCloser(const DeferredCloser&) = delete;
+	DeferredCloser(DeferredCloser&&) = delete;
+	DeferredCloser& operator=(const DeferredCloser&) = delete;
+	DeferredCloser& operator=(DeferredCloser&&) = delete;
+
+	// Destructor. Closes the queued handles and stops the thread.
+	~DeferredCloser() noexcept;
+
+	// Closing
+	RT close(T handle, const Deleter& deleter) noexcept; // Returns RT{} when the handle was queued
+	void flush() noexcept; // Waits until every handle queued so far has been closed
+
+	// Statistics
+	std::size_t pending() const noexcept;
+	std::chrono::nanoseconds average_latency(const Deleter& deleter) const noexcept; // Only measured with a threshold
+
+private:
+	struct slot
+	{
+		std::atomic<std::size_t> sequence;
+		T handle;
+		alignas(Deleter) unsigned char deleter[sizeof(Deleter)];
+	};
+
+	// Average release time of the deleters with one hash
+	struct estimate
+	{
+		std::atomic<std::size_t> key{ 0 }; // Hash of the deleters, 0 while unused
+		std::atomic<long long> latency{ 0 }; // Moving average in nanoseconds
+	};
+
+	static_assert(std::is_nothrow_move_constructible_v<Deleter>, "DeferredCloser moves deleters into its queue, which must not throw");
+
+	static constexpr std::size_t s_estimates = 16;
+
+	std::atomic<long long>& latency(const Deleter& deleter) const noexcept;
+	bool defer(const Deleter& deleter) const noexcept;
+	RT enqueue(T handle, Deleter&& deleter) noexcept;
+	bool push(T handle, Deleter& deleter) noexcept;
+	void wake() noexcept;
+	RT invoke(T handle, const Deleter& deleter) noexcept;
+	void run() noexcept;
+
+	std::unique_ptr<slot[]> m_slots;
+	std::size_t m_mask;
+	backpressure m_full;
+	std::chrono::nanoseconds m_threshold;
+	mutable estimate m_estimates[s_estimates]; // Claimed by the first deleter with a new hash
+	alignas(64) std::atomic<std::size_t> m_tail{ 0 }; // Slots claimed by producers
+	alignas(64) std::atomic<std::size_t> m_closed{ 0 }; // Handles closed by the thread
+	std::atomic<unsigned> m_wake{ 0 };
+	std::atomic<bool> m_sleeping{ false }; // Set while the thread waits for m_wake to change
+	std::atomic<bool> m_stop{ false };
+	std::size_t m_head{ 0 }; // Only used by the thread
+	std::thread m_thread;
+};
+
+// Deleter handing handles to a DeferredCloser instead of releasing them directly. The wrapped
+// deleter is called on the closer thread. Releasing a handle through it returns RT{} if the
+// handle was queued.
+template<typename T, typename RT = int, typename Deleter = HandleDeleter<T, RT>>
+class DeferredDeleter
+{
+public:
+	using closer_type = DeferredCloser<T, RT, Deleter>;
+
+	// Constructors. Deleters created without a closer use closer_type::instance().
+	DeferredDeleter() : m_closer{ &closer_type::instance() } {}
+	DeferredDeleter(Deleter deleter, closer_type& closer) noexcept : m_deleter(std::move(deleter)), m_closer{ &closer } {}
+
+	template<typename F, typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, DeferredDeleter> && std::is_constructible_v<Deleter, F>>>
+	DeferredDeleter(F&& deleter) : m_deleter(std::forward<F>(deleter)), m_closer{ &closer_type::instance() } {}
+
+	// Invocation
+	RT operator()(T handle) const noexcept { return m_closer->close(handle, m_deleter); }
+	explicit operator bool() const noexcept;
+
+	const Deleter& deleter() const noexcept { return m_deleter; }
+	closer_type& closer() const noexcept { return *m_closer; }
+
+private:
+	Deleter m_deleter{};
+	closer_type* m_closer;
+};
 
 
-template<typename T, T NullValue = static_cast<T>(0), typename RT = int>
+template<typename T, T NullValue = static_cast<T>(0), typename RT = int, typename Deleter = HandleDeleter<T, RT>, typename RefCount = AtomicRefCount>
 class WinHandle
 {
 public:
 	using element_type = T;
+	using deleter_type = Deleter;
+	using refcount_type = RefCount;
 
 	class MutableHandle;
+	class Lease;
 
 #pragma region Constructors
 	// Constructors
-	WinHandle();
-	explicit WinHandle(T handle, nullptr_t);
+	WinHandle() noexcept;
+	explicit WinHandle(T handle) requires winhandle_detail::releases_by_default<Deleter>; // Uses a default constructed deleter
+	explicit WinHandle(T handle, std::nullptr_t);
 
-	// std::function
-	explicit WinHandle(std::function<RT(T)> deleter);
-	explicit WinHandle(T handle, std::function<RT(T)> deleter);
+	// Deleter object (HandleDeleter by default, which accepts any callable such as a lambda or std::function)
+	explicit WinHandle(Deleter deleter);
+	explicit WinHandle(T handle, Deleter deleter);
 
 	// Function pointer
 	template<typename DType>
-	explicit WinHandle(RT(__stdcall* deleter)(DType));
+	explicit WinHandle(RT(WINHANDLE_STDCALL* deleter)(DType));
 
 	template<typename DType, typename... Args>
-	explicit WinHandle(RT(__stdcall* deleter)(DType, Args...), Args&&... args);
+	explicit WinHandle(RT(WINHANDLE_STDCALL* deleter)(DType, Args...), Args&&... args);
 
 	template<typename DType>
-	explicit WinHandle(T handle, RT(__stdcall* deleter)(DType));
+	explicit WinHandle(T handle, RT(WINHANDLE_STDCALL* deleter)(DType));
 
 	template<typename DType, typename... Args>
-	explicit WinHandle(T handle, RT(__stdcall* deleter)(DType, Args...), Args&&... args);
+	explicit WinHandle(T handle, RT(WINHANDLE_STDCALL* deleter)(DType, Args...), Args&&... args);
 
 	// Member function pointer
 	template<typename Class, typename DType>
-	explicit WinHandle(RT(__stdcall Class::* deleter)(DType), Class* instance);
+	explicit WinHandle(RT(WINHANDLE_STDCALL Class::* deleter)(DType), Class* instance);
 
 	template<typename Class, typename DType, typename... Args>
-	explicit WinHandle(RT(__stdcall Class::* deleter)(DType, Args...), Class* instance, Args&&... args);
+	explicit WinHandle(RT(WINHANDLE_STDCALL Class::* deleter)(DType, Args...), Class* instance, Args&&... args);
 
 	template<typename Class, typename DType>
-	explicit WinHandle(T handle, RT(__stdcall Class::* deleter)(DType), Class* instance);
+	explicit WinHandle(T handle, RT(WINHANDLE_STDCALL Class::* deleter)(DType), Class* instance);
 
 	template<typename Class, typename DType, typename... Args>
-	explicit WinHandle(T handle, RT(__stdcall Class::* deleter)(DType, Args...), Class* instance, Args&&... args);
+	explicit WinHandle(T handle, RT(WINHANDLE_STDCALL Class::* deleter)(DType, Args...), Class* instance, Args&&... args);
+
+	// Promotion of a unique handle to a shared handle
+	template<typename UniqueDeleter>
+	explicit WinHandle(UniqueWinHandle<T, NullValue, RT, UniqueDeleter>&& unique);
 #pragma endregion
 
 #pragma region Copy and move constructors
 	// Copy and move constructors
-	WinHandle(const WinHandle&) noexcept = default;
+	WinHandle(const WinHandle& copy); // Allocates the impl of an empty handle, so it may throw std::bad_alloc
 	WinHandle(WinHandle&& move) noexcept;
 #pragma endregion
 
 #pragma region Copy and move operators
 	// Copy and move operators
-	WinHandle& operator =(const WinHandle&) noexcept = default;
+	WinHandle& operator =(const WinHandle& copy); // Allocates the impl of an empty handle, so it may throw std::bad_alloc
 	WinHandle& operator =(WinHandle&& move) noexcept;
 #pragma endregion
 
 #pragma region Destructor
 	// Destructor
-	~WinHandle() noexcept = default;
+	~WinHandle() noexcept;
 #pragma endregion
 
 #pragma region Assignment operators
 	// Assignment operators
-	WinHandle& operator=(const T& handle) noexcept;
+	WinHandle& operator=(const T& handle); // Allocates the impl of an empty handle, so it may throw std::bad_alloc
 #pragma endregion
 
 #pragma region Conversion operators
@@ -115,47 +769,120 @@ public:
 	const T* ptr() const noexcept; // Returns a non-mutable pointer to the handle
 	[[nodiscard]] MutableHandle ptr() noexcept; // Returns a mutable pointer to the handle
 	RT close() noexcept; // Close the handle using the assigned deleter
+	[[nodiscard]] Lease lease() const noexcept; // Handle that is not released while the lease exists (ConcurrentRefCount only)
+#pragma endregion
+
+#pragma region Allocation
+	// Allocation
+	static std::pmr::memory_resource* pool() noexcept; // HandlePool sized for the control blocks of this handle type
 #pragma endregion
 
 private:
 	// Safe Bool Idiom
 	void this_type_does_not_support_comparisons() const noexcept {}
 
+	// Handle value exposed through ptr() while no impl is attached (e.g. after a move)
+	static constexpr T s_nullHandle{ NullValue };
+
+	template<typename Handle, typename... Args>
+	friend Handle make_handle(typename Handle::element_type handle, Args&&... args);
+
+	template<typename Handle, typename... Args>
+	friend Handle allocate_handle(std::pmr::memory_resource* resource, typename Handle::element_type handle, Args&&... args);
+
+	template<typename U, U UNullValue, typename URT, typename UDeleter, typename URefCount>
+	friend std::size_t close_all(std::span<WinHandle<U, UNullValue, URT, UDeleter, URefCount>> handles, std::span<std::type_identity_t<URT>> results);
+
+	friend class WeakWinHandle<T, NullValue, RT, Deleter, RefCount>;
+	friend class AtomicWinHandle<T, NullValue, RT, Deleter>;
+
+	template<typename Handle, std::size_t N>
+	friend class MutableHandles;
+
 #pragma region impl
-	class impl
+	// Control block holding the reference counts, the handle and the deleter in a single allocation.
+	// The handle is released with the last WinHandle, the block itself with the last WeakWinHandle.
+	class impl : private winhandle_detail::deleter_storage<Deleter>
 	{
 	public:
 		// Constructors
-		explicit impl(T handle, nullptr_t) noexcept;
+		explicit impl(T handle);
+
+		// Non-owning. The handle is not released, values assigned later are.
+		explicit impl(T handle, std::nullptr_t) noexcept;
 
-		// std::function
-		explicit impl(T handle, std::function<RT(T)> deleter);
+		// Deleter object
+		explicit impl(T handle, const Deleter& deleter);
+		explicit impl(T handle, Deleter&& deleter) noexcept;
+
+		template<typename... Args>
+		explicit impl(T handle, std::in_place_t, Args&&... args);
 
 		// Copy and move
 		impl(const impl&) = delete;
-		impl(impl&&) = default;
+		impl(impl&&) = delete;
 		impl& operator=(const impl&) = delete;
-		impl& operator=(impl&&) = default;
+		impl& operator=(impl&&) = delete;
 
 		// Destructor
 		~impl() noexcept;
 
-		// Assignment
+		// Allocation. Blocks created without a memory resource use new and delete.
+		template<typename... Args>
+		static impl* create(std::pmr::memory_resource* resource, Args&&... args);
+		static void dispose(impl* block) noexcept;
+		std::pmr::memory_resource* resource() const noexcept;
+
+		// Reference counting
+		void add_ref() noexcept;
+		void add_ref(long count) noexcept;
+		bool add_ref_nonzero() noexcept; // Adds a reference unless the last one was already released
+		bool release() noexcept; // Returns true when the last reference was released
+		bool release(long count) noexcept;
+		long use_count() const noexcept;
+		bool unique() const noexcept; // True when no other WinHandle or WeakWinHandle refers to the block
+
+		// Weak reference counting. expire() releases the handle after the last reference was released.
+		// Moved-from handles take weak references with add_weak(), WeakWinHandles with add_observer().
+		void add_weak() noexcept;
+		void add_observer() noexcept;
+		static void release_weak(impl* block) noexcept;
+		static void expire(impl* block) noexcept;
+
+		// Assignment. With ConcurrentRefCount the old handle is released after the leases on it ended.
 		RT assign(T v) noexcept;
+		T disown() noexcept; // Stops owning the handle without releasing it
+
+		// Leases (ConcurrentRefCount only)
+		unsigned enter() noexcept;
+		void leave(unsigned slot) noexcept;
 
 		// Member access
 		T get() const noexcept;
 		const T* ptr() const noexcept;
-		std::function<RT(T)> deleter() const noexcept;
+		const Deleter& deleter() const noexcept;
+		bool custom_deleter() const noexcept;
+		bool owned() const noexcept; // False while the block holds the handle of a non-owning WinHandle
+
+		static bool custom(const Deleter& deleter) noexcept;
 
 	private:
+		using storage = winhandle_detail::deleter_storage<Deleter>;
+
 		RT destroy() noexcept;
+		RT release_handle(T handle) noexcept; // Calls the deleter on a handle that is no longer stored
+		void acquired() noexcept; // Records a newly stored handle in the HandleRegistry
 
+		RefCount m_refs{ 1 };
+		RefCount m_weak{ 1 }; // Weak references, plus one while there are references
 		T m_handle{ NullValue };
-		std::function<RT(T)> m_deleter{ nullptr };
+		std::atomic<bool> m_observed{ false }; // Set once a WeakWinHandle refers to the block
+		bool m_owned{ true }; // False while the handle given to a non-owning WinHandle is stored
+		std::pmr::memory_resource* m_resource{ nullptr };
 	};
 #pragma endregion
 
+public:
 #pragma region MutableHandle
 	class MutableHandle
 	{
@@ -182,493 +909,4973 @@ private:
 	};
 #pragma endregion
 
-	std::shared_ptr<impl> m_impl;
-};
+#pragma region Lease
+	// Handle value read from a WinHandle using ConcurrentRefCount. Assignments and close() on any copy
+	// of the WinHandle wait for the lease to end before releasing the value, so a thread holding a
+	// lease must not assign to the same handle. The WinHandle must outlive the lease.
+	class Lease
+	{
+	public:
+		// Constructors
+		Lease() = delete;
+		explicit Lease(const WinHandle& owner) noexcept;
 
+		// Copy and move
+		Lease(const Lease&) = delete;
+		Lease(Lease&&) = delete;
+		Lease& operator=(const Lease&) = delete;
+		Lease& operator=(Lease&&) = delete;
 
-#pragma region Comparison operators
+		// Destructor
+		~Lease() noexcept;
 
-#pragma region WinHandle comparison
-// Comparison operators
-template<typename T, T NullValue, typename RT, typename U>
-bool operator ==(const WinHandle<T, NullValue, RT>& lhs, const WinHandle<U, NullValue, RT>& rhs) noexcept
-{
-	return lhs.get() == rhs.get();
-}
+		// Member access
+		bool valid() const noexcept;
+		T get() const noexcept;
+		operator T() const noexcept;
+
+	private:
+		impl* m_impl;
+		unsigned m_slot{ 0 };
+		T m_handle{ NullValue };
+	};
+#pragma endregion
+
+private:
+	explicit WinHandle(impl* adopt) noexcept;
+
+	// Replaces the impl, releasing the reference held to the current one
+	void attach(impl* replacement) noexcept;
+
+	// Stores a handle acquired through an out parameter like reset(T), except that a handle without
+	// a block gets one from resource
+	void acquire(T handle, std::pmr::memory_resource* resource = nullptr);
+
+	// A handle moved from keeps a weak reference to its impl if the deleter is custom, so that values
+	// stored in it later are released with the same deleter. The low bit of m_impl marks such a reference.
+	static constexpr std::uintptr_t s_movedFrom{ 1 };
+
+	static impl* moved_from(impl* value) noexcept; // Value left in m_impl when value is moved out
+	bool recycle(impl* taken) noexcept; // Empties the reference held here for a handle moving taken here to keep
+	static impl* untagged(impl* value) noexcept; // Block value refers to, moved from or not
+	static void retain(impl* value) noexcept; // Adds the reference held by a copy of value
+	impl* block() const noexcept; // impl holding the handle, nullptr if empty or moved from
+	impl* donor() const noexcept; // impl a moved-from handle takes its deleter from
+	impl* create(T handle) const; // impl owning handle with the deleter and memory resource of the donor
+	impl* shared() const; // impl shared with a copy, created first if the handle has none
+	impl* share(impl* current) const; // Creates the impl of an empty or moved-from handle for shared()
+
+	mutable impl* m_impl{ nullptr }; // Only changed by a const handle when it is copied, see shared()
+};
 
-#if !__cpp_impl_three_way_comparison
 
-template<typename T, T NullValue, typename RT, typename U>
-bool operator !=(const WinHandle<T, NullValue, RT>& lhs, const WinHandle<U, NullValue, RT>& rhs) noexcept
+// Single owner variant of WinHandle. It is move-only and stores nothing but the
+// handle and the deleter, so it has the size of T when the deleter is stateless.
+template<typename T, T NullValue, typename RT, typename Deleter>
+class UniqueWinHandle : private winhandle_detail::deleter_storage<Deleter>
 {
-	return lhs.get() != rhs.get();
-}
+public:
+	using element_type = T;
+	using deleter_type = Deleter;
+
+	static_assert(std::is_nothrow_move_constructible_v<Deleter>, "UniqueWinHandle requires a deleter that can be moved without throwing");
+
+	class MutableHandle;
+
+#pragma region Constructors
+	// Constructors
+	UniqueWinHandle() noexcept = default;
+	explicit UniqueWinHandle(T handle) noexcept;
+	explicit UniqueWinHandle(const Deleter& deleter);
+	explicit UniqueWinHandle(Deleter&& deleter) noexcept;
+	UniqueWinHandle(T handle, const Deleter& deleter);
+	UniqueWinHandle(T handle, Deleter&& deleter) noexcept;
+#pragma endregion
+
+#pragma region Copy and move constructors
+	// Copy and move constructors
+	UniqueWinHandle(const UniqueWinHandle&) = delete;
+	UniqueWinHandle(UniqueWinHandle&& move) noexcept;
+#pragma endregion
+
+#pragma region Copy and move operators
+	// Copy and move operators
+	UniqueWinHandle& operator =(const UniqueWinHandle&) = delete;
+	UniqueWinHandle& operator =(UniqueWinHandle&& move) noexcept;
+#pragma endregion
+
+#pragma region Destructor
+	// Destructor
+	~UniqueWinHandle() noexcept;
+#pragma endregion
+
+#pragma region Assignment operators
+	// Assignment operators
+	UniqueWinHandle& operator=(const T& handle) noexcept;
+#pragma endregion
+
+#pragma region Conversion operators
+	// Conversion operators
+	// Safe Bool Idiom
+	using bool_type = void (UniqueWinHandle::*)() const noexcept;
+	operator bool_type() const noexcept;
+#pragma endregion
+
+#pragma region Smart pointer operations
+	// Smart pointer operations
+	void swap(UniqueWinHandle& other) noexcept;
+	void reset() noexcept;
+	void reset(T handle) noexcept;
+	[[nodiscard]] T release() noexcept; // Gives up ownership without closing the handle
+	Deleter& get_deleter() noexcept;
+	const Deleter& get_deleter() const noexcept;
+#pragma endregion
+
+#pragma region Handle operations
+	// Handle operations
+	bool valid() const noexcept;
+	T get() const noexcept;
+	const T* ptr() const noexcept; // Returns a non-mutable pointer to the handle
+	[[nodiscard]] MutableHandle ptr() noexcept; // Returns a mutable pointer to the handle
+	RT close() noexcept; // Close the handle using the assigned deleter
+#pragma endregion
+
+private:
+	// Safe Bool Idiom
+	void this_type_does_not_support_comparisons() const noexcept {}
+
+	using storage = winhandle_detail::deleter_storage<Deleter>;
+
+public:
+#pragma region MutableHandle
+	class MutableHandle
+	{
+	public:
+		// Constructors
+		MutableHandle() = delete;
+		explicit MutableHandle(UniqueWinHandle& owner) noexcept;
+
+		// Copy and move
+		MutableHandle(const MutableHandle&) = delete;
+		MutableHandle(MutableHandle&&) = delete;
+		MutableHandle& operator=(const MutableHandle&) = delete;
+		MutableHandle& operator=(MutableHandle&&) = delete;
+
+		// Destructor
+		~MutableHandle() noexcept;
+
+		// Conversion operator
+		operator T* () noexcept;
+
+	private:
+		UniqueWinHandle& m_owner;
+		T m_handle{ NullValue };
+	};
+#pragma endregion
+
+private:
+	T m_handle{ NullValue };
+};
+
+// Raw handle value passed to functions that use a handle without owning it. It converts implicitly
+// from WinHandle, UniqueWinHandle and raw handles, and copying it is copying a T, so unlike passing a
+// WinHandle by value it costs no reference counting. The owner must keep the handle open while the
+// view is used.
+template<typename T, T NullValue = static_cast<T>(0)>
+class HandleView
+{
+public:
+	using element_type = T;
+
+	// Constructors
+	constexpr HandleView() noexcept = default;
+	constexpr HandleView(T handle) noexcept : m_handle{ handle } {}
+
+	template<typename RT, typename Deleter, typename RefCount>
+	HandleView(const WinHandle<T, NullValue, RT, Deleter, RefCount>& handle) noexcept : m_handle{ handle.get() } {}
+
+	template<typename RT, typename Deleter>
+	HandleView(const UniqueWinHandle<T, NullValue, RT, Deleter>& handle) noexcept : m_handle{ handle.get() } {}
+
+	// Handle operations
+	constexpr bool valid() const noexcept { return m_handle != NullValue; }
+	constexpr T get() const noexcept { return m_handle; }
+	constexpr explicit operator bool() const noexcept { return valid(); }
+
+	// Comparison operators
+	friend constexpr bool operator==(HandleView lhs, HandleView rhs) noexcept { return lhs.m_handle == rhs.m_handle; }
+#if __cpp_impl_three_way_comparison
+	friend constexpr std::strong_ordering operator<=>(HandleView lhs, HandleView rhs) noexcept { return std::compare_three_way{}(lhs.m_handle, rhs.m_handle); }
+#else
+	friend constexpr bool operator!=(HandleView lhs, HandleView rhs) noexcept { return lhs.m_handle != rhs.m_handle; }
+	friend constexpr bool operator<(HandleView lhs, HandleView rhs) noexcept { return lhs.m_handle < rhs.m_handle; }
+	friend constexpr bool operator<=(HandleView lhs, HandleView rhs) noexcept { return lhs.m_handle <= rhs.m_handle; }
+	friend constexpr bool operator>(HandleView lhs, HandleView rhs) noexcept { return lhs.m_handle > rhs.m_handle; }
+	friend constexpr bool operator>=(HandleView lhs, HandleView rhs) noexcept { return lhs.m_handle >= rhs.m_handle; }
+#endif
+
+private:
+	T m_handle{ NullValue };
+};
+
+// Non-owning observer of the handle of a WinHandle, like std::weak_ptr for std::shared_ptr. It keeps
+// the control block alive but not the handle, which is released with the last WinHandle. lock()
+// returns a WinHandle sharing the handle while there is one.
+template<typename T, T NullValue = static_cast<T>(0), typename RT = int, typename Deleter = HandleDeleter<T, RT>, typename RefCount = AtomicRefCount>
+class WeakWinHandle
+{
+public:
+	using handle_type = WinHandle<T, NullValue, RT, Deleter, RefCount>;
+
+#pragma region Constructors
+	// Constructors
+	WeakWinHandle() noexcept = default;
+	WeakWinHandle(const handle_type& handle) noexcept;
+#pragma endregion
+
+#pragma region Copy and move
+	// Copy and move
+	WeakWinHandle(const WeakWinHandle& copy) noexcept;
+	WeakWinHandle(WeakWinHandle&& move) noexcept;
+	WeakWinHandle& operator=(const WeakWinHandle& copy) noexcept;
+	WeakWinHandle& operator=(WeakWinHandle&& move) noexcept;
+	WeakWinHandle& operator=(const handle_type& handle) noexcept;
+#pragma endregion
+
+#pragma region Destructor
+	// Destructor
+	~WeakWinHandle() noexcept;
+#pragma endregion
+
+#pragma region Weak pointer operations
+	// Weak pointer operations
+	[[nodiscard]] handle_type lock() const noexcept; // Empty once the last WinHandle is gone
+	bool expired() const noexcept;
+	long use_count() const noexcept;
+	void reset() noexcept;
+	void swap(WeakWinHandle& other) noexcept;
+#pragma endregion
+
+private:
+	using impl = typename handle_type::impl;
+
+	// Replaces the impl, releasing the weak reference held to the current one
+	void attach(impl* replacement) noexcept;
+
+	impl* m_impl{ nullptr };
+};
+
+// Shared and weak handles are a pointer to the control block, which does not refer back to them.
+// Unique handles are relocatable when their deleter is.
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+struct is_trivially_relocatable<WinHandle<T, NullValue, RT, Deleter, RefCount>> : std::true_type {};
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+struct is_trivially_relocatable<WeakWinHandle<T, NullValue, RT, Deleter, RefCount>> : std::true_type {};
+
+template<typename T, T NullValue, typename RT, typename Deleter>
+struct is_trivially_relocatable<UniqueWinHandle<T, NullValue, RT, Deleter>> : is_trivially_relocatable<Deleter> {};
+
+// WinHandle that threads can load and replace concurrently without a lock, like
+// std::atomic<std::shared_ptr>. A replaced handle is released when the last WinHandle loaded from it
+// is gone. Handles are compared by their control block.
+//
+// The control block address and a count of loads share one 64-bit word. The atomic handle holds a
+// batch of references to the current block and load() takes one of them with a single fetch_add.
+// Every s_refill loads, a reader tops the batch up with a compare and exchange loop, so loads are
+// lock-free but not wait-free. Replacing the block releases the references of the batch that were
+// not handed out, so use_count() of a handle loaded from an AtomicWinHandle includes them. For the
+// same reason such a handle is never unique while the atomic handle holds its block: reset() and
+// ptr() give it a new block rather than changing the handle other threads load. On 64-bit targets the count uses the upper
+// 16 bits of the word, so control block addresses must fit in 48 bits. Targets with tagged pointers
+// or pointers wider than 64 bits are rejected at compile time. With 5-level paging, Linux only maps
+// memory above 47 bits on request; pack() asserts that no block lives there.
+template<typename T, T NullValue = static_cast<T>(0), typename RT = int, typename Deleter = HandleDeleter<T, RT>>
+class AtomicWinHandle
+{
+public:
+	using handle_type = WinHandle<T, NullValue, RT, Deleter, AtomicRefCount>;
+
+#pragma region Constructors
+	// Constructors
+	AtomicWinHandle() noexcept = default;
+	AtomicWinHandle(handle_type handle) noexcept;
+#pragma endregion
+
+#pragma region Copy and move
+	// Copy and move
+	AtomicWinHandle(const AtomicWinHandle&) = delete;
+	AtomicWinHandle& operator=(const AtomicWinHandle&) = delete;
+#pragma endregion
+
+#pragma region Destructor
+	// Destructor
+	~AtomicWinHandle() noexcept;
+#pragma endregion
+
+#pragma region Atomic operations
+	// Atomic operations
+	handle_type load() const noexcept;
+	void store(handle_type desired) noexcept;
+	handle_type exchange(handle_type desired) noexcept;
+	bool compare_exchange_strong(handle_type& expected, handle_type desired) noexcept; // Loads the current handle into expected on failure
+	bool compare_exchange_weak(handle_type& expected, handle_type desired) noexcept;
+
+	operator handle_type() const noexcept;
+	void operator=(handle_type desired) noexcept;
+#pragma endregion
+
+private:
+	using impl = typename handle_type::impl;
+
+	static_assert(sizeof(void*) <= 8 && !winhandle_detail::tagged_pointers<T>, "AtomicWinHandle stores a count in the upper bits of control block addresses, which this target uses");
+
+	static constexpr unsigned s_countShift = sizeof(void*) == 8 ? 48 : 32;
+	static constexpr std::uint64_t s_one = std::uint64_t{ 1 } << s_countShift; // One load in the word
+	static constexpr long s_batch = 1l << 15; // References held by the atomic handle
+	static constexpr long s_refill = 1l << 12; // Loads after which a reader tops up the batch
+
+	static std::uint64_t pack(impl* block) noexcept;
+	static impl* block(std::uint64_t word) noexcept;
+	static long loads(std::uint64_t word) noexcept;
+
+	static impl* adopt(handle_type& handle) noexcept; // Takes the reference of handle and adds the rest of a batch
+	static void settle(std::uint64_t word, long keep) noexcept; // Releases the references of a replaced batch but keep
+	void refill(impl* block) const noexcept;
+
+	mutable std::atomic<std::uint64_t> m_word{ 0 };
+};
+
+
+#pragma region Handle traits
+// Compile-time description of a kind of handle, used through WinHandleFor<Tag> and UniqueWinHandleFor<Tag>.
+// A specialization for a tag type provides:
+//   using type = ...;                       // Raw handle type
+//   using result_type = ...;                // Result of the release function
+//   static constexpr type null_value = ...; // Value of an empty handle
+//   static result_type close(type handle);  // Release function
+// and optionally
+//   static bool is_null(type handle);       // Other values that must not be released, e.g. any negative descriptor
+template<typename Tag>
+struct handle_traits;
+
+// Stateless deleter calling handle_traits<Tag>::close. Values rejected by handle_traits<Tag>::is_null
+// are not released.
+template<typename Tag>
+struct TraitsDeleter
+{
+	using traits = handle_traits<Tag>;
+
+	typename traits::result_type operator()(typename traits::type handle) const noexcept(noexcept(traits::close(handle)))
+	{
+		if constexpr (requires { traits::is_null(handle); })
+		{
+			if (traits::is_null(handle))
+				return typename traits::result_type{};
+		}
+		return traits::close(handle);
+	}
+};
+
+// Handle types configured entirely by handle_traits<Tag>. They store no deleter and can be
+// constructed directly from a raw value, e.g. WinHandleFor<fd_tag> fd{ ::open(...) }.
+template<typename Tag, typename RefCount = AtomicRefCount>
+using WinHandleFor = WinHandle<typename handle_traits<Tag>::type, handle_traits<Tag>::null_value, typename handle_traits<Tag>::result_type, TraitsDeleter<Tag>, RefCount>;
+
+template<typename Tag>
+using UniqueWinHandleFor = UniqueWinHandle<typename handle_traits<Tag>::type, handle_traits<Tag>::null_value, typename handle_traits<Tag>::result_type, TraitsDeleter<Tag>>;
+
+#if defined(__linux__)
+namespace winhandle_detail
+{
+	// Traits shared by the kinds of file descriptors released with close
+	struct fd_traits
+	{
+		using type = int;
+		using result_type = int;
+		static constexpr int null_value = -1;
+
+		static int close(int fd) noexcept { return ::close(fd); }
+		static bool is_null(int fd) noexcept { return fd < 0; }
+	};
+}
+
+struct fd_tag {};
+struct eventfd_tag {};
+struct timerfd_tag {};
+struct memfd_tag {};
+struct file_tag {};
+struct dir_tag {};
+
+// File descriptor, e.g. from open() or socket()
+template<>
+struct handle_traits<fd_tag> : winhandle_detail::fd_traits {};
+
+// Descriptor from eventfd()
+template<>
+struct handle_traits<eventfd_tag> : winhandle_detail::fd_traits {};
+
+// Descriptor from timerfd_create()
+template<>
+struct handle_traits<timerfd_tag> : winhandle_detail::fd_traits {};
+
+// Descriptor from memfd_create()
+template<>
+struct handle_traits<memfd_tag> : winhandle_detail::fd_traits {};
+
+// Stream from fopen()
+template<>
+struct handle_traits<file_tag>
+{
+	using type = std::FILE*;
+	using result_type = int;
+	static constexpr std::FILE* null_value = nullptr;
+
+	static int close(std::FILE* file) noexcept { return std::fclose(file); }
+};
+
+// Directory stream from opendir()
+template<>
+struct handle_traits<dir_tag>
+{
+	using type = DIR*;
+	using result_type = int;
+	static constexpr DIR* null_value = nullptr;
+
+	static int close(DIR* dir) noexcept { return ::closedir(dir); }
+};
+#endif
+#pragma endregion
+
+
+#pragma region HandleTable
+namespace winhandle_detail
+{
+	// Bits of a raw handle value, for hashing
+	template<typename T>
+	std::uint64_t handle_bits(T handle) noexcept
+	{
+		if constexpr (std::is_pointer_v<T>)
+			return static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(handle));
+		else if constexpr (std::is_enum_v<T>)
+			return static_cast<std::uint64_t>(static_cast<std::underlying_type_t<T>>(handle));
+		else
+			return static_cast<std::uint64_t>(handle);
+	}
+
+	// Spreads handle values, which often differ only in a few low bits, over all bits
+	inline std::uint64_t mix_bits(std::uint64_t x) noexcept
+	{
+		x ^= x >> 33;
+		x *= 0xff51afd7ed558ccdull;
+		x ^= x >> 33;
+		return x;
+	}
+
+	// Control bytes of a group of slots in a HandleTable. A full slot holds the low 7 bits of its
+	// hash, empty and deleted slots have the sign bit set. Matching compares the whole group at once.
+	class control_group
+	{
+	public:
+		static constexpr std::size_t size = 16;
+		static constexpr signed char empty = -128;
+		static constexpr signed char deleted = -2;
+
+		explicit control_group(const signed char* control) noexcept;
+
+		// Bit i is set when slot i of the group matches
+		unsigned match(signed char hash) const noexcept;
+		unsigned match_empty() const noexcept;
+		unsigned match_free() const noexcept; // Empty or deleted
+
+	private:
+#if defined(WINHANDLE_SSE2)
+		__m128i m_control;
+#else
+		const signed char* m_control;
+#endif
+	};
+}
+
+// Flat hash map from raw handle values to V using open addressing. Slots are probed a group of
+// control bytes at a time, with SSE2 where available. Lookups accept a raw value or any handle
+// with get(), e.g. a WinHandle. Pointers to values stay valid until the table is rehashed.
+template<typename T, typename V>
+class HandleTable
+{
+public:
+	using key_type = T;
+	using mapped_type = V;
+
+	// Constructors
+	HandleTable() noexcept = default;
+	explicit HandleTable(std::size_t capacity);
+
+	// Copy and move
+	HandleTable(const HandleTable&) = delete;
+	HandleTable(HandleTable&& move) noexcept;
+	HandleTable& operator=(const HandleTable&) = delete;
+	HandleTable& operator=(HandleTable&& move) noexcept;
+
+	// Destructor
+	~HandleTable() noexcept;
+
+	// Modifiers. emplace() returns the value and whether it was inserted.
+	template<typename... Args>
+	std::pair<V*, bool> emplace(T key, Args&&... args);
+	bool erase(T key) noexcept;
+	void clear() noexcept;
+	void reserve(std::size_t count);
+
+	// Lookup
+	V* find(T key) noexcept;
+	const V* find(T key) const noexcept;
+	bool contains(T key) const noexcept;
+
+	template<typename Handle, typename = decltype(static_cast<T>(std::declval<const Handle&>().get()))>
+	V* find(const Handle& handle) noexcept { return find(static_cast<T>(handle.get())); }
+
+	template<typename Handle, typename = decltype(static_cast<T>(std::declval<const Handle&>().get()))>
+	const V* find(const Handle& handle) const noexcept { return find(static_cast<T>(handle.get())); }
+
+	// Calls f(key, value) for every entry
+	template<typename F>
+	void for_each(F&& f);
+
+	// Capacity
+	std::size_t size() const noexcept;
+	bool empty() const noexcept;
+	std::size_t capacity() const noexcept;
+
+private:
+	struct slot
+	{
+		T key;
+		V value;
+	};
+
+	static std::uint64_t hash(T key) noexcept;
+	std::size_t locate(T key, std::uint64_t h) const noexcept; // Index of the slot holding key, or capacity()
+	std::size_t claim(std::uint64_t h) noexcept; // Index of a free slot for a new key
+	void rehash(std::size_t capacity);
+	void release() noexcept;
+
+	signed char* m_control{ nullptr };
+	slot* m_slots{ nullptr };
+	std::size_t m_capacity{ 0 };
+	std::size_t m_size{ 0 };
+	std::size_t m_deleted{ 0 };
+};
+#pragma endregion
+
+#pragma region HandleWaitSet
+// Layout of the entries of a HandleWaitSet. The primary template is for APIs taking an array of
+// raw handles, e.g. WaitForMultipleObjects. Specializations describe other layouts, e.g. pollfd.
+// offset is the position of the raw handle in an entry, assign() replaces it and keeps the rest.
+template<typename Entry>
+struct wait_entry
+{
+	using handle_type = Entry;
+	static constexpr std::size_t offset = 0;
+
+	static Entry make(Entry handle) noexcept { return handle; }
+	static Entry handle(const Entry& entry) noexcept { return entry; }
+	static void assign(Entry& entry, Entry handle) noexcept { entry = handle; }
+};
+
+#if defined(__linux__)
+template<>
+struct wait_entry<pollfd>
+{
+	using handle_type = int;
+	static constexpr std::size_t offset = offsetof(pollfd, fd);
+
+	static pollfd make(int fd, short events = POLLIN) noexcept { return { fd, events, 0 }; }
+	static int handle(const pollfd& entry) noexcept { return entry.fd; }
+	static void assign(pollfd& entry, int fd) noexcept { entry.fd = fd; }
+};
+#endif
+
+namespace winhandle_detail
+{
+	// Index of the first entry holding handle, or count. Compares 16 bytes of entries at a time
+	// with SSE2 when the entry size divides 16 and the raw handle is a 4 or 8 byte scalar.
+	template<typename Entry>
+	std::size_t find_entry(const Entry* entries, std::size_t count, typename wait_entry<Entry>::handle_type handle) noexcept;
+}
+
+// Set of handles waited on together. The set owns the handles and keeps their raw values in a
+// contiguous array of Entry, so data() can be passed to poll() or WaitForMultipleObjects()
+// as it is. Removing an entry moves the last entry into its place, so indices are not stable.
+// A handle may change after it was added, through handle(index) or through a WinHandle sharing it,
+// so the non-const data() and entries() first refresh the raw values. find() and the const
+// accessors see the values of the last refresh, i.e. the ones last waited on.
+template<typename Handle, typename Entry = typename Handle::element_type>
+class HandleWaitSet
+{
+public:
+	using handle_type = typename wait_entry<Entry>::handle_type;
+	using entry_type = Entry;
+
+	static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+	// Modifiers. add() returns the index of the new entry, extra arguments are passed to
+	// wait_entry<Entry>::make(), e.g. the events of a pollfd.
+	template<typename... Args>
+	std::size_t add(Handle handle, Args&&... args);
+	Handle remove(std::size_t index);
+	void clear() noexcept;
+	void reserve(std::size_t count);
+
+	// Lookup. find() returns the index of the entry of a raw handle, or npos.
+	std::size_t find(handle_type handle) const noexcept;
+	Handle& handle(std::size_t index) noexcept;
+	const Handle& handle(std::size_t index) const noexcept;
+	Entry& entry(std::size_t index) noexcept;
+	const Entry& entry(std::size_t index) const noexcept;
+
+	// Contiguous entries for the wait API. refresh() copies the current raw value of every handle
+	// into its entry, keeping the rest of the entry.
+	void refresh() noexcept;
+	Entry* data() noexcept;
+	const Entry* data() const noexcept;
+	std::span<Entry> entries() noexcept;
+	std::span<const Entry> entries() const noexcept;
+
+	// Capacity
+	std::size_t size() const noexcept;
+	bool empty() const noexcept;
+
+private:
+	std::vector<Entry> m_entries;
+	std::vector<Handle> m_handles;
+};
+#pragma endregion
+
+#pragma region HandleVector
+namespace winhandle_detail
+{
+	// Number of handles in handles that are not null
+	template<typename T>
+	std::size_t count_not_null(const T* handles, std::size_t count, T null) noexcept;
+
+	// Index of the first handle from index first on that is not null, or count
+	template<typename T>
+	std::size_t find_not_null(const T* handles, std::size_t first, std::size_t count, T null) noexcept;
+}
+
+// Vector of raw handles of one kind that share a single deleter, e.g. many file descriptors. Each
+// element takes sizeof(T) bytes instead of a control block. Closed or released elements hold
+// NullValue until they are reused or removed. Elements can be closed in bulk or extracted as a
+// WinHandle or UniqueWinHandle with a copy of the deleter.
+template<typename T, T NullValue = static_cast<T>(0), typename RT = int, typename Deleter = HandleDeleter<T, RT>>
+class HandleVector : private winhandle_detail::deleter_storage<Deleter>
+{
+public:
+	using element_type = T;
+	using deleter_type = Deleter;
+
+	// Constructors
+	HandleVector() = default;
+	explicit HandleVector(const Deleter& deleter);
+	explicit HandleVector(Deleter&& deleter) noexcept;
+
+	// Copy and move
+	HandleVector(const HandleVector&) = delete;
+	HandleVector(HandleVector&& move) noexcept;
+	HandleVector& operator=(const HandleVector&) = delete;
+	HandleVector& operator=(HandleVector&& move) noexcept;
+
+	// Destructor
+	~HandleVector() noexcept;
+
+	// Modifiers. Removing an element closes it.
+	void push_back(T handle);
+	void pop_back() noexcept;
+	void clear() noexcept;
+	void reserve(std::size_t count);
+
+	// Handle operations on a single element, which holds NullValue afterwards
+	RT close(std::size_t index) noexcept;
+	T release(std::size_t index) noexcept;
+	WinHandle<T, NullValue, RT, Deleter> extract(std::size_t index);
+	UniqueWinHandle<T, NullValue, RT, Deleter> extract_unique(std::size_t index);
+
+	// Closes every valid element, leaving NullValue, and returns the number of elements closed. The
+	// results are stored like with close_all() for WinHandle.
+	std::size_t close_all(std::span<std::type_identity_t<RT>> results = {}) noexcept;
+
+	// Bulk scans. Null elements are skipped comparing 16 bytes at a time with SSE2.
+	std::size_t count_valid() const noexcept;
+	std::size_t next_valid(std::size_t first) const noexcept; // Index of the next valid element, or size()
+
+	// Element access
+	T operator[](std::size_t index) const noexcept;
+	bool valid(std::size_t index) const noexcept;
+	const T* data() const noexcept;
+	std::span<const T> handles() const noexcept;
+	Deleter& get_deleter() noexcept;
+	const Deleter& get_deleter() const noexcept;
+
+	// Capacity
+	std::size_t size() const noexcept;
+	bool empty() const noexcept;
+
+private:
+	using storage = winhandle_detail::deleter_storage<Deleter>;
+
+	std::vector<T> m_handles;
+};
+#pragma endregion
+
+#pragma region HandleCache
+// Cache of shared handles by key, e.g. a path and open flags, so that handles opened again and again
+// are opened once. get() opens missing handles with a factory outside of any lock, and concurrent
+// calls for the same key wait for the first one instead of opening the handle again. Handles the
+// factory returns invalid are not cached. Keys are spread over shards that are locked independently.
+//
+// Cached handles no longer used anywhere else (use_count() == 1) are idle. When the cache holds more
+// than budget handles, idle ones are closed in least recently used order. Handles that are in use
+// stay cached, since they are open either way. The default budget is half of RLIMIT_NOFILE.
+template<typename Key, typename Handle, typename Hash = std::hash<Key>, typename KeyEqual = std::equal_to<Key>>
+class HandleCache
+{
+public:
+	using key_type = Key;
+	using handle_type = Handle;
+
+	// Constructors. shards is rounded up to a power of two, 0 uses one per hardware thread.
+	explicit HandleCache(std::size_t budget = default_budget(), std::size_t shards = 0);
+
+	// Copy and move
+	HandleCache(const HandleCache&) = delete;
+	HandleCache& operator=(const HandleCache&) = delete;
+
+	// Lookup. get() calls factory(key) on a miss, find() only returns cached handles.
+	template<typename Factory>
+	Handle get(const Key& key, Factory&& factory);
+	Handle find(const Key& key);
+
+	// Eviction. trim() closes every idle handle and returns the number closed.
+	bool erase(const Key& key);
+	std::size_t trim();
+
+	// Capacity
+	std::size_t size() const noexcept;
+	std::size_t budget() const noexcept;
+	static std::size_t default_budget() noexcept;
+
+private:
+	// Cached handle, linked in the least recently used list of its shard once it is loaded
+	struct entry
+	{
+		Handle handle{};
+		const Key* key{ nullptr };
+		entry* prev{ nullptr };
+		entry* next{ nullptr };
+		bool loading{ true };
+	};
+
+	struct alignas(64) shard
+	{
+		std::mutex mutex;
+		std::condition_variable loaded;
+		std::unordered_map<Key, entry, Hash, KeyEqual> entries;
+		entry* head{ nullptr }; // Most recently used
+		entry* tail{ nullptr }; // Least recently used
+	};
+
+	std::size_t shard_index(const Key& key) const noexcept;
+	static void link_front(shard& s, entry& e) noexcept;
+	static void unlink(shard& s, entry& e) noexcept;
+
+	// Moves idle handles of a shard to victims, least recently used first, until the cache is
+	// within budget or, with all, every idle handle. Called with the shard locked.
+	void evict(shard& s, bool all, std::vector<Handle>& victims);
+	void make_room(std::size_t first);
+
+	std::unique_ptr<shard[]> m_shards;
+	std::size_t m_mask;
+	std::size_t m_budget;
+	std::atomic<std::size_t> m_size{ 0 };
+};
+#pragma endregion
+
+#pragma region MutableHandles
+namespace winhandle_detail
+{
+	// WinHandle::pool() for shared handles, no resource for handles without control blocks
+	template<typename Handle>
+	std::pmr::memory_resource* default_pool() noexcept
+	{
+		if constexpr (requires { Handle::pool(); })
+			return Handle::pool();
+		else
+			return nullptr;
+	}
+}
+
+// Out parameter for functions that produce several handles through one array, e.g. pipe() or
+// socketpair(). It converts to a T* and a std::span<T> over N values, which start out as the values
+// of the owners. All owners are updated together when it is destroyed, like with WinHandle::ptr(), so
+//
+//   ::pipe(ptrs(readEnd, writeEnd));
+//
+// fills both handles. Owners without a control block get one from resource. cancel() leaves the
+// owners unchanged, for functions that may write to the array when they fail.
+template<typename Handle, std::size_t N>
+class MutableHandles
+{
+public:
+	using element_type = typename Handle::element_type;
+
+	// Constructors
+	explicit MutableHandles(std::span<Handle, N> owners, std::pmr::memory_resource* resource = nullptr) noexcept;
+
+	template<typename... Owners>
+		requires (sizeof...(Owners) == N && (std::is_same_v<Owners, Handle> && ...))
+	explicit MutableHandles(Owners&... owners) noexcept;
+
+	// Copy and move
+	MutableHandles(const MutableHandles&) = delete;
+	MutableHandles(MutableHandles&&) = delete;
+	MutableHandles& operator=(const MutableHandles&) = delete;
+	MutableHandles& operator=(MutableHandles&&) = delete;
+
+	// Destructor
+	~MutableHandles() noexcept;
+
+	// Conversion operators
+	operator element_type* () noexcept;
+	operator std::span<element_type>() noexcept;
+
+	element_type* data() noexcept;
+	void cancel() noexcept;
+
+private:
+	Handle* m_owners[N];
+	element_type m_handles[N];
+	std::pmr::memory_resource* m_resource{ nullptr };
+};
+
+// Out parameter filling all of handles, e.g. ::pipe(ptrs(readEnd, writeEnd))
+template<typename Handle, typename... Handles>
+[[nodiscard]] MutableHandles<Handle, 1 + sizeof...(Handles)> ptrs(Handle& first, Handles&... rest) noexcept;
+
+// Fills handles in groups of Group, e.g. thousands of pipes with Group 2. function is called with a
+// pointer to the Group values of each group and returns false when it fails, which ends the batch.
+// Control blocks of new handles come from resource, by default WinHandle::pool(). Returns the number
+// of groups filled.
+template<std::size_t Group, typename Handle, typename Function>
+std::size_t acquire_groups(std::span<Handle> handles, Function&& function, std::pmr::memory_resource* resource = winhandle_detail::default_pool<Handle>());
+#pragma endregion
+
+#pragma region SmallHandleVector
+namespace winhandle_detail
+{
+	// Moves count objects from source to uninitialized target and ends their lifetime in source. The
+	// ranges may overlap when target comes before source.
+	template<typename T>
+	void relocate(T* source, std::size_t count, T* target) noexcept;
+}
+
+// Vector of handles, e.g. WinHandle or UniqueWinHandle, storing up to InlineCapacity of them without
+// allocating. When the element type is trivially relocatable (see is_trivially_relocatable), growing
+// and erasing copy the bytes of the elements with memcpy and memmove instead of moving and destroying
+// them one by one.
+template<typename Handle, std::size_t InlineCapacity = 4>
+class SmallHandleVector
+{
+public:
+	using value_type = Handle;
+	using size_type = std::size_t;
+	using iterator = Handle*;
+	using const_iterator = const Handle*;
+
+	static_assert(std::is_nothrow_move_constructible_v<Handle>, "SmallHandleVector requires handles that can be moved without throwing");
+
+	// Constructors
+	SmallHandleVector() noexcept;
+	SmallHandleVector(std::initializer_list<Handle> handles);
+
+	// Copy and move
+	SmallHandleVector(const SmallHandleVector& copy);
+	SmallHandleVector(SmallHandleVector&& move) noexcept;
+	SmallHandleVector& operator=(const SmallHandleVector& copy);
+	SmallHandleVector& operator=(SmallHandleVector&& move) noexcept;
+
+	// Destructor
+	~SmallHandleVector() noexcept;
+
+	// Modifiers
+	void push_back(const Handle& handle);
+	void push_back(Handle&& handle);
+	template<typename... Args>
+	Handle& emplace_back(Args&&... args);
+	void pop_back() noexcept;
+	iterator erase(const_iterator position) noexcept;
+	iterator erase(const_iterator first, const_iterator last) noexcept;
+	void clear() noexcept;
+	void reserve(size_type capacity);
+	void swap(SmallHandleVector& other) noexcept;
+
+	// Element access
+	Handle& operator[](size_type index) noexcept;
+	const Handle& operator[](size_type index) const noexcept;
+	Handle& front() noexcept;
+	Handle& back() noexcept;
+	Handle* data() noexcept;
+	const Handle* data() const noexcept;
+
+	// Iterators
+	iterator begin() noexcept;
+	iterator end() noexcept;
+	const_iterator begin() const noexcept;
+	const_iterator end() const noexcept;
+
+	// Capacity
+	size_type size() const noexcept;
+	size_type capacity() const noexcept;
+	bool empty() const noexcept;
+	bool is_inline() const noexcept; // True while the elements are stored inside the vector
+
+private:
+	Handle* inline_data() noexcept;
+	size_type grown(size_type required) const noexcept;
+	void reallocate(size_type capacity) noexcept(false);
+	void release_storage() noexcept;
+
+	Handle* m_data;
+	size_type m_size{ 0 };
+	size_type m_capacity{ InlineCapacity };
+	alignas(Handle) unsigned char m_inline[sizeof(Handle) * (InlineCapacity ? InlineCapacity : 1)];
+};
+#pragma endregion
+
+
+#pragma region Comparison operators
+
+#pragma region WinHandle comparison
+// Comparison operators
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount, typename U, typename UDeleter, typename URefCount>
+bool operator ==(const WinHandle<T, NullValue, RT, Deleter, RefCount>& lhs, const WinHandle<U, NullValue, RT, UDeleter, URefCount>& rhs) noexcept
+{
+	return lhs.get() == rhs.get();
+}
+
+#if !__cpp_impl_three_way_comparison
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount, typename U, typename UDeleter, typename URefCount>
+bool operator !=(const WinHandle<T, NullValue, RT, Deleter, RefCount>& lhs, const WinHandle<U, NullValue, RT, UDeleter, URefCount>& rhs) noexcept
+{
+	return lhs.get() != rhs.get();
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount, typename U, typename UDeleter, typename URefCount>
+bool operator <(const WinHandle<T, NullValue, RT, Deleter, RefCount>& lhs, const WinHandle<U, NullValue, RT, UDeleter, URefCount>& rhs) noexcept
+{
+	return lhs.get() < rhs.get();
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount, typename U, typename UDeleter, typename URefCount>
+bool operator <=(const WinHandle<T, NullValue, RT, Deleter, RefCount>& lhs, const WinHandle<U, NullValue, RT, UDeleter, URefCount>& rhs) noexcept
+{
+	return lhs.get() <= rhs.get();
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount, typename U, typename UDeleter, typename URefCount>
+bool operator >(const WinHandle<T, NullValue, RT, Deleter, RefCount>& lhs, const WinHandle<U, NullValue, RT, UDeleter, URefCount>& rhs)
+{
+	return lhs.get() > rhs.get();
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount, typename U, typename UDeleter, typename URefCount>
+bool operator >=(const WinHandle<T, NullValue, RT, Deleter, RefCount>& lhs, const WinHandle<U, NullValue, RT, UDeleter, URefCount>& rhs) noexcept
+{
+	return lhs.get() >= rhs.get();
+}
+
+#else // !__cpp_impl_three_way_comparison
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount, typename U, typename UDeleter, typename URefCount>
+std::strong_ordering operator <=>(const WinHandle<T, NullValue, RT, Deleter, RefCount>& lhs, const WinHandle<U, NullValue, RT, UDeleter, URefCount>& rhs) noexcept
+{
+	return std::compare_three_way{}(lhs.get(), rhs.get());
+}
+
+#endif // !__cpp_impl_three_way_comparison
+
+#pragma endregion
+
+#pragma region Handle comparison operators
+// Handle comparison operators
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+bool operator ==(const T& lhs, const WinHandle<T, NullValue, RT, Deleter, RefCount>& rhs) noexcept
+{
+	return lhs == rhs.get();
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+bool operator ==(const WinHandle<T, NullValue, RT, Deleter, RefCount>& lhs, const T& rhs) noexcept
+{
+	return lhs.get() == rhs;
+}
+
+#if !__cpp_impl_three_way_comparison
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+bool operator !=(const T& lhs, const WinHandle<T, NullValue, RT, Deleter, RefCount>& rhs) noexcept
+{
+	return lhs != rhs.get();
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+bool operator !=(const WinHandle<T, NullValue, RT, Deleter, RefCount>& lhs, const T& rhs) noexcept
+{
+	return lhs.get() != rhs;
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+bool operator <(const T& lhs, const WinHandle<T, NullValue, RT, Deleter, RefCount>& rhs) noexcept
+{
+	return lhs < rhs.get();
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+bool operator <(const WinHandle<T, NullValue, RT, Deleter, RefCount>& lhs, const T& rhs) noexcept
+{
+	return lhs.get() < rhs;
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+bool operator <=(const T& lhs, const WinHandle<T, NullValue, RT, Deleter, RefCount>& rhs) noexcept
+{
+	return lhs <= rhs.get();
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+bool operator <=(const WinHandle<T, NullValue, RT, Deleter, RefCount>& lhs, const T& rhs) noexcept
+{
+	return lhs.get() <= rhs;
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+bool operator >(const T& lhs, const WinHandle<T, NullValue, RT, Deleter, RefCount>& rhs) noexcept
+{
+	return lhs > rhs.get();
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+bool operator >(const WinHandle<T, NullValue, RT, Deleter, RefCount>& lhs, const T& rhs) noexcept
+{
+	return lhs.get() > rhs;
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+bool operator >=(const T& lhs, const WinHandle<T, NullValue, RT, Deleter, RefCount>& rhs) noexcept
+{
+	return lhs >= rhs.get();
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+bool operator >=(const WinHandle<T, NullValue, RT, Deleter, RefCount>& lhs, const T& rhs) noexcept
+{
+	return lhs.get() >= rhs;
+}
+
+#else // !__cpp_impl_three_way_comparison
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+std::strong_ordering operator <=>(const T& lhs, const WinHandle<T, NullValue, RT, Deleter, RefCount>& rhs) noexcept
+{
+	return std::compare_three_way{}(lhs, rhs.get());
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+std::strong_ordering operator <=>(const WinHandle<T, NullValue, RT, Deleter, RefCount>& lhs, const T& rhs) noexcept
+{
+	return std::compare_three_way{}(lhs.get(), rhs);
+}
+
+#endif // !__cpp_impl_three_way_comparison
+
+#pragma endregion
+
+#pragma endregion
+
+#pragma region std::hash
+// Hashes of handles are the hashes of their raw values. They are transparent, so unordered
+// containers using std::equal_to<> can look up handles by raw value.
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+struct std::hash<WinHandle<T, NullValue, RT, Deleter, RefCount>>
+{
+	using is_transparent = void;
+
+	std::size_t operator()(const WinHandle<T, NullValue, RT, Deleter, RefCount>& handle) const noexcept { return std::hash<T>{}(handle.get()); }
+	std::size_t operator()(const T& handle) const noexcept { return std::hash<T>{}(handle); }
+};
+
+template<typename T, T NullValue, typename RT, typename Deleter>
+struct std::hash<UniqueWinHandle<T, NullValue, RT, Deleter>>
+{
+	using is_transparent = void;
+
+	std::size_t operator()(const UniqueWinHandle<T, NullValue, RT, Deleter>& handle) const noexcept { return std::hash<T>{}(handle.get()); }
+	std::size_t operator()(const T& handle) const noexcept { return std::hash<T>{}(handle); }
+};
+
+template<typename T, T NullValue>
+struct std::hash<HandleView<T, NullValue>>
+{
+	using is_transparent = void;
+
+	std::size_t operator()(HandleView<T, NullValue> handle) const noexcept { return std::hash<T>{}(handle.get()); }
+};
+#pragma endregion
+
+#pragma region WinHandle implementation
+//////////////////////////////////////////////////////////////////////////
+// WinHandle implementation
+
+#pragma region Constructors
+// Constructors
+
+// Empty handles without a custom deleter have no impl. One is created when a value is first stored.
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+WinHandle<T, NullValue, RT, Deleter, RefCount>::WinHandle() noexcept
+{
+}
+
+// Handles whose deleter can be empty must be given one, or nullptr for a non-owning handle
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+WinHandle<T, NullValue, RT, Deleter, RefCount>::WinHandle(T handle) requires winhandle_detail::releases_by_default<Deleter>
+	: m_impl{ handle != NullValue ? new impl(handle) : nullptr }
+{
+}
+
+// Non-owning handles take their impl from pool(), so creating many of them rarely allocates. The impl
+// does not release the handle given here, only the ones stored in it later, so any deleter will do.
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+WinHandle<T, NullValue, RT, Deleter, RefCount>::WinHandle(T handle, std::nullptr_t)
+	: m_impl{ handle != NullValue ? impl::create(pool(), handle, nullptr) : nullptr }
+{
+	static_assert(std::is_default_constructible_v<Deleter>, "Non-owning handles require a default constructible deleter type");
+}
+
+// Deleter object
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+WinHandle<T, NullValue, RT, Deleter, RefCount>::WinHandle(Deleter deleter)
+	: m_impl{ impl::custom(deleter) ? new impl(NullValue, std::move(deleter)) : nullptr }
+{
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+WinHandle<T, NullValue, RT, Deleter, RefCount>::WinHandle(T handle, Deleter deleter)
+	: m_impl{ new impl(handle, std::move(deleter)) }
+{
+}
+
+// Function pointer
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+template<typename DType>
+WinHandle<T, NullValue, RT, Deleter, RefCount>::WinHandle(RT(WINHANDLE_STDCALL* deleter)(DType))
+	: m_impl{ new impl(NullValue, Deleter(deleter)) }
+{
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+template<typename DType, typename... Args>
+WinHandle<T, NullValue, RT, Deleter, RefCount>::WinHandle(RT(WINHANDLE_STDCALL* deleter)(DType, Args...), Args&&... args)
+	: m_impl{ new impl(NullValue, winhandle_detail::make_deleter<Deleter>(winhandle_detail::bound_function<decltype(deleter), std::decay_t<Args>...>{ deleter, { std::forward<Args>(args)... } })) }
+{
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+template<typename DType>
+WinHandle<T, NullValue, RT, Deleter, RefCount>::WinHandle(T handle, RT(WINHANDLE_STDCALL* deleter)(DType))
+	: m_impl{ new impl(handle, Deleter(deleter)) }
+{
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+template<typename DType, typename... Args>
+WinHandle<T, NullValue, RT, Deleter, RefCount>::WinHandle(T handle, RT(WINHANDLE_STDCALL* deleter)(DType, Args...), Args&&... args)
+	: m_impl{ new impl(handle, winhandle_detail::make_deleter<Deleter>(winhandle_detail::bound_function<decltype(deleter), std::decay_t<Args>...>{ deleter, { std::forward<Args>(args)... } })) }
+{
+}
+
+// Member function pointer
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+template<typename Class, typename DType>
+WinHandle<T, NullValue, RT, Deleter, RefCount>::WinHandle(RT(WINHANDLE_STDCALL Class::* deleter)(DType), Class* instance)
+	: m_impl{ new impl(NullValue, winhandle_detail::make_deleter<Deleter>(winhandle_detail::bound_member<decltype(deleter), Class>{ deleter, instance, {} })) }
+{
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+template<typename Class, typename DType, typename... Args>
+WinHandle<T, NullValue, RT, Deleter, RefCount>::WinHandle(RT(WINHANDLE_STDCALL Class::* deleter)(DType, Args...), Class* instance, Args&&... args)
+	: m_impl{ new impl(NullValue, winhandle_detail::make_deleter<Deleter>(winhandle_detail::bound_member<decltype(deleter), Class, std::decay_t<Args>...>{ deleter, instance, { std::forward<Args>(args)... } })) }
+{
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+template<typename Class, typename DType>
+WinHandle<T, NullValue, RT, Deleter, RefCount>::WinHandle(T handle, RT(WINHANDLE_STDCALL Class::* deleter)(DType), Class* instance)
+	: m_impl{ new impl(handle, winhandle_detail::make_deleter<Deleter>(winhandle_detail::bound_member<decltype(deleter), Class>{ deleter, instance, {} })) }
+{
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+template<typename Class, typename DType, typename... Args>
+WinHandle<T, NullValue, RT, Deleter, RefCount>::WinHandle(T handle, RT(WINHANDLE_STDCALL Class::* deleter)(DType, Args...), Class* instance, Args&&... args)
+	: m_impl{ new impl(handle, winhandle_detail::make_deleter<Deleter>(winhandle_detail::bound_member<decltype(deleter), Class, std::decay_t<Args>...>{ deleter, instance, { std::forward<Args>(args)... } })) }
+{
+}
+
+// Adopts an impl that already holds a reference for this handle
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+WinHandle<T, NullValue, RT, Deleter, RefCount>::WinHandle(impl* adopt) noexcept
+	: m_impl{ adopt }
+{
+}
+
+// Promotion of a unique handle to a shared handle
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+template<typename UniqueDeleter>
+WinHandle<T, NullValue, RT, Deleter, RefCount>::WinHandle(UniqueWinHandle<T, NullValue, RT, UniqueDeleter>&& unique)
+	: m_impl{ new impl(unique.get(), Deleter(unique.get_deleter())) }
+{
+	// The unique handle keeps ownership until the impl has been created successfully
+	static_cast<void>(unique.release());
+}
+
+#pragma endregion
+
+#pragma region Copy and move constructors
+// Copy and move constructors
+// Copies share an impl, so an empty handle gets one when it is first copied. A moved-from handle is
+// left empty without allocating. It holds a weak reference to the impl it gave up if that has a
+// custom deleter, which releases the values stored in it afterwards.
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+WinHandle<T, NullValue, RT, Deleter, RefCount>::WinHandle(const WinHandle& copy)
+	: m_impl{ copy.shared() }
+{
+	retain(m_impl);
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+WinHandle<T, NullValue, RT, Deleter, RefCount>::WinHandle(WinHandle&& move) noexcept
+	: m_impl{ move.m_impl }
+{
+	move.m_impl = moved_from(m_impl);
+}
+
+#pragma endregion
+
+#pragma region Destructor
+// Destructor
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+WinHandle<T, NullValue, RT, Deleter, RefCount>::~WinHandle() noexcept
+{
+	attach(nullptr);
+}
+
+#pragma endregion
+
+#pragma region Copy and move assignment operators
+// Copy and move assignment operators
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+WinHandle<T, NullValue, RT, Deleter, RefCount>& WinHandle<T, NullValue, RT, Deleter, RefCount>::operator =(const WinHandle& copy)
+{
+	impl* shared = copy.shared();
+	retain(shared);
+	attach(shared);
+	return *this;
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+WinHandle<T, NullValue, RT, Deleter, RefCount>& WinHandle<T, NullValue, RT, Deleter, RefCount>::operator =(WinHandle&& move) noexcept
+{
+	if (this == &move)
+		return *this;
+
+	// The source is left with the reference held here when that carries the deleter it needs, which
+	// saves taking a weak reference on every move, e.g. when handles move down a vector
+	impl* taken = move.m_impl;
+	if (recycle(taken))
+		move.m_impl = std::exchange(m_impl, taken);
+	else
+	{
+		move.m_impl = moved_from(taken);
+		attach(taken);
+	}
+	return *this;
+}
+
+#pragma endregion
+
+#pragma region Assignment operators
+// Assignment operators
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+WinHandle<T, NullValue, RT, Deleter, RefCount>& WinHandle<T, NullValue, RT, Deleter, RefCount>::operator=(const T& handle)
+{
+	if (impl* current = block())
+		current->assign(handle);
+	else if (handle != NullValue)
+		attach(create(handle));
+	return *this;
+}
+
+#pragma endregion
+
+#pragma region Conversion operators
+// Conversion operators
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+WinHandle<T, NullValue, RT, Deleter, RefCount>::operator bool_type() const noexcept
+{
+	return valid() ? &WinHandle::this_type_does_not_support_comparisons : nullptr;
+}
+
+#pragma endregion
+
+#pragma region Smart pointer operations
+// Smart pointer operations
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+void WinHandle<T, NullValue, RT, Deleter, RefCount>::swap(WinHandle& other) noexcept
+{
+	std::swap(m_impl, other.m_impl);
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+void WinHandle<T, NullValue, RT, Deleter, RefCount>::reset()
+{
+	// Only an impl with a custom deleter needs to be kept around for future values. One that no one
+	// else refers to is emptied in place. A moved-from handle is already empty.
+	impl* current = block();
+	if (current && current->custom_deleter())
+	{
+		if (current->unique())
+			current->assign(NullValue);
+		else
+			attach(impl::create(current->resource(), NullValue, current->deleter()));
+	}
+	else if (current)
+		attach(nullptr);
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+void WinHandle<T, NullValue, RT, Deleter, RefCount>::reset(T handle)
+{
+	if (handle == get())
+		return;
+
+	// An impl no one else refers to is reused. Otherwise the replacement is allocated from the same
+	// memory resource as the current one.
+	impl* current = block();
+	if (current && current->unique())
+		current->assign(handle);
+	else if (current && current->custom_deleter())
+		attach(impl::create(current->resource(), handle, current->deleter()));
+	else if (current && handle != NullValue)
+		attach(impl::create(current->resource(), handle));
+	else if (handle != NullValue)
+		attach(create(handle));
+	else
+		attach(nullptr);
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+long WinHandle<T, NullValue, RT, Deleter, RefCount>::use_count() const noexcept
+{
+	// An empty handle without an impl is reported as having a single owner
+	const impl* current = block();
+	return current ? current->use_count() : 1;
+}
+
+#pragma endregion
+
+#pragma region Handle operations
+// Handle operations
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+bool WinHandle<T, NullValue, RT, Deleter, RefCount>::valid() const noexcept
+{
+	return get() != NullValue;
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+T WinHandle<T, NullValue, RT, Deleter, RefCount>::get() const noexcept
+{
+	const impl* current = block();
+	return current ? current->get() : NullValue;
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+const T* WinHandle<T, NullValue, RT, Deleter, RefCount>::ptr() const noexcept
+{
+	const impl* current = block();
+	return current ? current->ptr() : &s_nullHandle;
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+typename WinHandle<T, NullValue, RT, Deleter, RefCount>::MutableHandle WinHandle<T, NullValue, RT, Deleter, RefCount>::ptr() noexcept
+{
+	return MutableHandle(*this);
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+RT WinHandle<T, NullValue, RT, Deleter, RefCount>::close() noexcept
+{
+	impl* current = block();
+	return current ? current->assign(NullValue) : RT{};
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+typename WinHandle<T, NullValue, RT, Deleter, RefCount>::Lease WinHandle<T, NullValue, RT, Deleter, RefCount>::lease() const noexcept
+{
+	static_assert(winhandle_detail::is_concurrent<RefCount>, "Leases require a WinHandle using ConcurrentRefCount");
+	return Lease(*this);
+}
+
+#pragma endregion
+
+#pragma region Allocation
+// Allocation
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+std::pmr::memory_resource* WinHandle<T, NullValue, RT, Deleter, RefCount>::pool() noexcept
+{
+	return &HandlePool<sizeof(impl), alignof(impl)>::instance();
+}
+
+#pragma endregion
+
+#pragma region impl management
+// impl management
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+void WinHandle<T, NullValue, RT, Deleter, RefCount>::attach(impl* replacement) noexcept
+{
+	impl* previous = std::exchange(m_impl, replacement);
+	if (reinterpret_cast<std::uintptr_t>(previous) & s_movedFrom)
+		impl::release_weak(untagged(previous));
+	else if (previous && previous->release())
+		impl::expire(previous);
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+void WinHandle<T, NullValue, RT, Deleter, RefCount>::acquire(T handle, std::pmr::memory_resource* resource)
+{
+	if (!m_impl && resource && handle != NullValue)
+		attach(impl::create(resource, handle));
+	else
+		reset(handle);
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+typename WinHandle<T, NullValue, RT, Deleter, RefCount>::impl* WinHandle<T, NullValue, RT, Deleter, RefCount>::moved_from(impl* value) noexcept
+{
+	impl* donor = untagged(value);
+	if (!donor || (donor == value && !donor->custom_deleter()))
+		return nullptr;
+
+	donor->add_weak();
+	return reinterpret_cast<impl*>(reinterpret_cast<std::uintptr_t>(donor) | s_movedFrom);
+}
+
+// A moved-from reference to an impl with the same deleter can be handed over as it is, for instance
+// one left by moving from the same impl before. An impl no one else refers to is emptied first.
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+bool WinHandle<T, NullValue, RT, Deleter, RefCount>::recycle(impl* taken) noexcept
+{
+	const impl* source = untagged(taken);
+	impl* current = untagged(m_impl);
+	if (!source || !current || (source == taken && !source->custom_deleter()))
+		return false;
+	if (current != source && !winhandle_detail::same_deleter(current->deleter(), source->deleter()))
+		return false;
+
+	if (current == m_impl)
+	{
+		if (current == source || !current->unique())
+			return false;
+		current->assign(NullValue);
+	}
+	return true;
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+typename WinHandle<T, NullValue, RT, Deleter, RefCount>::impl* WinHandle<T, NullValue, RT, Deleter, RefCount>::untagged(impl* value) noexcept
+{
+	return reinterpret_cast<impl*>(reinterpret_cast<std::uintptr_t>(value) & ~s_movedFrom);
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+void WinHandle<T, NullValue, RT, Deleter, RefCount>::retain(impl* value) noexcept
+{
+	if (reinterpret_cast<std::uintptr_t>(value) & s_movedFrom)
+		untagged(value)->add_weak();
+	else if (value)
+		value->add_ref();
+}
+
+// m_impl is read atomically since copying a const handle may give it an impl, see shared()
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+typename WinHandle<T, NullValue, RT, Deleter, RefCount>::impl* WinHandle<T, NullValue, RT, Deleter, RefCount>::block() const noexcept
+{
+	impl* current = std::atomic_ref<impl*>(m_impl).load(std::memory_order_acquire);
+	return reinterpret_cast<std::uintptr_t>(current) & s_movedFrom ? nullptr : current;
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+typename WinHandle<T, NullValue, RT, Deleter, RefCount>::impl* WinHandle<T, NullValue, RT, Deleter, RefCount>::donor() const noexcept
+{
+	impl* current = std::atomic_ref<impl*>(m_impl).load(std::memory_order_acquire);
+	return reinterpret_cast<std::uintptr_t>(current) & s_movedFrom ? untagged(current) : nullptr;
+}
+
+// The donor's handle may be replaced concurrently, but its deleter and memory resource never change
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+typename WinHandle<T, NullValue, RT, Deleter, RefCount>::impl* WinHandle<T, NullValue, RT, Deleter, RefCount>::create(T handle) const
+{
+	if (const impl* source = donor())
+		return impl::create(source->resource(), handle, source->deleter());
+	return impl::create(nullptr, handle);
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+typename WinHandle<T, NullValue, RT, Deleter, RefCount>::impl* WinHandle<T, NullValue, RT, Deleter, RefCount>::shared() const
+{
+	impl* current = std::atomic_ref<impl*>(m_impl).load(std::memory_order_acquire);
+	if (current && !(reinterpret_cast<std::uintptr_t>(current) & s_movedFrom))
+		return current;
+	return share(current);
+}
+
+// An empty or moved-from handle gets an impl holding NullValue before it is copied, so that a value
+// later assigned to the handle or to any copy is seen by all of them. Handles may be copied from
+// several threads at once, so the impl is published with compare and exchange and the losers use
+// the winner's. Without a default constructible deleter an empty handle has nothing to share.
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+typename WinHandle<T, NullValue, RT, Deleter, RefCount>::impl* WinHandle<T, NullValue, RT, Deleter, RefCount>::share(impl* current) const
+{
+	impl* created = nullptr;
+	if (const impl* source = untagged(current))
+		created = impl::create(source->resource(), NullValue, source->deleter());
+	else if constexpr (std::is_default_constructible_v<Deleter>)
+		created = impl::create(nullptr, NullValue);
+	else
+		return nullptr;
+
+	if (!std::atomic_ref<impl*>(m_impl).compare_exchange_strong(current, created, std::memory_order_acq_rel, std::memory_order_acquire))
+	{
+		impl::dispose(created);
+		return current;
+	}
+	if (current)
+		impl::release_weak(untagged(current));
+	return created;
+}
+
+#pragma endregion
+
+#pragma endregion
+
+#pragma region make_handle
+//////////////////////////////////////////////////////////////////////////
+// make_handle
+
+// Creates a WinHandle owning handle. The deleter is constructed from args directly inside the
+// control block, which holds the reference count, the handle and the deleter in one allocation.
+template<typename Handle, typename... Args>
+Handle make_handle(typename Handle::element_type handle, Args&&... args)
+{
+	return Handle(new typename Handle::impl(handle, std::in_place, std::forward<Args>(args)...));
+}
+
+// Like make_handle, but allocates the control block from resource, e.g. Handle::pool().
+// Handles created by reset() on a copy of the result use the same resource.
+template<typename Handle, typename... Args>
+Handle allocate_handle(std::pmr::memory_resource* resource, typename Handle::element_type handle, Args&&... args)
+{
+	return Handle(Handle::impl::create(resource, handle, std::in_place, std::forward<Args>(args)...));
+}
+
+#pragma endregion
+
+#pragma region close_all
+//////////////////////////////////////////////////////////////////////////
+// close_all
+
+// Closes every handle in handles, like calling close() on each of them, and returns the number of
+// handles that were open. The result of each release is stored at the same index in results, if
+// results is large enough; handles that were not open get RT{}. Only file descriptors released with
+// close are grouped: on Linux they are sorted and contiguous ranges are closed with a single
+// close_range() call, unless the handles use ConcurrentRefCount. Handles with any other deleter are
+// released one at a time, in order, since there is no call releasing several of them at once.
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+std::size_t close_all(std::span<WinHandle<T, NullValue, RT, Deleter, RefCount>> handles, std::span<std::type_identity_t<RT>> results)
+{
+	using impl = typename WinHandle<T, NullValue, RT, Deleter, RefCount>::impl;
+
+	const auto store = [results](std::size_t index, RT result) noexcept
+	{
+		if (index < results.size())
+			results[index] = result;
+	};
+
+#if defined(__linux__) && defined(SYS_close_range)
+	constexpr bool collect_fds = std::is_same_v<T, int> && std::is_same_v<RT, int> && !winhandle_detail::is_concurrent<RefCount>;
+	std::vector<std::pair<int, std::size_t>> fds; // Descriptor and index of handles released with close
+#endif
+
+	std::size_t closed = 0;
+	for (std::size_t i = 0; i < handles.size(); ++i)
+	{
+		impl* block = handles[i].block();
+		if (!block || block->get() == NullValue)
+		{
+			store(i, RT{});
+			continue;
+		}
+
+#if defined(__linux__) && defined(SYS_close_range)
+		if constexpr (collect_fds)
+		{
+			if (block->get() >= 0 && block->owned() && winhandle_detail::calls_posix_close(block->deleter()))
+			{
+				fds.emplace_back(block->get(), i);
+				continue;
+			}
+		}
+#endif
+		store(i, block->assign(NullValue));
+		++closed;
+	}
+
+#if defined(__linux__) && defined(SYS_close_range)
+	if constexpr (collect_fds)
+	{
+		std::sort(fds.begin(), fds.end());
+		for (std::size_t first = 0, last = 0; first < fds.size(); first = last)
+		{
+			// Copies of the same handle show up as repeated descriptors
+			for (last = first + 1; last < fds.size() && fds[last].first - fds[last - 1].first <= 1; ++last)
+				;
+
+			const bool ranged = fds[last - 1].first != fds[first].first && winhandle_detail::close_fd_range(fds[first].first, fds[last - 1].first);
+			for (std::size_t k = first; k < last; ++k)
+			{
+				impl* block = handles[fds[k].second].block();
+				if (block->get() == NullValue)
+				{
+					store(fds[k].second, RT{});
+					continue;
+				}
+
+				if (ranged)
+				{
+					block->disown();
+					store(fds[k].second, RT{});
+				}
+				else
+					store(fds[k].second, block->assign(NullValue));
+				++closed;
+			}
+		}
+	}
+#endif
+
+	return closed;
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+std::size_t close_all(std::span<WinHandle<T, NullValue, RT, Deleter, RefCount>> handles)
+{
+	return close_all(handles, std::span<RT>{});
+}
+
+#pragma endregion
+
+#pragma region WinHandle::impl implementation
+//////////////////////////////////////////////////////////////////////////
+// WinHandle::impl implementation
+
+#pragma region Constructors
+// Constructors
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+WinHandle<T, NullValue, RT, Deleter, RefCount>::impl::impl(T handle)
+	: m_handle{ handle }
+{
+	acquired();
+}
+
+// Non-owning
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+WinHandle<T, NullValue, RT, Deleter, RefCount>::impl::impl(T handle, std::nullptr_t) noexcept
+	: m_handle{ handle }, m_owned{ false }
+{
+}
+
+// Deleter object
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+WinHandle<T, NullValue, RT, Deleter, RefCount>::impl::impl(T handle, const Deleter& deleter)
+	: storage{ deleter }, m_handle{ handle }
+{
+	acquired();
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+WinHandle<T, NullValue, RT, Deleter, RefCount>::impl::impl(T handle, Deleter&& deleter) noexcept
+	: storage{ std::move(deleter) }, m_handle{ handle }
+{
+	acquired();
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+template<typename... Args>
+WinHandle<T, NullValue, RT, Deleter, RefCount>::impl::impl(T handle, std::in_place_t, Args&&... args)
+	: storage{ std::in_place, std::forward<Args>(args)... }, m_handle{ handle }
+{
+	acquired();
+}
+
+#pragma endregion
+
+#pragma region Destructor
+// Destructor
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+WinHandle<T, NullValue, RT, Deleter, RefCount>::impl::~impl() noexcept
+{
+	destroy();
+}
+
+#pragma endregion
+
+#pragma region Allocation
+// Allocation
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+template<typename... Args>
+typename WinHandle<T, NullValue, RT, Deleter, RefCount>::impl* WinHandle<T, NullValue, RT, Deleter, RefCount>::impl::create(std::pmr::memory_resource* resource, Args&&... args)
+{
+	if (!resource)
+		return new impl(std::forward<Args>(args)...);
+
+	void* memory = resource->allocate(sizeof(impl), alignof(impl));
+	impl* block = nullptr;
+	try
+	{
+		block = ::new (memory) impl(std::forward<Args>(args)...);
+	}
+	catch (...)
+	{
+		resource->deallocate(memory, sizeof(impl), alignof(impl));
+		throw;
+	}
+	block->m_resource = resource;
+	return block;
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+void WinHandle<T, NullValue, RT, Deleter, RefCount>::impl::dispose(impl* block) noexcept
+{
+	if (std::pmr::memory_resource* resource = block->m_resource)
+	{
+		block->~impl();
+		resource->deallocate(block, sizeof(impl), alignof(impl));
+	}
+	else
+		delete block;
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+std::pmr::memory_resource* WinHandle<T, NullValue, RT, Deleter, RefCount>::impl::resource() const noexcept
+{
+	return m_resource;
+}
+
+#pragma endregion
+
+#pragma region Reference counting
+// Reference counting
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+void WinHandle<T, NullValue, RT, Deleter, RefCount>::impl::add_ref() noexcept
+{
+	m_refs.increment();
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+void WinHandle<T, NullValue, RT, Deleter, RefCount>::impl::add_ref(long count) noexcept
+{
+	m_refs.increment(count);
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+bool WinHandle<T, NullValue, RT, Deleter, RefCount>::impl::add_ref_nonzero() noexcept
+{
+	return m_refs.increment_nonzero();
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+bool WinHandle<T, NullValue, RT, Deleter, RefCount>::impl::release() noexcept
+{
+	return m_refs.decrement();
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+bool WinHandle<T, NullValue, RT, Deleter, RefCount>::impl::release(long count) noexcept
+{
+	return m_refs.decrement(count);
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+long WinHandle<T, NullValue, RT, Deleter, RefCount>::impl::use_count() const noexcept
+{
+	return m_refs.count();
+}
+
+// The fence orders later writes to the block after the accesses of the released references. Weak
+// references of moved-from handles do not count, since those only use the deleter and the memory
+// resource. Once a WeakWinHandle has referred to the block, any weak reference does: new ones can
+// only be copied from existing ones, and the fence makes m_observed visible if one was created
+// through a reference that has been released since.
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+bool WinHandle<T, NullValue, RT, Deleter, RefCount>::impl::unique() const noexcept
+{
+	if (m_refs.count() != 1)
+		return false;
+	std::atomic_thread_fence(std::memory_order_acquire);
+	return m_weak.count() == 1 || !m_observed.load(std::memory_order_relaxed);
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+void WinHandle<T, NullValue, RT, Deleter, RefCount>::impl::add_weak() noexcept
+{
+	m_weak.increment();
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+void WinHandle<T, NullValue, RT, Deleter, RefCount>::impl::add_observer() noexcept
+{
+	m_observed.store(true, std::memory_order_relaxed);
+	m_weak.increment();
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+void WinHandle<T, NullValue, RT, Deleter, RefCount>::impl::release_weak(impl* block) noexcept
+{
+	if (block->m_weak.decrement())
+		dispose(block);
+}
+
+// Without weak references none can be added anymore, so the block is disposed without touching
+// the weak count. The fence orders the disposal after the release of the last weak reference.
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+void WinHandle<T, NullValue, RT, Deleter, RefCount>::impl::expire(impl* block) noexcept
+{
+	if (block->m_weak.count() == 1)
+	{
+		std::atomic_thread_fence(std::memory_order_acquire);
+		dispose(block);
+		return;
+	}
+
+	block->destroy();
+	release_weak(block);
+}
+
+#pragma endregion
+
+#pragma region Assignment
+// Assignment
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+RT WinHandle<T, NullValue, RT, Deleter, RefCount>::impl::assign(T v) noexcept
+{
+	RT result = {};
+	if constexpr (winhandle_detail::is_concurrent<RefCount>)
+	{
+		// Readers may be loading the handle, so it is exchanged atomically and released once no
+		// lease can still be using it
+		m_refs.lock();
+		const T previous = std::atomic_ref<T>(m_handle).exchange(v, std::memory_order_seq_cst);
+		if (previous != v)
+		{
+			const bool owned = std::exchange(m_owned, true);
+			acquired();
+			if (previous != NullValue && owned)
+			{
+				m_refs.synchronize();
+				result = release_handle(previous);
+			}
+		}
+		m_refs.unlock();
+	}
+	else if (v != m_handle)
+	{
+		result = destroy();
+		m_handle = v;
+		m_owned = true;
+		acquired();
+	}
+	return result;
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+T WinHandle<T, NullValue, RT, Deleter, RefCount>::impl::disown() noexcept
+{
+#if defined(WINHANDLE_REGISTRY)
+	if (m_handle != NullValue && m_owned)
+		HandleRegistry::get<T, NullValue, RT>().release();
+#endif
+	m_owned = true;
+	return std::exchange(m_handle, NullValue);
+}
+
+#pragma endregion
+
+#pragma region Leases
+// Leases
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+unsigned WinHandle<T, NullValue, RT, Deleter, RefCount>::impl::enter() noexcept
+{
+	return m_refs.enter();
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+void WinHandle<T, NullValue, RT, Deleter, RefCount>::impl::leave(unsigned slot) noexcept
+{
+	m_refs.leave(slot);
+}
+
+#pragma endregion
+
+#pragma region Member access
+// Member access
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+T WinHandle<T, NullValue, RT, Deleter, RefCount>::impl::get() const noexcept
+{
+	if constexpr (winhandle_detail::is_concurrent<RefCount>)
+		return std::atomic_ref<T>(const_cast<T&>(m_handle)).load(std::memory_order_seq_cst);
+	else
+		return m_handle;
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+const T* WinHandle<T, NullValue, RT, Deleter, RefCount>::impl::ptr() const noexcept
+{
+	return &m_handle;
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+const Deleter& WinHandle<T, NullValue, RT, Deleter, RefCount>::impl::deleter() const noexcept
+{
+	return storage::deleter();
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+bool WinHandle<T, NullValue, RT, Deleter, RefCount>::impl::custom_deleter() const noexcept
+{
+	return custom(deleter());
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+bool WinHandle<T, NullValue, RT, Deleter, RefCount>::impl::owned() const noexcept
+{
+	return m_owned;
+}
+
+// A deleter is custom if it differs from a default constructed one. Stateless deleters never are.
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+bool WinHandle<T, NullValue, RT, Deleter, RefCount>::impl::custom(const Deleter& deleter) noexcept
+{
+	if constexpr (std::is_empty_v<Deleter>)
+		return false;
+	else if constexpr (std::is_constructible_v<bool, const Deleter&>)
+		return static_cast<bool>(deleter);
+	else
+		return true;
+}
+
+#pragma endregion
+
+#pragma region Deleter
+// Deleter
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+RT WinHandle<T, NullValue, RT, Deleter, RefCount>::impl::destroy() noexcept
+{
+	RT result = {};
+	if (m_handle != NullValue)
+	{
+		const T handle = std::exchange(m_handle, NullValue);
+		if (std::exchange(m_owned, true))
+			result = release_handle(handle);
+	}
+	return result;
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+RT WinHandle<T, NullValue, RT, Deleter, RefCount>::impl::release_handle(T handle) noexcept
+{
+#if defined(WINHANDLE_REGISTRY)
+	const auto start = std::chrono::steady_clock::now();
+	const RT result = winhandle_detail::invoke_deleter<RT>(storage::deleter(), handle);
+	HandleRegistry::get<T, NullValue, RT>().release(std::chrono::steady_clock::now() - start);
+	return result;
+#else
+	return winhandle_detail::invoke_deleter<RT>(storage::deleter(), handle);
+#endif
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+void WinHandle<T, NullValue, RT, Deleter, RefCount>::impl::acquired() noexcept
+{
+#if defined(WINHANDLE_REGISTRY)
+	if (m_handle != NullValue)
+		HandleRegistry::get<T, NullValue, RT>().acquire();
+#endif
+}
+
+#pragma endregion
+#pragma endregion
+
+#pragma region MutableHandle implementation
+
+//////////////////////////////////////////////////////////////////////////
+// MutableHandle implementation
+
+#pragma region Constructor
+// Constructor
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+WinHandle<T, NullValue, RT, Deleter, RefCount>::MutableHandle::MutableHandle(WinHandle& owner) noexcept
+	: m_owner(owner), m_handle(owner.get())
+{
+}
+
+#pragma endregion
+
+#pragma region Destructor
+// Destructor
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+WinHandle<T, NullValue, RT, Deleter, RefCount>::MutableHandle::~MutableHandle() noexcept
+{
+	m_owner.acquire(m_handle);
+	m_handle = NullValue;
+}
+
+#pragma endregion
+
+#pragma region Conversion operator
+// Conversion operator
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+WinHandle<T, NullValue, RT, Deleter, RefCount>::MutableHandle::operator T*() noexcept
+{
+	return &m_handle;
+}
+
+#pragma endregion
+
+#pragma endregion
+
+#pragma region Lease implementation
+
+//////////////////////////////////////////////////////////////////////////
+// Lease implementation
+
+#pragma region Constructor
+// Constructor
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+WinHandle<T, NullValue, RT, Deleter, RefCount>::Lease::Lease(const WinHandle& owner) noexcept
+	: m_impl(owner.block())
+{
+	if (m_impl)
+	{
+		m_slot = m_impl->enter();
+		m_handle = m_impl->get();
+	}
+}
+
+#pragma endregion
+
+#pragma region Destructor
+// Destructor
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+WinHandle<T, NullValue, RT, Deleter, RefCount>::Lease::~Lease() noexcept
+{
+	if (m_impl)
+		m_impl->leave(m_slot);
+}
+
+#pragma endregion
+
+#pragma region Member access
+// Member access
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+bool WinHandle<T, NullValue, RT, Deleter, RefCount>::Lease::valid() const noexcept
+{
+	return m_handle != NullValue;
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+T WinHandle<T, NullValue, RT, Deleter, RefCount>::Lease::get() const noexcept
+{
+	return m_handle;
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+WinHandle<T, NullValue, RT, Deleter, RefCount>::Lease::operator T() const noexcept
+{
+	return m_handle;
+}
+
+#pragma endregion
+
+#pragma endregion
+
+#pragma region UniqueWinHandle implementation
+//////////////////////////////////////////////////////////////////////////
+// UniqueWinHandle implementation
+
+#pragma region Constructors
+// Constructors
+
+template<typename T, T NullValue, typename RT, typename Deleter>
+UniqueWinHandle<T, NullValue, RT, Deleter>::UniqueWinHandle(T handle) noexcept
+	: m_handle{ handle }
+{
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter>
+UniqueWinHandle<T, NullValue, RT, Deleter>::UniqueWinHandle(const Deleter& deleter)
+	: storage{ deleter }
+{
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter>
+UniqueWinHandle<T, NullValue, RT, Deleter>::UniqueWinHandle(Deleter&& deleter) noexcept
+	: storage{ std::move(deleter) }
+{
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter>
+UniqueWinHandle<T, NullValue, RT, Deleter>::UniqueWinHandle(T handle, const Deleter& deleter)
+	: storage{ deleter }, m_handle{ handle }
+{
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter>
+UniqueWinHandle<T, NullValue, RT, Deleter>::UniqueWinHandle(T handle, Deleter&& deleter) noexcept
+	: storage{ std::move(deleter) }, m_handle{ handle }
+{
+}
+
+#pragma endregion
+
+#pragma region Copy and move constructors
+// Copy and move constructors
+
+template<typename T, T NullValue, typename RT, typename Deleter>
+UniqueWinHandle<T, NullValue, RT, Deleter>::UniqueWinHandle(UniqueWinHandle&& move) noexcept
+	: storage{ std::move(move.get_deleter()) }, m_handle{ move.release() }
+{
+}
+
+#pragma endregion
+
+#pragma region Copy and move assignment operators
+// Copy and move assignment operators
+
+template<typename T, T NullValue, typename RT, typename Deleter>
+UniqueWinHandle<T, NullValue, RT, Deleter>& UniqueWinHandle<T, NullValue, RT, Deleter>::operator =(UniqueWinHandle&& move) noexcept
+{
+	if (this != &move)
+	{
+		reset(move.release());
+		get_deleter() = std::move(move.get_deleter());
+	}
+	return *this;
+}
+
+#pragma endregion
+
+#pragma region Destructor
+// Destructor
+
+template<typename T, T NullValue, typename RT, typename Deleter>
+UniqueWinHandle<T, NullValue, RT, Deleter>::~UniqueWinHandle() noexcept
+{
+	close();
+}
+
+#pragma endregion
+
+#pragma region Assignment operators
+// Assignment operators
+
+template<typename T, T NullValue, typename RT, typename Deleter>
+UniqueWinHandle<T, NullValue, RT, Deleter>& UniqueWinHandle<T, NullValue, RT, Deleter>::operator=(const T& handle) noexcept
+{
+	reset(handle);
+	return *this;
+}
+
+#pragma endregion
+
+#pragma region Conversion operators
+// Conversion operators
+
+template<typename T, T NullValue, typename RT, typename Deleter>
+UniqueWinHandle<T, NullValue, RT, Deleter>::operator bool_type() const noexcept
+{
+	return valid() ? &UniqueWinHandle::this_type_does_not_support_comparisons : nullptr;
+}
+
+#pragma endregion
+
+#pragma region Smart pointer operations
+// Smart pointer operations
+
+template<typename T, T NullValue, typename RT, typename Deleter>
+void UniqueWinHandle<T, NullValue, RT, Deleter>::swap(UniqueWinHandle& other) noexcept
+{
+	using std::swap;
+	swap(get_deleter(), other.get_deleter());
+	swap(m_handle, other.m_handle);
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter>
+void UniqueWinHandle<T, NullValue, RT, Deleter>::reset() noexcept
+{
+	close();
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter>
+void UniqueWinHandle<T, NullValue, RT, Deleter>::reset(T handle) noexcept
+{
+	if (handle != m_handle)
+	{
+		close();
+		m_handle = handle;
+	}
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter>
+T UniqueWinHandle<T, NullValue, RT, Deleter>::release() noexcept
+{
+	return std::exchange(m_handle, NullValue);
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter>
+Deleter& UniqueWinHandle<T, NullValue, RT, Deleter>::get_deleter() noexcept
+{
+	return storage::deleter();
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter>
+const Deleter& UniqueWinHandle<T, NullValue, RT, Deleter>::get_deleter() const noexcept
+{
+	return storage::deleter();
+}
+
+#pragma endregion
+
+#pragma region Handle operations
+// Handle operations
+
+template<typename T, T NullValue, typename RT, typename Deleter>
+bool UniqueWinHandle<T, NullValue, RT, Deleter>::valid() const noexcept
+{
+	return m_handle != NullValue;
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter>
+T UniqueWinHandle<T, NullValue, RT, Deleter>::get() const noexcept
+{
+	return m_handle;
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter>
+const T* UniqueWinHandle<T, NullValue, RT, Deleter>::ptr() const noexcept
+{
+	return &m_handle;
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter>
+typename UniqueWinHandle<T, NullValue, RT, Deleter>::MutableHandle UniqueWinHandle<T, NullValue, RT, Deleter>::ptr() noexcept
+{
+	return MutableHandle(*this);
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter>
+RT UniqueWinHandle<T, NullValue, RT, Deleter>::close() noexcept
+{
+	RT result = {};
+	if (m_handle != NullValue)
+		result = winhandle_detail::invoke_deleter<RT>(get_deleter(), std::exchange(m_handle, NullValue));
+	return result;
+}
+
+#pragma endregion
+
+#pragma region MutableHandle implementation
+// MutableHandle implementation
+
+template<typename T, T NullValue, typename RT, typename Deleter>
+UniqueWinHandle<T, NullValue, RT, Deleter>::MutableHandle::MutableHandle(UniqueWinHandle& owner) noexcept
+	: m_owner(owner), m_handle(owner.get())
+{
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter>
+UniqueWinHandle<T, NullValue, RT, Deleter>::MutableHandle::~MutableHandle() noexcept
+{
+	m_owner.reset(m_handle);
+	m_handle = NullValue;
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter>
+UniqueWinHandle<T, NullValue, RT, Deleter>::MutableHandle::operator T*() noexcept
+{
+	return &m_handle;
+}
+
+#pragma endregion
+
+#pragma endregion
+
+#pragma region WeakWinHandle implementation
+//////////////////////////////////////////////////////////////////////////
+// WeakWinHandle implementation
+
+#pragma region Constructors
+// Constructors
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+WeakWinHandle<T, NullValue, RT, Deleter, RefCount>::WeakWinHandle(const handle_type& handle) noexcept
+	: m_impl{ handle.block() }
+{
+	if (m_impl)
+		m_impl->add_observer();
+}
+
+#pragma endregion
+
+#pragma region Copy and move
+// Copy and move
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+WeakWinHandle<T, NullValue, RT, Deleter, RefCount>::WeakWinHandle(const WeakWinHandle& copy) noexcept
+	: m_impl{ copy.m_impl }
+{
+	if (m_impl)
+		m_impl->add_weak();
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+WeakWinHandle<T, NullValue, RT, Deleter, RefCount>::WeakWinHandle(WeakWinHandle&& move) noexcept
+	: m_impl{ std::exchange(move.m_impl, nullptr) }
+{
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+WeakWinHandle<T, NullValue, RT, Deleter, RefCount>& WeakWinHandle<T, NullValue, RT, Deleter, RefCount>::operator=(const WeakWinHandle& copy) noexcept
+{
+	if (copy.m_impl)
+		copy.m_impl->add_weak();
+	attach(copy.m_impl);
+	return *this;
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+WeakWinHandle<T, NullValue, RT, Deleter, RefCount>& WeakWinHandle<T, NullValue, RT, Deleter, RefCount>::operator=(WeakWinHandle&& move) noexcept
+{
+	if (this != &move)
+		attach(std::exchange(move.m_impl, nullptr));
+	return *this;
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+WeakWinHandle<T, NullValue, RT, Deleter, RefCount>& WeakWinHandle<T, NullValue, RT, Deleter, RefCount>::operator=(const handle_type& handle) noexcept
+{
+	impl* block = handle.block();
+	if (block)
+		block->add_observer();
+	attach(block);
+	return *this;
+}
+
+#pragma endregion
+
+#pragma region Destructor
+// Destructor
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+WeakWinHandle<T, NullValue, RT, Deleter, RefCount>::~WeakWinHandle() noexcept
+{
+	attach(nullptr);
+}
+
+#pragma endregion
+
+#pragma region Weak pointer operations
+// Weak pointer operations
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+typename WeakWinHandle<T, NullValue, RT, Deleter, RefCount>::handle_type WeakWinHandle<T, NullValue, RT, Deleter, RefCount>::lock() const noexcept
+{
+	if (m_impl && m_impl->add_ref_nonzero())
+		return handle_type(m_impl);
+	return handle_type{};
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+bool WeakWinHandle<T, NullValue, RT, Deleter, RefCount>::expired() const noexcept
+{
+	return use_count() == 0;
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+long WeakWinHandle<T, NullValue, RT, Deleter, RefCount>::use_count() const noexcept
+{
+	return m_impl ? m_impl->use_count() : 0;
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+void WeakWinHandle<T, NullValue, RT, Deleter, RefCount>::reset() noexcept
+{
+	attach(nullptr);
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+void WeakWinHandle<T, NullValue, RT, Deleter, RefCount>::swap(WeakWinHandle& other) noexcept
+{
+	std::swap(m_impl, other.m_impl);
+}
+
+#pragma endregion
+
+#pragma region impl management
+// impl management
+
+template<typename T, T NullValue, typename RT, typename Deleter, typename RefCount>
+void WeakWinHandle<T, NullValue, RT, Deleter, RefCount>::attach(impl* replacement) noexcept
+{
+	if (impl* previous = std::exchange(m_impl, replacement))
+		impl::release_weak(previous);
+}
+
+#pragma endregion
+
+#pragma endregion
+
+#pragma region AtomicWinHandle implementation
+//////////////////////////////////////////////////////////////////////////
+// AtomicWinHandle implementation
+
+#pragma region Constructors
+// Constructors
+
+template<typename T, T NullValue, typename RT, typename Deleter>
+AtomicWinHandle<T, NullValue, RT, Deleter>::AtomicWinHandle(handle_type handle) noexcept
+	: m_word{ pack(adopt(handle)) }
+{
+}
+
+#pragma endregion
+
+#pragma region Destructor
+// Destructor
+
+template<typename T, T NullValue, typename RT, typename Deleter>
+AtomicWinHandle<T, NullValue, RT, Deleter>::~AtomicWinHandle() noexcept
+{
+	settle(m_word.load(std::memory_order_acquire), 0);
+}
+
+#pragma endregion
+
+#pragma region Atomic operations
+// Atomic operations
+
+template<typename T, T NullValue, typename RT, typename Deleter>
+typename AtomicWinHandle<T, NullValue, RT, Deleter>::handle_type AtomicWinHandle<T, NullValue, RT, Deleter>::load() const noexcept
+{
+	const std::uint64_t word = m_word.fetch_add(s_one, std::memory_order_acquire) + s_one;
+	impl* current = block(word);
+	if (loads(word) >= s_refill)
+		refill(current);
+	return current ? handle_type(current) : handle_type{};
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter>
+void AtomicWinHandle<T, NullValue, RT, Deleter>::store(handle_type desired) noexcept
+{
+	settle(m_word.exchange(pack(adopt(desired)), std::memory_order_acq_rel), 0);
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter>
+typename AtomicWinHandle<T, NullValue, RT, Deleter>::handle_type AtomicWinHandle<T, NullValue, RT, Deleter>::exchange(handle_type desired) noexcept
+{
+	const std::uint64_t previous = m_word.exchange(pack(adopt(desired)), std::memory_order_acq_rel);
+	settle(previous, 1);
+	return block(previous) ? handle_type(block(previous)) : handle_type{};
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter>
+bool AtomicWinHandle<T, NullValue, RT, Deleter>::compare_exchange_strong(handle_type& expected, handle_type desired) noexcept
+{
+	impl* replacement = adopt(desired);
+	for (;;)
+	{
+		// The word also changes with every load, so retry while it still holds the expected block
+		std::uint64_t current = m_word.load(std::memory_order_acquire);
+		while (block(current) == expected.block())
+		{
+			if (m_word.compare_exchange_weak(current, pack(replacement), std::memory_order_acq_rel, std::memory_order_acquire))
+			{
+				settle(current, 0);
+				return true;
+			}
+		}
+
+		// The block may have been replaced by the expected one again before it is loaded, which is
+		// not a reason to fail
+		handle_type observed = load();
+		if (observed.block() != expected.block())
+		{
+			if (replacement)
+			{
+				replacement->release(s_batch - 1);
+				desired.m_impl = replacement;
+			}
+			expected = std::move(observed);
+			return false;
+		}
+	}
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter>
+bool AtomicWinHandle<T, NullValue, RT, Deleter>::compare_exchange_weak(handle_type& expected, handle_type desired) noexcept
+{
+	return compare_exchange_strong(expected, std::move(desired));
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter>
+AtomicWinHandle<T, NullValue, RT, Deleter>::operator handle_type() const noexcept
+{
+	return load();
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter>
+void AtomicWinHandle<T, NullValue, RT, Deleter>::operator=(handle_type desired) noexcept
+{
+	store(std::move(desired));
+}
+
+#pragma endregion
+
+#pragma region Batches
+// Batches
+
+template<typename T, T NullValue, typename RT, typename Deleter>
+std::uint64_t AtomicWinHandle<T, NullValue, RT, Deleter>::pack(impl* block) noexcept
+{
+	const auto word = static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(block));
+	assert((word >> s_countShift) == 0 && "Control block address overlaps the load count");
+	return word;
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter>
+typename AtomicWinHandle<T, NullValue, RT, Deleter>::impl* AtomicWinHandle<T, NullValue, RT, Deleter>::block(std::uint64_t word) noexcept
+{
+	return reinterpret_cast<impl*>(static_cast<std::uintptr_t>(word & (s_one - 1)));
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter>
+long AtomicWinHandle<T, NullValue, RT, Deleter>::loads(std::uint64_t word) noexcept
+{
+	return static_cast<long>(word >> s_countShift);
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter>
+typename AtomicWinHandle<T, NullValue, RT, Deleter>::impl* AtomicWinHandle<T, NullValue, RT, Deleter>::adopt(handle_type& handle) noexcept
+{
+	// A moved-from handle keeps its weak reference and releases it when destroyed
+	impl* adopted = handle.block();
+	if (adopted)
+	{
+		handle.m_impl = nullptr;
+		adopted->add_ref(s_batch - 1);
+	}
+	return adopted;
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter>
+void AtomicWinHandle<T, NullValue, RT, Deleter>::settle(std::uint64_t word, long keep) noexcept
+{
+	impl* replaced = block(word);
+	const long unused = s_batch - loads(word) - keep;
+	if (replaced && unused > 0 && replaced->release(unused))
+		impl::expire(replaced);
+}
+
+// Adds s_refill references to the block and takes as many loads off the word. If another reader
+// already did, or the block was replaced meanwhile, the references are released again.
+template<typename T, T NullValue, typename RT, typename Deleter>
+void AtomicWinHandle<T, NullValue, RT, Deleter>::refill(impl* current) const noexcept
+{
+	if (current)
+		current->add_ref(s_refill);
+
+	std::uint64_t word = m_word.load(std::memory_order_relaxed);
+	while (block(word) == current && loads(word) >= s_refill)
+	{
+		if (m_word.compare_exchange_weak(word, word - s_refill * s_one, std::memory_order_relaxed))
+			return;
+	}
+
+	if (current)
+		current->release(s_refill); // The caller still holds a reference
+}
+
+#pragma endregion
+
+#pragma endregion
+
+#pragma region HandleDeleter implementation
+//////////////////////////////////////////////////////////////////////////
+// HandleDeleter implementation
+
+#pragma region Constructors
+// Constructors
+
+template<typename T, typename RT>
+HandleDeleter<T, RT>::HandleDeleter(std::nullptr_t) noexcept
+{
+}
+
+template<typename T, typename RT>
+template<typename F, typename>
+HandleDeleter<T, RT>::HandleDeleter(F&& function)
+{
+	using callable = std::decay_t<F>;
+
+	// Null function pointers and empty std::function objects result in an empty deleter
+	if constexpr (std::is_pointer_v<callable> || std::is_member_pointer_v<callable> || std::is_same_v<callable, std::function<RT(T)>>)
+	{
+		if (!function)
+			return;
+	}
+
+	if constexpr (stored_inline<callable>)
+	{
+		::new (static_cast<void*>(m_storage)) callable(std::forward<F>(function));
+		m_invoke = &invoke_inline<callable>;
+		if constexpr (!bitwise_copyable<callable>)
+			m_manage = &manage_inline<callable>;
+	}
+	else
+	{
+		::new (static_cast<void*>(m_storage)) callable*(new callable(std::forward<F>(function)));
+		m_invoke = &invoke_heap<callable>;
+		m_manage = &manage_heap<callable>;
+	}
+}
+
+#pragma endregion
+
+#pragma region Copy and move
+// Copy and move
+
+template<typename T, typename RT>
+HandleDeleter<T, RT>::HandleDeleter(const HandleDeleter& copy)
+{
+	copy_from(copy);
+}
+
+template<typename T, typename RT>
+HandleDeleter<T, RT>::HandleDeleter(HandleDeleter&& move) noexcept
+{
+	move_from(move);
+}
+
+template<typename T, typename RT>
+HandleDeleter<T, RT>& HandleDeleter<T, RT>::operator=(const HandleDeleter& copy)
+{
+	if (this != &copy)
+	{
+		HandleDeleter temp{ copy };
+		clear();
+		move_from(temp);
+	}
+	return *this;
+}
+
+template<typename T, typename RT>
+HandleDeleter<T, RT>& HandleDeleter<T, RT>::operator=(HandleDeleter&& move) noexcept
+{
+	if (this != &move)
+	{
+		clear();
+		move_from(move);
+	}
+	return *this;
+}
+
+#pragma endregion
+
+#pragma region Destructor
+// Destructor
+
+template<typename T, typename RT>
+HandleDeleter<T, RT>::~HandleDeleter() noexcept
+{
+	clear();
+}
+
+#pragma endregion
+
+#pragma region Invocation
+// Invocation
+
+template<typename T, typename RT>
+RT HandleDeleter<T, RT>::operator()(T handle) const
+{
+	return m_invoke(m_storage, handle);
+}
+
+template<typename T, typename RT>
+HandleDeleter<T, RT>::operator bool() const noexcept
+{
+	return m_invoke != nullptr;
+}
+
+template<typename T, typename RT>
+template<typename F>
+const F* HandleDeleter<T, RT>::target() const noexcept
+{
+	if constexpr (stored_inline<F>)
+	{
+		if (m_invoke == &invoke_inline<F>)
+			return std::launder(reinterpret_cast<const F*>(m_storage));
+	}
+	else if (m_invoke == &invoke_heap<F>)
+		return *std::launder(reinterpret_cast<F* const*>(m_storage));
+	return nullptr;
+}
+
+// Bitwise copies carry the whole storage, so copies of one deleter compare equal
+template<typename T, typename RT>
+bool HandleDeleter<T, RT>::same_target(const HandleDeleter& other) const noexcept
+{
+	if (m_invoke != other.m_invoke || m_manage || other.m_manage)
+		return false;
+	return !m_invoke || std::memcmp(m_storage, other.m_storage, inline_size) == 0;
+}
+
+// Callables that are not copied bitwise only hash by type
+template<typename T, typename RT>
+std::size_t HandleDeleter<T, RT>::hash_target() const noexcept
+{
+	std::uint64_t hash = reinterpret_cast<std::uintptr_t>(m_invoke);
+	if (m_invoke && !m_manage)
+	{
+		for (std::size_t offset = 0; offset < inline_size; offset += sizeof(std::uint64_t))
+		{
+			std::uint64_t word;
+			std::memcpy(&word, m_storage + offset, sizeof(word));
+			hash = (hash ^ word) * 0x100000001b3ull;
+		}
+	}
+	return static_cast<std::size_t>(hash);
+}
+
+template<typename T, typename RT>
+template<typename F>
+RT HandleDeleter<T, RT>::invoke_inline(const void* storage, T handle)
+{
+	return static_cast<RT>((*std::launder(static_cast<const F*>(storage)))(handle));
+}
+
+template<typename T, typename RT>
+template<typename F>
+RT HandleDeleter<T, RT>::invoke_heap(const void* storage, T handle)
+{
+	return static_cast<RT>((**std::launder(static_cast<F* const*>(storage)))(handle));
+}
+
+#pragma endregion
+
+#pragma region Storage management
+// Storage management
+
+template<typename T, typename RT>
+template<typename F>
+void HandleDeleter<T, RT>::manage_inline(operation op, void* target, void* source)
+{
+	switch (op)
+	{
+	case operation::copy:
+		::new (target) F(*std::launder(static_cast<const F*>(source)));
+		break;
+	case operation::move:
+		::new (target) F(std::move(*std::launder(static_cast<F*>(source))));
+		std::launder(static_cast<F*>(source))->~F();
+		break;
+	case operation::destroy:
+		std::launder(static_cast<F*>(target))->~F();
+		break;
+	}
+}
+
+template<typename T, typename RT>
+template<typename F>
+void HandleDeleter<T, RT>::manage_heap(operation op, void* target, void* source)
+{
+	switch (op)
+	{
+	case operation::copy:
+		::new (target) F*(new F(**std::launder(static_cast<F* const*>(source))));
+		break;
+	case operation::move:
+		::new (target) F*(*std::launder(static_cast<F* const*>(source)));
+		break;
+	case operation::destroy:
+		delete *std::launder(static_cast<F* const*>(target));
+		break;
+	}
+}
+
+template<typename T, typename RT>
+void HandleDeleter<T, RT>::copy_from(const HandleDeleter& other)
+{
+	if (other.m_manage)
+		other.m_manage(operation::copy, m_storage, const_cast<unsigned char*>(other.m_storage));
+	else if (other.m_invoke)
+		std::memcpy(m_storage, other.m_storage, inline_size);
+	m_invoke = other.m_invoke;
+	m_manage = other.m_manage;
+}
+
+template<typename T, typename RT>
+void HandleDeleter<T, RT>::move_from(HandleDeleter& other) noexcept
+{
+	if (other.m_manage)
+		other.m_manage(operation::move, m_storage, other.m_storage);
+	else if (other.m_invoke)
+		std::memcpy(m_storage, other.m_storage, inline_size);
+	m_invoke = std::exchange(other.m_invoke, nullptr);
+	m_manage = std::exchange(other.m_manage, nullptr);
+}
+
+template<typename T, typename RT>
+void HandleDeleter<T, RT>::clear() noexcept
+{
+	if (m_manage)
+		m_manage(operation::destroy, m_storage, nullptr);
+	m_invoke = nullptr;
+	m_manage = nullptr;
+}
+
+#pragma endregion
+
+#pragma endregion
+
+#pragma region HandlePool implementation
+//////////////////////////////////////////////////////////////////////////
+// HandlePool implementation
+
+template<std::size_t BlockSize, std::size_t Alignment>
+HandlePool<BlockSize, Alignment>& HandlePool<BlockSize, Alignment>::instance() noexcept
+{
+	static HandlePool pool;
+	return pool;
+}
+
+#pragma region Allocation
+// Allocation
+
+template<std::size_t BlockSize, std::size_t Alignment>
+void* HandlePool<BlockSize, Alignment>::do_allocate(std::size_t bytes, std::size_t alignment)
+{
+	if (bytes > s_blockSize || alignment > s_alignment)
+		return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+
+	cache& c = local();
+	if (c.freed)
+	{
+		node* block = std::exchange(c.freed, c.freed->next);
+		--c.freed_count;
+		return block;
+	}
+	if (!c.refilled)
+		c.refilled = m_shared.exchange(nullptr, std::memory_order_acquire);
+	if (!c.refilled)
+		c.refilled = allocate_slab();
+	return std::exchange(c.refilled, c.refilled->next);
+}
+
+template<std::size_t BlockSize, std::size_t Alignment>
+void HandlePool<BlockSize, Alignment>::do_deallocate(void* p, std::size_t bytes, std::size_t alignment)
+{
+	if (bytes > s_blockSize || alignment > s_alignment)
+	{
+		std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+		return;
+	}
+
+	cache& c = local();
+	node* block = static_cast<node*>(p);
+	block->next = c.freed;
+	if (!c.freed)
+		c.freed_tail = block;
+	c.freed = block;
+
+	// Hand a full cache over to the other threads
+	if (++c.freed_count >= cache_size)
+	{
+		share(std::exchange(c.freed, nullptr), std::exchange(c.freed_tail, nullptr));
+		c.freed_count = 0;
+	}
+}
+
+template<std::size_t BlockSize, std::size_t Alignment>
+bool HandlePool<BlockSize, Alignment>::do_is_equal(const std::pmr::memory_resource& other) const noexcept
+{
+	return this == &other;
+}
+
+#pragma endregion
+
+#pragma region Block management
+// Block management
+
+template<std::size_t BlockSize, std::size_t Alignment>
+typename HandlePool<BlockSize, Alignment>::cache& HandlePool<BlockSize, Alignment>::local() noexcept
+{
+	static thread_local cache s_cache;
+	return s_cache;
+}
+
+// Pushes a chain of blocks onto the shared list. Blocks are only ever taken off the shared
+// list all at once, so pushing with compare and exchange is not subject to ABA problems.
+template<std::size_t BlockSize, std::size_t Alignment>
+void HandlePool<BlockSize, Alignment>::share(node* head, node* tail) noexcept
+{
+	tail->next = m_shared.load(std::memory_order_relaxed);
+	while (!m_shared.compare_exchange_weak(tail->next, head, std::memory_order_release, std::memory_order_relaxed))
+		;
+}
+
+// Allocates a slab and returns its blocks as a chain. The first block links the slab into m_slabs.
+template<std::size_t BlockSize, std::size_t Alignment>
+typename HandlePool<BlockSize, Alignment>::node* HandlePool<BlockSize, Alignment>::allocate_slab()
+{
+	unsigned char* slab = static_cast<unsigned char*>(std::pmr::new_delete_resource()->allocate(s_blockSize * slab_size, s_alignment));
+
+	node* header = reinterpret_cast<node*>(slab);
+	header->next = m_slabs.load(std::memory_order_relaxed);
+	while (!m_slabs.compare_exchange_weak(header->next, header, std::memory_order_release, std::memory_order_relaxed))
+		;
+
+	node* head = nullptr;
+	for (std::size_t i = slab_size - 1; i > 0; --i)
+	{
+		node* block = reinterpret_cast<node*>(slab + i * s_blockSize);
+		block->next = head;
+		head = block;
+	}
+	return head;
+}
+
+// Blocks cached by a thread are shared when it exits
+template<std::size_t BlockSize, std::size_t Alignment>
+HandlePool<BlockSize, Alignment>::cache::~cache()
+{
+	HandlePool& pool = instance();
+	if (freed)
+		pool.share(freed, freed_tail);
+	if (refilled)
+	{
+		node* tail = refilled;
+		while (tail->next)
+			tail = tail->next;
+		pool.share(refilled, tail);
+	}
+}
+
+#pragma endregion
+#pragma endregion
+
+#pragma region DeferredCloser implementation
+//////////////////////////////////////////////////////////////////////////
+// DeferredCloser implementation
+
+#pragma region Constructors
+// Constructors
+
+template<typename T, typename RT, typename Deleter>
+DeferredCloser<T, RT, Deleter>::DeferredCloser(std::size_t capacity, backpressure full, std::chrono::nanoseconds threshold)
+	: m_full{ full }, m_threshold{ threshold }
+{
+	std::size_t size = 2;
+	while (size < capacity)
+		size <<= 1;
+
+	m_slots = std::make_unique<slot[]>(size);
+	m_mask = size - 1;
+	for (std::size_t i = 0; i < size; ++i)
+		m_slots[i].sequence.store(i, std::memory_order_relaxed);
+
+	m_thread = std::thread([this]() { run(); });
+}
+
+template<typename T, typename RT, typename Deleter>
+DeferredCloser<T, RT, Deleter>& DeferredCloser<T, RT, Deleter>::instance()
+{
+	static DeferredCloser* closer = new DeferredCloser();
+	return *closer;
+}
+
+#pragma endregion
+
+#pragma region Destructor
+// Destructor
+
+template<typename T, typename RT, typename Deleter>
+DeferredCloser<T, RT, Deleter>::~DeferredCloser() noexcept
+{
+	m_stop.store(true, std::memory_order_seq_cst);
+	wake();
+	m_thread.join();
+}
+
+#pragma endregion
+
+#pragma region Closing
+// Closing
+
+// Deleters are released from noexcept code, so close() must not throw. The deleter is copied before
+// a slot is claimed, since a claimed slot cannot be given back. If copying throws, e.g. because a
+// HandleDeleter allocates for a large callable, the handle is closed on the calling thread instead.
+template<typename T, typename RT, typename Deleter>
+RT DeferredCloser<T, RT, Deleter>::close(T handle, const Deleter& deleter) noexcept
+{
+	if (!defer(deleter))
+		return invoke(handle, deleter);
+
+	try
+	{
+		return enqueue(handle, Deleter(deleter));
+	}
+	catch (...)
+	{
+		return invoke(handle, deleter);
+	}
+}
+
+template<typename T, typename RT, typename Deleter>
+void DeferredCloser<T, RT, Deleter>::flush() noexcept
+{
+	const std::size_t queued = m_tail.load(std::memory_order_acquire);
+	for (std::size_t closed = m_closed.load(std::memory_order_acquire); closed < queued; closed = m_closed.load(std::memory_order_acquire))
+		m_closed.wait(closed, std::memory_order_acquire);
+}
+
+// Estimates are found by linear probing from the hash of the deleter, with the low bit set since 0
+// marks an unused estimate. Once every estimate has been claimed, deleters with a new hash share the
+// one they start probing at.
+template<typename T, typename RT, typename Deleter>
+std::atomic<long long>& DeferredCloser<T, RT, Deleter>::latency(const Deleter& deleter) const noexcept
+{
+	const std::size_t key = winhandle_detail::deleter_hash(deleter) | 1;
+	const std::size_t first = static_cast<std::size_t>((static_cast<std::uint64_t>(key) * 0x9e3779b97f4a7c15ull) >> 32) % s_estimates;
+	for (std::size_t i = 0; i < s_estimates; ++i)
+	{
+		estimate& e = m_estimates[(first + i) % s_estimates];
+		std::size_t current = e.key.load(std::memory_order_relaxed);
+		if (current == 0 && e.key.compare_exchange_strong(current, key, std::memory_order_relaxed))
+			return e.latency;
+		if (current == key)
+			return e.latency;
+	}
+	return m_estimates[first].latency;
+}
+
+// Handles are always deferred without a threshold. Otherwise only while their deleter is slow on average.
+template<typename T, typename RT, typename Deleter>
+bool DeferredCloser<T, RT, Deleter>::defer(const Deleter& deleter) const noexcept
+{
+	return m_threshold.count() == 0 || latency(deleter).load(std::memory_order_relaxed) >= m_threshold.count();
+}
+
+template<typename T, typename RT, typename Deleter>
+RT DeferredCloser<T, RT, Deleter>::enqueue(T handle, Deleter&& deleter) noexcept
+{
+	while (!push(handle, deleter))
+	{
+		// The closer thread cannot wait for itself, e.g. when a release function releases another handle
+		if (m_full == backpressure::close_inline || std::this_thread::get_id() == m_thread.get_id())
+			return invoke(handle, deleter);
+
+		const std::size_t closed = m_closed.load(std::memory_order_acquire);
+		if (push(handle, deleter))
+			break;
+		m_closed.wait(closed, std::memory_order_acquire);
+	}
+
+	wake();
+	return RT{};
+}
+
+// Bounded queue with a sequence number per slot. Producers claim a slot by advancing m_tail and
+// publish it by storing the next sequence number. The deleter is moved into the slot. Returns false,
+// leaving the deleter alone, when the queue is full.
+template<typename T, typename RT, typename Deleter>
+bool DeferredCloser<T, RT, Deleter>::push(T handle, Deleter& deleter) noexcept
+{
+	std::size_t position = m_tail.load(std::memory_order_relaxed);
+	slot* s = nullptr;
+	for (;;)
+	{
+		s = &m_slots[position & m_mask];
+		const std::size_t sequence = s->sequence.load(std::memory_order_acquire);
+		const std::ptrdiff_t difference = static_cast<std::ptrdiff_t>(sequence - position);
+		if (difference == 0)
+		{
+			if (m_tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+				break;
+		}
+		else if (difference < 0)
+			return false;
+		else
+			position = m_tail.load(std::memory_order_relaxed);
+	}
+
+	s->handle = handle;
+	::new (static_cast<void*>(s->deleter)) Deleter(std::move(deleter));
+	s->sequence.store(position + 1, std::memory_order_release);
+	return true;
+}
+
+// Wakes the thread if it is waiting. The fence pairs with the one in run(): either the thread sees
+// the published slot before going to sleep, or this sees that it is sleeping.
+template<typename T, typename RT, typename Deleter>
+void DeferredCloser<T, RT, Deleter>::wake() noexcept
+{
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (m_sleeping.load(std::memory_order_relaxed) && m_sleeping.exchange(false, std::memory_order_acq_rel))
+	{
+		m_wake.fetch_add(1, std::memory_order_release);
+		m_wake.notify_one();
+	}
+}
+
+// Calls the deleter, timing it when a threshold is set
+template<typename T, typename RT, typename Deleter>
+RT DeferredCloser<T, RT, Deleter>::invoke(T handle, const Deleter& deleter) noexcept
+{
+	if (m_threshold.count() == 0)
+		return winhandle_detail::invoke_deleter<RT>(deleter, handle);
+
+	const auto start = std::chrono::steady_clock::now();
+	RT result = winhandle_detail::invoke_deleter<RT>(deleter, handle);
+	const long long elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+	// Exponential moving average over roughly the last eight calls. Concurrent updates may be lost.
+	std::atomic<long long>& average = latency(deleter);
+	const long long previous = average.load(std::memory_order_relaxed);
+	average.store(previous + (elapsed - previous) / 8, std::memory_order_relaxed);
+	return result;
+}
+
+template<typename T, typename RT, typename Deleter>
+void DeferredCloser<T, RT, Deleter>::run() noexcept
+{
+	for (;;)
+	{
+		const unsigned wake = m_wake.load(std::memory_order_acquire);
+		for (;;)
+		{
+			slot& s = m_slots[m_head & m_mask];
+			if (s.sequence.load(std::memory_order_acquire) != m_head + 1)
+				break;
+
+			Deleter* deleter = std::launder(reinterpret_cast<Deleter*>(s.deleter));
+			invoke(s.handle, *deleter);
+			deleter->~Deleter();
+			s.sequence.store(m_head + m_mask + 1, std::memory_order_release);
+			++m_head;
+
+			m_closed.fetch_add(1, std::memory_order_release);
+			m_closed.notify_all();
+		}
+
+		// Slots claimed before stopping are still closed
+		if (m_head != m_tail.load(std::memory_order_acquire))
+		{
+			std::this_thread::yield(); // A producer has claimed a slot but not published it yet
+			continue;
+		}
+		if (m_stop.load(std::memory_order_acquire))
+			return;
+
+		m_sleeping.store(true, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (m_slots[m_head & m_mask].sequence.load(std::memory_order_relaxed) == m_head + 1 || m_stop.load(std::memory_order_relaxed))
+			m_sleeping.store(false, std::memory_order_relaxed);
+		else
+			m_wake.wait(wake, std::memory_order_acquire);
+	}
+}
+
+#pragma endregion
+
+#pragma region Statistics
+// Statistics
+
+template<typename T, typename RT, typename Deleter>
+std::size_t DeferredCloser<T, RT, Deleter>::pending() const noexcept
+{
+	return m_tail.load(std::memory_order_relaxed) - m_closed.load(std::memory_order_relaxed);
+}
+
+template<typename T, typename RT, typename Deleter>
+std::chrono::nanoseconds DeferredCloser<T, RT, Deleter>::average_latency(const Deleter& deleter) const noexcept
+{
+	return std::chrono::nanoseconds(latency(deleter).load(std::memory_order_relaxed));
+}
+
+#pragma endregion
+#pragma endregion
+
+#pragma region DeferredDeleter implementation
+//////////////////////////////////////////////////////////////////////////
+// DeferredDeleter implementation
+
+template<typename T, typename RT, typename Deleter>
+DeferredDeleter<T, RT, Deleter>::operator bool() const noexcept
+{
+	if constexpr (std::is_constructible_v<bool, const Deleter&>)
+		return static_cast<bool>(m_deleter);
+	else
+		return true;
+}
+
+#pragma endregion
+
+#if defined(WINHANDLE_REGISTRY)
+#pragma region HandleRegistry implementation
+//////////////////////////////////////////////////////////////////////////
+// HandleRegistry implementation
+
+#pragma region Registration
+// Registration
+
+// Counters are linked into the registry when they are created and are never removed
+inline HandleRegistry::counters::counters(const std::type_info& type) noexcept
+	: m_type{ type }
+{
+	std::atomic<counters*>& list = HandleRegistry::head();
+	m_next = list.load(std::memory_order_relaxed);
+	while (!list.compare_exchange_weak(m_next, this, std::memory_order_release, std::memory_order_relaxed))
+		;
+}
+
+template<typename T, T NullValue, typename RT>
+HandleRegistry::counters& HandleRegistry::get() noexcept
+{
+	static counters s_counters{ typeid(WinHandle<T, NullValue, RT>) };
+	return s_counters;
+}
+
+inline std::atomic<HandleRegistry::counters*>& HandleRegistry::head() noexcept
+{
+	static std::atomic<counters*> s_head{ nullptr };
+	return s_head;
+}
+
+#pragma endregion
+
+#pragma region Counting
+// Counting
+
+inline void HandleRegistry::counters::acquire() noexcept
+{
+	m_acquired.fetch_add(1, std::memory_order_relaxed);
+	const long long live = m_live.fetch_add(1, std::memory_order_relaxed) + 1;
+	long long peak = m_peak.load(std::memory_order_relaxed);
+	while (live > peak && !m_peak.compare_exchange_weak(peak, live, std::memory_order_relaxed))
+		;
+}
+
+inline void HandleRegistry::counters::release() noexcept
+{
+	m_released.fetch_add(1, std::memory_order_relaxed);
+	m_live.fetch_sub(1, std::memory_order_relaxed);
+}
+
+inline void HandleRegistry::counters::release(std::chrono::nanoseconds latency) noexcept
+{
+	// Index of the highest set bit, i.e. floor(log2(latency))
+	std::size_t bucket = 0;
+	for (unsigned long long ns = latency.count() > 0 ? static_cast<unsigned long long>(latency.count()) : 0; ns > 1; ns >>= 1)
+		++bucket;
+	if (bucket >= HandleStatistics::histogram_size)
+		bucket = HandleStatistics::histogram_size - 1;
+
+	m_latency[bucket].fetch_add(1, std::memory_order_relaxed);
+	release();
+}
+
+#pragma endregion
+
+#pragma region Snapshot
+// Snapshot
+
+// The counters of one instantiation are read one by one, so a snapshot taken while handles are
+// being used may combine values from slightly different points in time
+inline HandleStatistics HandleRegistry::counters::statistics() const noexcept
+{
+	HandleStatistics statistics{ &m_type, 0, 0, 0, 0, {} };
+	statistics.live = m_live.load(std::memory_order_relaxed);
+	statistics.peak = m_peak.load(std::memory_order_relaxed);
+	statistics.acquired = m_acquired.load(std::memory_order_relaxed);
+	statistics.released = m_released.load(std::memory_order_relaxed);
+	for (std::size_t i = 0; i < HandleStatistics::histogram_size; ++i)
+		statistics.latency[i] = m_latency[i].load(std::memory_order_relaxed);
+	return statistics;
+}
+
+inline std::vector<HandleStatistics> HandleRegistry::snapshot()
+{
+	std::vector<HandleStatistics> result;
+	for (const counters* c = head().load(std::memory_order_acquire); c; c = c->m_next)
+		result.push_back(c->statistics());
+	return result;
+}
+
+#pragma endregion
+#pragma endregion
+#endif
+
+#pragma region HandleTable implementation
+//////////////////////////////////////////////////////////////////////////
+// HandleTable implementation
+
+#pragma region control_group
+// control_group
+
+#if defined(WINHANDLE_SSE2)
+inline winhandle_detail::control_group::control_group(const signed char* control) noexcept
+	: m_control{ _mm_load_si128(reinterpret_cast<const __m128i*>(control)) }
+{
+}
+
+inline unsigned winhandle_detail::control_group::match(signed char hash) const noexcept
+{
+	return static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(hash), m_control)));
+}
+
+inline unsigned winhandle_detail::control_group::match_empty() const noexcept
+{
+	return match(empty);
+}
+
+inline unsigned winhandle_detail::control_group::match_free() const noexcept
+{
+	return static_cast<unsigned>(_mm_movemask_epi8(m_control));
+}
+#else
+inline winhandle_detail::control_group::control_group(const signed char* control) noexcept
+	: m_control{ control }
+{
+}
+
+inline unsigned winhandle_detail::control_group::match(signed char hash) const noexcept
+{
+	unsigned mask = 0;
+	for (std::size_t i = 0; i < size; ++i)
+		mask |= static_cast<unsigned>(m_control[i] == hash) << i;
+	return mask;
+}
+
+inline unsigned winhandle_detail::control_group::match_empty() const noexcept
+{
+	return match(empty);
+}
+
+inline unsigned winhandle_detail::control_group::match_free() const noexcept
+{
+	unsigned mask = 0;
+	for (std::size_t i = 0; i < size; ++i)
+		mask |= static_cast<unsigned>(m_control[i] < 0) << i;
+	return mask;
+}
+#endif
+
+#pragma endregion
+
+#pragma region Constructors
+// Constructors
+
+template<typename T, typename V>
+HandleTable<T, V>::HandleTable(std::size_t capacity)
+{
+	reserve(capacity);
+}
+
+#pragma endregion
+
+#pragma region Copy and move
+// Copy and move
+
+template<typename T, typename V>
+HandleTable<T, V>::HandleTable(HandleTable&& move) noexcept
+	: m_control{ std::exchange(move.m_control, nullptr) }, m_slots{ std::exchange(move.m_slots, nullptr) },
+	m_capacity{ std::exchange(move.m_capacity, 0) }, m_size{ std::exchange(move.m_size, 0) }, m_deleted{ std::exchange(move.m_deleted, 0) }
+{
+}
+
+template<typename T, typename V>
+HandleTable<T, V>& HandleTable<T, V>::operator=(HandleTable&& move) noexcept
+{
+	if (this != &move)
+	{
+		release();
+		m_control = std::exchange(move.m_control, nullptr);
+		m_slots = std::exchange(move.m_slots, nullptr);
+		m_capacity = std::exchange(move.m_capacity, 0);
+		m_size = std::exchange(move.m_size, 0);
+		m_deleted = std::exchange(move.m_deleted, 0);
+	}
+	return *this;
+}
+
+#pragma endregion
+
+#pragma region Destructor
+// Destructor
+
+template<typename T, typename V>
+HandleTable<T, V>::~HandleTable() noexcept
+{
+	release();
+}
+
+#pragma endregion
+
+#pragma region Modifiers
+// Modifiers
+
+template<typename T, typename V>
+template<typename... Args>
+std::pair<V*, bool> HandleTable<T, V>::emplace(T key, Args&&... args)
+{
+	const std::uint64_t h = hash(key);
+	std::size_t index = locate(key, h);
+	if (index != m_capacity)
+		return { &m_slots[index].value, false };
+
+	// Keep at least one slot in eight free so that probing always ends at an empty slot
+	if ((m_size + m_deleted + 1) * 8 > m_capacity * 7)
+		rehash(m_size + 1);
+
+	index = claim(h);
+	::new (static_cast<void*>(&m_slots[index])) slot{ key, V(std::forward<Args>(args)...) };
+	if (m_control[index] == winhandle_detail::control_group::deleted)
+		--m_deleted;
+	m_control[index] = static_cast<signed char>(h & 0x7f);
+	++m_size;
+	return { &m_slots[index].value, true };
+}
+
+// Erased slots are marked deleted rather than empty, so that probing continues past them
+template<typename T, typename V>
+bool HandleTable<T, V>::erase(T key) noexcept
+{
+	const std::size_t index = locate(key, hash(key));
+	if (index == m_capacity)
+		return false;
+
+	m_slots[index].~slot();
+	m_control[index] = winhandle_detail::control_group::deleted;
+	--m_size;
+	++m_deleted;
+	return true;
+}
+
+template<typename T, typename V>
+void HandleTable<T, V>::clear() noexcept
+{
+	for (std::size_t i = 0; i < m_capacity; ++i)
+	{
+		if (m_control[i] >= 0)
+			m_slots[i].~slot();
+		m_control[i] = winhandle_detail::control_group::empty;
+	}
+	m_size = 0;
+	m_deleted = 0;
+}
+
+template<typename T, typename V>
+void HandleTable<T, V>::reserve(std::size_t count)
+{
+	if (count * 8 > m_capacity * 7)
+		rehash(count);
+}
+
+#pragma endregion
+
+#pragma region Lookup
+// Lookup
+
+template<typename T, typename V>
+V* HandleTable<T, V>::find(T key) noexcept
+{
+	const std::size_t index = locate(key, hash(key));
+	return index != m_capacity ? &m_slots[index].value : nullptr;
+}
+
+template<typename T, typename V>
+const V* HandleTable<T, V>::find(T key) const noexcept
+{
+	const std::size_t index = locate(key, hash(key));
+	return index != m_capacity ? &m_slots[index].value : nullptr;
+}
+
+template<typename T, typename V>
+bool HandleTable<T, V>::contains(T key) const noexcept
+{
+	return locate(key, hash(key)) != m_capacity;
+}
+
+template<typename T, typename V>
+template<typename F>
+void HandleTable<T, V>::for_each(F&& f)
+{
+	for (std::size_t i = 0; i < m_capacity; ++i)
+	{
+		if (m_control[i] >= 0)
+			f(static_cast<const T&>(m_slots[i].key), m_slots[i].value);
+	}
+}
+
+#pragma endregion
+
+#pragma region Capacity
+// Capacity
+
+template<typename T, typename V>
+std::size_t HandleTable<T, V>::size() const noexcept
+{
+	return m_size;
+}
+
+template<typename T, typename V>
+bool HandleTable<T, V>::empty() const noexcept
+{
+	return m_size == 0;
+}
+
+template<typename T, typename V>
+std::size_t HandleTable<T, V>::capacity() const noexcept
+{
+	return m_capacity;
+}
+
+#pragma endregion
+
+#pragma region Probing
+// Probing
+
+template<typename T, typename V>
+std::uint64_t HandleTable<T, V>::hash(T key) noexcept
+{
+	return winhandle_detail::mix_bits(winhandle_detail::handle_bits(key));
+}
+
+// Groups are probed in triangular order, which visits every group when their number is a power of two
+template<typename T, typename V>
+std::size_t HandleTable<T, V>::locate(T key, std::uint64_t h) const noexcept
+{
+	using group = winhandle_detail::control_group;
+	if (m_capacity == 0)
+		return 0;
+
+	const std::size_t mask = m_capacity / group::size - 1;
+	const signed char h2 = static_cast<signed char>(h & 0x7f);
+	std::size_t g = static_cast<std::size_t>(h >> 7) & mask;
+	for (std::size_t step = 1;; ++step)
+	{
+		const group control{ m_control + g * group::size };
+		for (unsigned match = control.match(h2); match; match &= match - 1)
+		{
+			const std::size_t index = g * group::size + static_cast<std::size_t>(std::countr_zero(match));
+			if (m_slots[index].key == key)
+				return index;
+		}
+		if (control.match_empty())
+			return m_capacity;
+		g = (g + step) & mask;
+	}
+}
+
+template<typename T, typename V>
+std::size_t HandleTable<T, V>::claim(std::uint64_t h) noexcept
+{
+	using group = winhandle_detail::control_group;
+	const std::size_t mask = m_capacity / group::size - 1;
+	std::size_t g = static_cast<std::size_t>(h >> 7) & mask;
+	for (std::size_t step = 1;; ++step)
+	{
+		if (const unsigned free = group{ m_control + g * group::size }.match_free())
+			return g * group::size + static_cast<std::size_t>(std::countr_zero(free));
+		g = (g + step) & mask;
+	}
+}
+
+#pragma endregion
+
+#pragma region Storage management
+// Storage management
+
+// Moves the entries into new storage with room for count entries, dropping deleted slots
+template<typename T, typename V>
+void HandleTable<T, V>::rehash(std::size_t count)
+{
+	using group = winhandle_detail::control_group;
+	std::size_t capacity = group::size;
+	while (capacity * 7 < count * 8)
+		capacity *= 2;
+
+	signed char* control = static_cast<signed char*>(::operator new(capacity, std::align_val_t{ group::size }));
+	slot* slots = nullptr;
+	try
+	{
+		slots = std::allocator<slot>{}.allocate(capacity);
+	}
+	catch (...)
+	{
+		::operator delete(control, std::align_val_t{ group::size });
+		throw;
+	}
+	std::memset(control, group::empty, capacity);
+
+	HandleTable previous{ std::move(*this) };
+	m_control = control;
+	m_slots = slots;
+	m_capacity = capacity;
+
+	for (std::size_t i = 0; i < previous.m_capacity; ++i)
+	{
+		if (previous.m_control[i] < 0)
+			continue;
+
+		slot& entry = previous.m_slots[i];
+		const std::size_t index = claim(hash(entry.key));
+		::new (static_cast<void*>(&m_slots[index])) slot{ entry.key, std::move(entry.value) };
+		m_control[index] = previous.m_control[i];
+		++m_size;
+	}
+}
+
+template<typename T, typename V>
+void HandleTable<T, V>::release() noexcept
+{
+	if (!m_control)
+		return;
+
+	clear();
+	std::allocator<slot>{}.deallocate(m_slots, m_capacity);
+	::operator delete(m_control, std::align_val_t{ winhandle_detail::control_group::size });
+	m_control = nullptr;
+	m_slots = nullptr;
+	m_capacity = 0;
+}
+
+#pragma endregion
+#pragma endregion
+
+#pragma region HandleWaitSet implementation
+//////////////////////////////////////////////////////////////////////////
+// HandleWaitSet implementation
+
+#pragma region find_entry
+// find_entry
+
+template<typename Entry>
+std::size_t winhandle_detail::find_entry(const Entry* entries, std::size_t count, typename wait_entry<Entry>::handle_type handle) noexcept
+{
+	std::size_t i = 0;
+
+#if defined(WINHANDLE_SSE2)
+	using handle_type = typename wait_entry<Entry>::handle_type;
+	constexpr std::size_t stride = sizeof(Entry);
+	constexpr std::size_t width = sizeof(handle_type);
+	constexpr std::size_t offset = wait_entry<Entry>::offset;
+	if constexpr ((width == 4 || width == 8) && offset % 4 == 0 && offset + width <= stride && 16 % stride == 0
+		&& std::is_trivially_copyable_v<Entry> && (std::is_integral_v<handle_type> || std::is_enum_v<handle_type> || std::is_pointer_v<handle_type>))
+	{
+		constexpr std::size_t per_chunk = 16 / stride;
+		constexpr unsigned entry_mask = ((1u << width) - 1) << offset;
+
+		// Needle holding the raw handle at its offset in each entry of a chunk
+		alignas(16) unsigned char needle_bytes[16]{};
+		alignas(16) unsigned char lane_bytes[16]{};
+		unsigned key_mask = 0;
+		for (std::size_t j = 0; j < per_chunk; ++j)
+		{
+			std::memcpy(needle_bytes + j * stride + offset, &handle, width);
+			std::memset(lane_bytes + j * stride + offset, 0xff, width);
+			key_mask |= entry_mask << (j * stride);
+		}
+		const __m128i needle = _mm_load_si128(reinterpret_cast<const __m128i*>(needle_bytes));
+		const __m128i lanes = _mm_load_si128(reinterpret_cast<const __m128i*>(lane_bytes));
+		const unsigned char* bytes = reinterpret_cast<const unsigned char*>(entries);
+
+		// Index of the entry of the chunk at entry index first holding handle, or count
+		const auto match = [&](std::size_t first) noexcept
+		{
+			const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + first * stride));
+			const unsigned miss = ~static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi32(chunk, needle))) & key_mask;
+			for (std::size_t j = 0; j < per_chunk; ++j)
+			{
+				if (((miss >> (j * stride)) & entry_mask) == 0)
+					return first + j;
+			}
+			return count;
+		};
+
+		// Skip four chunks at a time while no 4 byte lane holding a handle matches
+		for (; i + 4 * per_chunk <= count; i += 4 * per_chunk)
+		{
+			const __m128i* chunk = reinterpret_cast<const __m128i*>(bytes + i * stride);
+			const __m128i any = _mm_or_si128(
+				_mm_or_si128(_mm_cmpeq_epi32(_mm_loadu_si128(chunk), needle), _mm_cmpeq_epi32(_mm_loadu_si128(chunk + 1), needle)),
+				_mm_or_si128(_mm_cmpeq_epi32(_mm_loadu_si128(chunk + 2), needle), _mm_cmpeq_epi32(_mm_loadu_si128(chunk + 3), needle)));
+			if (_mm_movemask_epi8(_mm_and_si128(any, lanes)) == 0)
+				continue;
+
+			for (std::size_t first = i; first < i + 4 * per_chunk; first += per_chunk)
+			{
+				if (const std::size_t found = match(first); found != count)
+					return found;
+			}
+		}
+		for (; i + per_chunk <= count; i += per_chunk)
+		{
+			if (const std::size_t found = match(i); found != count)
+				return found;
+		}
+	}
+#endif
+
+	for (; i < count; ++i)
+	{
+		if (wait_entry<Entry>::handle(entries[i]) == handle)
+			return i;
+	}
+	return count;
+}
+
+#pragma endregion
+
+#pragma region Modifiers
+// Modifiers
+
+template<typename Handle, typename Entry>
+template<typename... Args>
+std::size_t HandleWaitSet<Handle, Entry>::add(Handle handle, Args&&... args)
+{
+	m_entries.push_back(wait_entry<Entry>::make(static_cast<handle_type>(handle.get()), std::forward<Args>(args)...));
+	try
+	{
+		m_handles.push_back(std::move(handle));
+	}
+	catch (...)
+	{
+		m_entries.pop_back();
+		throw;
+	}
+	return m_handles.size() - 1;
+}
+
+// Removes the entry at index and returns its handle. The last entry takes its place.
+template<typename Handle, typename Entry>
+Handle HandleWaitSet<Handle, Entry>::remove(std::size_t index)
+{
+	Handle removed{ std::move(m_handles[index]) };
+	if (index + 1 != m_handles.size())
+	{
+		m_handles[index] = std::move(m_handles.back());
+		m_entries[index] = m_entries.back();
+	}
+	m_handles.pop_back();
+	m_entries.pop_back();
+	return removed;
+}
+
+template<typename Handle, typename Entry>
+void HandleWaitSet<Handle, Entry>::clear() noexcept
+{
+	m_entries.clear();
+	m_handles.clear();
+}
+
+template<typename Handle, typename Entry>
+void HandleWaitSet<Handle, Entry>::reserve(std::size_t count)
+{
+	m_entries.reserve(count);
+	m_handles.reserve(count);
+}
+
+#pragma endregion
+
+#pragma region Lookup
+// Lookup
+
+template<typename Handle, typename Entry>
+std::size_t HandleWaitSet<Handle, Entry>::find(handle_type handle) const noexcept
+{
+	const std::size_t index = winhandle_detail::find_entry(m_entries.data(), m_entries.size(), handle);
+	return index != m_entries.size() ? index : npos;
+}
+
+template<typename Handle, typename Entry>
+Handle& HandleWaitSet<Handle, Entry>::handle(std::size_t index) noexcept
+{
+	return m_handles[index];
+}
+
+template<typename Handle, typename Entry>
+const Handle& HandleWaitSet<Handle, Entry>::handle(std::size_t index) const noexcept
+{
+	return m_handles[index];
+}
+
+template<typename Handle, typename Entry>
+Entry& HandleWaitSet<Handle, Entry>::entry(std::size_t index) noexcept
+{
+	return m_entries[index];
+}
+
+template<typename Handle, typename Entry>
+const Entry& HandleWaitSet<Handle, Entry>::entry(std::size_t index) const noexcept
+{
+	return m_entries[index];
+}
+
+template<typename Handle, typename Entry>
+void HandleWaitSet<Handle, Entry>::refresh() noexcept
+{
+	for (std::size_t i = 0; i < m_handles.size(); ++i)
+		wait_entry<Entry>::assign(m_entries[i], static_cast<handle_type>(m_handles[i].get()));
+}
+
+template<typename Handle, typename Entry>
+Entry* HandleWaitSet<Handle, Entry>::data() noexcept
+{
+	refresh();
+	return m_entries.data();
+}
+
+template<typename Handle, typename Entry>
+const Entry* HandleWaitSet<Handle, Entry>::data() const noexcept
+{
+	return m_entries.data();
+}
+
+template<typename Handle, typename Entry>
+std::span<Entry> HandleWaitSet<Handle, Entry>::entries() noexcept
+{
+	refresh();
+	return m_entries;
+}
+
+template<typename Handle, typename Entry>
+std::span<const Entry> HandleWaitSet<Handle, Entry>::entries() const noexcept
+{
+	return m_entries;
+}
+
+#pragma endregion
+
+#pragma region Capacity
+// Capacity
+
+template<typename Handle, typename Entry>
+std::size_t HandleWaitSet<Handle, Entry>::size() const noexcept
+{
+	return m_entries.size();
+}
+
+template<typename Handle, typename Entry>
+bool HandleWaitSet<Handle, Entry>::empty() const noexcept
+{
+	return m_entries.empty();
+}
+
+#pragma endregion
+#pragma endregion
+
+#pragma region HandleVector implementation
+//////////////////////////////////////////////////////////////////////////
+// HandleVector implementation
+
+#pragma region Scanning
+// Scanning
+
+#if defined(WINHANDLE_SSE2)
+namespace winhandle_detail
+{
+	template<typename T>
+	constexpr bool scannable = (sizeof(T) == 4 || sizeof(T) == 8) && (std::is_integral_v<T> || std::is_enum_v<T> || std::is_pointer_v<T>);
+
+	// 16 bytes holding null in every element
+	template<typename T>
+	__m128i null_needle(T null) noexcept
+	{
+		alignas(16) unsigned char bytes[16];
+		for (std::size_t j = 0; j < 16; j += sizeof(T))
+			std::memcpy(bytes + j, &null, sizeof(T));
+		return _mm_load_si128(reinterpret_cast<const __m128i*>(bytes));
+	}
+
+	// Every 4 byte lane of the result is all ones where the element it is part of is null
+	template<typename T>
+	__m128i null_lanes(const T* handles, __m128i needle) noexcept
+	{
+		const __m128i equal = _mm_cmpeq_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(handles)), needle);
+		if constexpr (sizeof(T) == 4)
+			return equal;
+		else
+			return _mm_and_si128(equal, _mm_shuffle_epi32(equal, _MM_SHUFFLE(2, 3, 0, 1)));
+	}
+
+	// Bit j is set when element j of the 16 bytes at handles is null
+	template<typename T>
+	unsigned null_mask(const T* handles, __m128i needle) noexcept
+	{
+		const __m128i lanes = null_lanes(handles, needle);
+		if constexpr (sizeof(T) == 4)
+			return static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(lanes)));
+		else
+			return static_cast<unsigned>(_mm_movemask_pd(_mm_castsi128_pd(lanes)));
+	}
+}
+#endif
+
+template<typename T>
+std::size_t winhandle_detail::count_not_null(const T* handles, std::size_t count, T null) noexcept
+{
+	std::size_t i = 0;
+	std::size_t nulls = 0;
+
+#if defined(WINHANDLE_SSE2)
+	if constexpr (scannable<T>)
+	{
+		// Each 4 byte lane counts the null elements it was part of
+		constexpr std::size_t per_chunk = 16 / sizeof(T);
+		const __m128i needle = null_needle(null);
+		__m128i lanes = _mm_setzero_si128();
+		for (; i + per_chunk <= count; i += per_chunk)
+			lanes = _mm_sub_epi32(lanes, null_lanes(handles + i, needle));
+
+		alignas(16) std::uint32_t counts[4];
+		_mm_store_si128(reinterpret_cast<__m128i*>(counts), lanes);
+		nulls = (static_cast<std::size_t>(counts[0]) + counts[1] + counts[2] + counts[3]) / (sizeof(T) / 4);
+	}
+#endif
+
+	for (; i < count; ++i)
+		nulls += handles[i] == null;
+	return count - nulls;
+}
+
+template<typename T>
+std::size_t winhandle_detail::find_not_null(const T* handles, std::size_t first, std::size_t count, T null) noexcept
+{
+	std::size_t i = first;
+
+#if defined(WINHANDLE_SSE2)
+	if constexpr (scannable<T>)
+	{
+		constexpr std::size_t per_chunk = 16 / sizeof(T);
+		constexpr unsigned all = (1u << per_chunk) - 1;
+		const __m128i needle = null_needle(null);
+		for (; i + per_chunk <= count; i += per_chunk)
+		{
+			if (const unsigned mask = null_mask(handles + i, needle); mask != all)
+				return i + static_cast<std::size_t>(std::countr_zero(~mask));
+		}
+	}
+#endif
+
+	for (; i < count; ++i)
+	{
+		if (handles[i] != null)
+			return i;
+	}
+	return count;
+}
+
+#pragma endregion
+
+#pragma region Constructors
+// Constructors
+
+template<typename T, T NullValue, typename RT, typename Deleter>
+HandleVector<T, NullValue, RT, Deleter>::HandleVector(const Deleter& deleter)
+	: storage(deleter)
+{
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter>
+HandleVector<T, NullValue, RT, Deleter>::HandleVector(Deleter&& deleter) noexcept
+	: storage(std::move(deleter))
+{
+}
+
+#pragma endregion
+
+#pragma region Copy and move
+// Copy and move
+
+template<typename T, T NullValue, typename RT, typename Deleter>
+HandleVector<T, NullValue, RT, Deleter>::HandleVector(HandleVector&& move) noexcept
+	: storage(std::move(move.get_deleter())), m_handles{ std::move(move.m_handles) }
+{
+	move.m_handles.clear();
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter>
+HandleVector<T, NullValue, RT, Deleter>& HandleVector<T, NullValue, RT, Deleter>::operator=(HandleVector&& move) noexcept
+{
+	if (this != &move)
+	{
+		clear();
+		get_deleter() = std::move(move.get_deleter());
+		m_handles = std::move(move.m_handles);
+		move.m_handles.clear();
+	}
+	return *this;
+}
+
+#pragma endregion
+
+#pragma region Destructor
+// Destructor
+
+template<typename T, T NullValue, typename RT, typename Deleter>
+HandleVector<T, NullValue, RT, Deleter>::~HandleVector() noexcept
+{
+	close_all();
+}
+
+#pragma endregion
+
+#pragma region Modifiers
+// Modifiers
+
+template<typename T, T NullValue, typename RT, typename Deleter>
+void HandleVector<T, NullValue, RT, Deleter>::push_back(T handle)
+{
+	m_handles.push_back(handle);
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter>
+void HandleVector<T, NullValue, RT, Deleter>::pop_back() noexcept
+{
+	close(m_handles.size() - 1);
+	m_handles.pop_back();
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter>
+void HandleVector<T, NullValue, RT, Deleter>::clear() noexcept
+{
+	close_all();
+	m_handles.clear();
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter>
+void HandleVector<T, NullValue, RT, Deleter>::reserve(std::size_t count)
+{
+	m_handles.reserve(count);
+}
+
+#pragma endregion
+
+#pragma region Handle operations
+// Handle operations
+
+template<typename T, T NullValue, typename RT, typename Deleter>
+RT HandleVector<T, NullValue, RT, Deleter>::close(std::size_t index) noexcept
+{
+	if (m_handles[index] == NullValue)
+		return RT{};
+	return winhandle_detail::invoke_deleter<RT>(get_deleter(), std::exchange(m_handles[index], NullValue));
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter>
+T HandleVector<T, NullValue, RT, Deleter>::release(std::size_t index) noexcept
+{
+	return std::exchange(m_handles[index], NullValue);
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter>
+WinHandle<T, NullValue, RT, Deleter> HandleVector<T, NullValue, RT, Deleter>::extract(std::size_t index)
+{
+	WinHandle<T, NullValue, RT, Deleter> handle{ m_handles[index], get_deleter() };
+	m_handles[index] = NullValue;
+	return handle;
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter>
+UniqueWinHandle<T, NullValue, RT, Deleter> HandleVector<T, NullValue, RT, Deleter>::extract_unique(std::size_t index)
+{
+	UniqueWinHandle<T, NullValue, RT, Deleter> handle{ m_handles[index], get_deleter() };
+	m_handles[index] = NullValue;
+	return handle;
+}
+
+// Without results, file descriptors released with close are sorted in place and contiguous ranges
+// are closed with a single close_range() call on Linux, since every element ends up null anyway.
+template<typename T, T NullValue, typename RT, typename Deleter>
+std::size_t HandleVector<T, NullValue, RT, Deleter>::close_all(std::span<std::type_identity_t<RT>> results) noexcept
+{
+	std::size_t closed = 0;
+
+#if defined(__linux__) && defined(SYS_close_range)
+	if constexpr (std::is_same_v<T, int> && std::is_same_v<RT, int>)
+	{
+		if (results.empty() && winhandle_detail::calls_posix_close(get_deleter()))
+		{
+			std::sort(m_handles.begin(), m_handles.end());
+			for (std::size_t first = 0, last = 0; first < m_handles.size(); first = last)
+			{
+				last = first + 1;
+				const int fd = m_handles[first];
+				if (fd == NullValue)
+					continue;
+				if (fd < 0)
+				{
+					winhandle_detail::invoke_deleter<RT>(get_deleter(), fd);
+					++closed;
+					continue;
+				}
+
+				for (; last < m_handles.size() && m_handles[last] != NullValue && m_handles[last] - m_handles[last - 1] <= 1; ++last)
+					;
+				if (m_handles[last - 1] == fd || !winhandle_detail::close_fd_range(fd, m_handles[last - 1]))
+				{
+					for (std::size_t k = first; k < last; ++k)
+						winhandle_detail::invoke_deleter<RT>(get_deleter(), m_handles[k]);
+				}
+				closed += last - first;
+			}
+			std::fill(m_handles.begin(), m_handles.end(), NullValue);
+			return closed;
+		}
+	}
+#endif
+
+	for (std::size_t i = 0; i < m_handles.size(); ++i)
+	{
+		const bool open = m_handles[i] != NullValue;
+		const RT result = close(i);
+		if (i < results.size())
+			results[i] = result;
+		closed += open;
+	}
+	return closed;
+}
+
+#pragma endregion
+
+#pragma region Bulk scans
+// Bulk scans
+
+template<typename T, T NullValue, typename RT, typename Deleter>
+std::size_t HandleVector<T, NullValue, RT, Deleter>::count_valid() const noexcept
+{
+	return winhandle_detail::count_not_null(m_handles.data(), m_handles.size(), NullValue);
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter>
+std::size_t HandleVector<T, NullValue, RT, Deleter>::next_valid(std::size_t first) const noexcept
+{
+	return winhandle_detail::find_not_null(m_handles.data(), first, m_handles.size(), NullValue);
+}
+
+#pragma endregion
+
+#pragma region Element access
+// Element access
+
+template<typename T, T NullValue, typename RT, typename Deleter>
+T HandleVector<T, NullValue, RT, Deleter>::operator[](std::size_t index) const noexcept
+{
+	return m_handles[index];
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter>
+bool HandleVector<T, NullValue, RT, Deleter>::valid(std::size_t index) const noexcept
+{
+	return m_handles[index] != NullValue;
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter>
+const T* HandleVector<T, NullValue, RT, Deleter>::data() const noexcept
+{
+	return m_handles.data();
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter>
+std::span<const T> HandleVector<T, NullValue, RT, Deleter>::handles() const noexcept
+{
+	return m_handles;
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter>
+Deleter& HandleVector<T, NullValue, RT, Deleter>::get_deleter() noexcept
+{
+	return storage::deleter();
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter>
+const Deleter& HandleVector<T, NullValue, RT, Deleter>::get_deleter() const noexcept
+{
+	return storage::deleter();
+}
+
+#pragma endregion
+
+#pragma region Capacity
+// Capacity
+
+template<typename T, T NullValue, typename RT, typename Deleter>
+std::size_t HandleVector<T, NullValue, RT, Deleter>::size() const noexcept
+{
+	return m_handles.size();
+}
+
+template<typename T, T NullValue, typename RT, typename Deleter>
+bool HandleVector<T, NullValue, RT, Deleter>::empty() const noexcept
+{
+	return m_handles.empty();
+}
+
+#pragma endregion
+#pragma endregion
+
+#pragma region HandleCache implementation
+//////////////////////////////////////////////////////////////////////////
+// HandleCache implementation
+
+#pragma region Constructors
+// Constructors
+
+template<typename Key, typename Handle, typename Hash, typename KeyEqual>
+HandleCache<Key, Handle, Hash, KeyEqual>::HandleCache(std::size_t budget, std::size_t shards)
+	: m_budget{ budget }
+{
+	if (shards == 0)
+		shards = std::max(1u, std::thread::hardware_concurrency());
+	shards = std::bit_ceil(shards);
+	m_shards = std::make_unique<shard[]>(shards);
+	m_mask = shards - 1;
+}
+
+#pragma endregion
+
+#pragma region Lookup
+// Lookup
+
+template<typename Key, typename Handle, typename Hash, typename KeyEqual>
+template<typename Factory>
+Handle HandleCache<Key, Handle, Hash, KeyEqual>::get(const Key& key, Factory&& factory)
+{
+	const std::size_t index = shard_index(key);
+	shard& s = m_shards[index];
+	std::unique_lock lock{ s.mutex };
+
+	// Wait for a concurrent miss on the same key. If it fails, this call opens the handle instead.
+	for (auto it = s.entries.find(key); it != s.entries.end(); it = s.entries.find(key))
+	{
+		entry& e = it->second;
+		if (!e.loading)
+		{
+			unlink(s, e);
+			link_front(s, e);
+			return e.handle;
+		}
+		s.loaded.wait(lock);
+	}
+
+	// Elements of an unordered_map keep their address when it rehashes, iterators do not
+	const auto inserted = s.entries.try_emplace(key).first;
+	entry& e = inserted->second;
+	e.key = &inserted->first;
+	m_size.fetch_add(1, std::memory_order_relaxed);
+	lock.unlock();
+
+	const auto abandon = [this, &s, &lock, &key]() noexcept
+	{
+		lock.lock();
+		s.entries.erase(s.entries.find(key));
+		m_size.fetch_sub(1, std::memory_order_relaxed);
+		lock.unlock();
+		s.loaded.notify_all();
+	};
+
+	Handle handle;
+	try
+	{
+		handle = std::forward<Factory>(factory)(key);
+	}
+	catch (...)
+	{
+		abandon();
+		throw;
+	}
 
-template<typename T, T NullValue, typename RT, typename U>
-bool operator <(const WinHandle<T, NullValue, RT>& lhs, const WinHandle<U, NullValue, RT>& rhs) noexcept
-{
-	return lhs.get() < rhs.get();
-}
+	if (!handle.valid())
+	{
+		abandon();
+		return handle;
+	}
 
-template<typename T, T NullValue, typename RT, typename U>
-bool operator <=(const WinHandle<T, NullValue, RT>& lhs, const WinHandle<U, NullValue, RT>& rhs) noexcept
-{
-	return lhs.get() <= rhs.get();
-}
+	lock.lock();
+	e.handle = handle;
+	e.loading = false;
+	link_front(s, e);
+	lock.unlock();
+	s.loaded.notify_all();
 
-template<typename T, T NullValue, typename RT, typename U>
-bool operator >(const WinHandle<T, NullValue, RT>& lhs, const WinHandle<U, NullValue, RT>& rhs)
-{
-	return lhs.get() > rhs.get();
+	if (m_size.load(std::memory_order_relaxed) > m_budget)
+		make_room(index);
+	return handle;
 }
 
-template<typename T, T NullValue, typename RT, typename U>
-bool operator >=(const WinHandle<T, NullValue, RT>& lhs, const WinHandle<U, NullValue, RT>& rhs) noexcept
+template<typename Key, typename Handle, typename Hash, typename KeyEqual>
+Handle HandleCache<Key, Handle, Hash, KeyEqual>::find(const Key& key)
 {
-	return lhs.get() >= rhs.get();
-}
+	shard& s = m_shards[shard_index(key)];
+	std::lock_guard lock{ s.mutex };
 
-#else !__cpp_impl_three_way_comparison
+	const auto it = s.entries.find(key);
+	if (it == s.entries.end() || it->second.loading)
+		return Handle{};
 
-template<typename T, T NullValue, typename RT, typename U>
-std::strong_ordering operator <=>(const WinHandle<T, NullValue, RT>& lhs, const WinHandle<U, NullValue, RT>& rhs) noexcept
-{
-	return std::compare_three_way{}(lhs.get(), rhs.get());
+	unlink(s, it->second);
+	link_front(s, it->second);
+	return it->second.handle;
 }
 
-#endif !__cpp_impl_three_way_comparison
-
 #pragma endregion
 
-#pragma region Handle comparison operators
-// Handle comparison operators
+#pragma region Eviction
+// Eviction
 
-template<typename T, T NullValue, typename RT>
-bool operator ==(const T& lhs, const WinHandle<T, NullValue, RT>& rhs) noexcept
+// Removes the entry of key unless it is still being opened. The handle is closed once it is idle.
+template<typename Key, typename Handle, typename Hash, typename KeyEqual>
+bool HandleCache<Key, Handle, Hash, KeyEqual>::erase(const Key& key)
 {
-	return lhs == rhs.get();
+	shard& s = m_shards[shard_index(key)];
+	Handle victim;
+	std::lock_guard lock{ s.mutex };
+
+	const auto it = s.entries.find(key);
+	if (it == s.entries.end() || it->second.loading)
+		return false;
+
+	victim = std::move(it->second.handle);
+	unlink(s, it->second);
+	s.entries.erase(it);
+	m_size.fetch_sub(1, std::memory_order_relaxed);
+	return true;
 }
 
-template<typename T, T NullValue, typename RT>
-bool operator ==(const WinHandle<T, NullValue, RT>& lhs, const T& rhs) noexcept
+template<typename Key, typename Handle, typename Hash, typename KeyEqual>
+std::size_t HandleCache<Key, Handle, Hash, KeyEqual>::trim()
 {
-	return lhs.get() == rhs;
+	std::size_t closed = 0;
+	for (std::size_t i = 0; i <= m_mask; ++i)
+	{
+		std::vector<Handle> victims; // Closed after the shard is unlocked
+		std::lock_guard lock{ m_shards[i].mutex };
+		evict(m_shards[i], true, victims);
+		closed += victims.size();
+	}
+	return closed;
 }
 
-#if !__cpp_impl_three_way_comparison
-
-template<typename T, T NullValue, typename RT>
-bool operator !=(const T& lhs, const WinHandle<T, NullValue, RT>& rhs) noexcept
+template<typename Key, typename Handle, typename Hash, typename KeyEqual>
+void HandleCache<Key, Handle, Hash, KeyEqual>::evict(shard& s, bool all, std::vector<Handle>& victims)
 {
-	return lhs != rhs.get();
+	for (entry* e = s.tail; e && (all || m_size.load(std::memory_order_relaxed) > m_budget);)
+	{
+		entry* prev = e->prev;
+		if (e->handle.use_count() == 1)
+		{
+			victims.push_back(std::move(e->handle));
+			unlink(s, *e);
+			s.entries.erase(s.entries.find(*e->key));
+			m_size.fetch_sub(1, std::memory_order_relaxed);
+		}
+		e = prev;
+	}
 }
 
-template<typename T, T NullValue, typename RT>
-bool operator !=(const WinHandle<T, NullValue, RT>& lhs, const T& rhs) noexcept
+// Evicts idle handles from the shards in turn, starting with the one that just grew
+template<typename Key, typename Handle, typename Hash, typename KeyEqual>
+void HandleCache<Key, Handle, Hash, KeyEqual>::make_room(std::size_t first)
 {
-	return lhs.get() != rhs;
+	for (std::size_t i = 0; i <= m_mask && m_size.load(std::memory_order_relaxed) > m_budget; ++i)
+	{
+		shard& s = m_shards[(first + i) & m_mask];
+		std::vector<Handle> victims; // Closed after the shard is unlocked
+		std::lock_guard lock{ s.mutex };
+		evict(s, false, victims);
+	}
 }
 
-template<typename T, T NullValue, typename RT>
-bool operator <(const T& lhs, const WinHandle<T, NullValue, RT>& rhs) noexcept
-{
-	return lhs < rhs.get();
-}
+#pragma endregion
 
-template<typename T, T NullValue, typename RT>
-bool operator <(const WinHandle<T, NullValue, RT>& lhs, const T& rhs) noexcept
-{
-	return lhs.get() < rhs;
-}
+#pragma region Capacity
+// Capacity
 
-template<typename T, T NullValue, typename RT>
-bool operator <=(const T& lhs, const WinHandle<T, NullValue, RT>& rhs) noexcept
+template<typename Key, typename Handle, typename Hash, typename KeyEqual>
+std::size_t HandleCache<Key, Handle, Hash, KeyEqual>::size() const noexcept
 {
-	return lhs <= rhs.get();
+	return m_size.load(std::memory_order_relaxed);
 }
 
-template<typename T, T NullValue, typename RT>
-bool operator <=(const WinHandle<T, NullValue, RT>& lhs, const T& rhs) noexcept
+template<typename Key, typename Handle, typename Hash, typename KeyEqual>
+std::size_t HandleCache<Key, Handle, Hash, KeyEqual>::budget() const noexcept
 {
-	return lhs.get() <= rhs;
+	return m_budget;
 }
 
-template<typename T, T NullValue, typename RT>
-bool operator >(const T& lhs, const WinHandle<T, NullValue, RT>& rhs) noexcept
+// Half of the soft limit on open file descriptors, leaving the rest to handles outside the cache
+template<typename Key, typename Handle, typename Hash, typename KeyEqual>
+std::size_t HandleCache<Key, Handle, Hash, KeyEqual>::default_budget() noexcept
 {
-	return lhs > rhs.get();
+#if defined(__linux__)
+	rlimit limit{};
+	if (::getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY)
+		return std::max<std::size_t>(1, static_cast<std::size_t>(limit.rlim_cur) / 2);
+	return 4096;
+#else
+	// Windows has no per-process handle limit comparable to RLIMIT_NOFILE
+	return 4096;
+#endif
 }
 
-template<typename T, T NullValue, typename RT>
-bool operator >(const WinHandle<T, NullValue, RT>& lhs, const T& rhs) noexcept
-{
-	return lhs.get() > rhs;
-}
+#pragma endregion
 
-template<typename T, T NullValue, typename RT>
-bool operator >=(const T& lhs, const WinHandle<T, NullValue, RT>& rhs) noexcept
-{
-	return lhs >= rhs.get();
-}
+#pragma region Shards
+// Shards
 
-template<typename T, T NullValue, typename RT>
-bool operator >=(const WinHandle<T, NullValue, RT>& lhs, const T& rhs) noexcept
+template<typename Key, typename Handle, typename Hash, typename KeyEqual>
+std::size_t HandleCache<Key, Handle, Hash, KeyEqual>::shard_index(const Key& key) const noexcept
 {
-	return lhs.get() >= rhs;
+	return static_cast<std::size_t>(winhandle_detail::mix_bits(static_cast<std::uint64_t>(Hash{}(key))) >> 32) & m_mask;
 }
 
-#else !__cpp_impl_three_way_comparison
-
-template<typename T, T NullValue, typename RT>
-std::strong_ordering operator <=>(const T& lhs, const WinHandle<T, NullValue, RT>& rhs) noexcept
+template<typename Key, typename Handle, typename Hash, typename KeyEqual>
+void HandleCache<Key, Handle, Hash, KeyEqual>::link_front(shard& s, entry& e) noexcept
 {
-	return std::compare_three_way{}(lhs, rhs.get());
+	e.prev = nullptr;
+	e.next = s.head;
+	if (s.head)
+		s.head->prev = &e;
+	else
+		s.tail = &e;
+	s.head = &e;
 }
 
-template<typename T, T NullValue, typename RT>
-std::strong_ordering operator <=>(const WinHandle<T, NullValue, RT>& lhs, const T& rhs) noexcept
+template<typename Key, typename Handle, typename Hash, typename KeyEqual>
+void HandleCache<Key, Handle, Hash, KeyEqual>::unlink(shard& s, entry& e) noexcept
 {
-	return std::compare_three_way{}(lhs.get(), rhs);
+	(e.prev ? e.prev->next : s.head) = e.next;
+	(e.next ? e.next->prev : s.tail) = e.prev;
+	e.prev = nullptr;
+	e.next = nullptr;
 }
 
-#endif !__cpp_impl_three_way_comparison
-
 #pragma endregion
-
 #pragma endregion
 
-#pragma region WinHandle implementation
+#pragma region MutableHandles implementation
 //////////////////////////////////////////////////////////////////////////
-// WinHandle implementation
+// MutableHandles implementation
 
 #pragma region Constructors
 // Constructors
 
-template<typename T, T NullValue, typename RT>
-WinHandle<T, NullValue, RT>::WinHandle()
-	: m_impl{ std::make_shared<impl>(NullValue, nullptr) }
+template<typename Handle, std::size_t N>
+MutableHandles<Handle, N>::MutableHandles(std::span<Handle, N> owners, std::pmr::memory_resource* resource) noexcept
+	: m_resource{ resource }
 {
+	for (std::size_t i = 0; i < N; ++i)
+	{
+		m_owners[i] = &owners[i];
+		m_handles[i] = owners[i].get();
+	}
 }
 
-template<typename T, T NullValue, typename RT>
-WinHandle<T, NullValue, RT>::WinHandle(T handle, nullptr_t)
-	: m_impl{ std::make_shared<impl>(handle, nullptr) }
+template<typename Handle, std::size_t N>
+template<typename... Owners>
+	requires (sizeof...(Owners) == N && (std::is_same_v<Owners, Handle> && ...))
+MutableHandles<Handle, N>::MutableHandles(Owners&... owners) noexcept
+	: m_owners{ &owners... }, m_handles{ owners.get()... }
 {
 }
 
-// std::function
-template<typename T, T NullValue, typename RT>
-WinHandle<T, NullValue, RT>::WinHandle(std::function<RT(T)> deleter)
-	: m_impl{ std::make_shared<impl>(NullValue, deleter) }
+#pragma endregion
+
+#pragma region Destructor
+// Destructor
+
+template<typename Handle, std::size_t N>
+MutableHandles<Handle, N>::~MutableHandles() noexcept
 {
+	for (std::size_t i = 0; i < N; ++i)
+	{
+		if constexpr (requires { typename Handle::refcount_type; })
+			m_owners[i]->acquire(m_handles[i], m_resource);
+		else
+			m_owners[i]->reset(m_handles[i]);
+	}
 }
 
-template<typename T, T NullValue, typename RT>
-WinHandle<T, NullValue, RT>::WinHandle(T handle, std::function<RT(T)> deleter)
-	: m_impl{ std::make_shared<impl>(handle, deleter) }
+#pragma endregion
+
+#pragma region Conversion operators
+// Conversion operators
+
+template<typename Handle, std::size_t N>
+MutableHandles<Handle, N>::operator element_type* () noexcept
 {
+	return m_handles;
 }
 
-// Function pointer
-template<typename T, T NullValue, typename RT>
-template<typename DType>
-WinHandle<T, NullValue, RT>::WinHandle(RT(__stdcall* deleter)(DType))
-	: m_impl{ std::make_shared<impl>(NullValue, std::bind(deleter, std::placeholders::_1)) }
+template<typename Handle, std::size_t N>
+MutableHandles<Handle, N>::operator std::span<element_type>() noexcept
 {
+	return m_handles;
 }
 
-template<typename T, T NullValue, typename RT>
-template<typename DType, typename... Args>
-WinHandle<T, NullValue, RT>::WinHandle(RT(__stdcall* deleter)(DType, Args...), Args&&... args)
-	: m_impl{ std::make_shared<impl>(NullValue, std::bind(deleter, std::placeholders::_1, std::forward<Args>(args)...)) }
+template<typename Handle, std::size_t N>
+typename MutableHandles<Handle, N>::element_type* MutableHandles<Handle, N>::data() noexcept
 {
+	return m_handles;
 }
 
-template<typename T, T NullValue, typename RT>
-template<typename DType>
-WinHandle<T, NullValue, RT>::WinHandle(T handle, RT(__stdcall* deleter)(DType))
-	: m_impl{ std::make_shared<impl>(handle, std::bind(deleter, std::placeholders::_1)) }
+// Restores the values of the owners, which makes the update in the destructor a no-op
+template<typename Handle, std::size_t N>
+void MutableHandles<Handle, N>::cancel() noexcept
 {
+	for (std::size_t i = 0; i < N; ++i)
+		m_handles[i] = m_owners[i]->get();
 }
 
-template<typename T, T NullValue, typename RT>
-template<typename DType, typename... Args>
-WinHandle<T, NullValue, RT>::WinHandle(T handle, RT(__stdcall* deleter)(DType, Args...), Args&&... args)
-	: m_impl{ std::make_shared<impl>(handle, std::bind(deleter, std::placeholders::_1, std::forward<Args>(args)...)) }
+#pragma endregion
+
+#pragma region Factories
+// Factories
+
+template<typename Handle, typename... Handles>
+MutableHandles<Handle, 1 + sizeof...(Handles)> ptrs(Handle& first, Handles&... rest) noexcept
 {
+	return MutableHandles<Handle, 1 + sizeof...(Handles)>(first, rest...);
 }
 
-// Member function pointer
-template<typename T, T NullValue, typename RT>
-template<typename Class, typename DType>
-WinHandle<T, NullValue, RT>::WinHandle(RT(__stdcall Class::* deleter)(DType), Class* instance)
-	: m_impl{ std::make_shared<impl>(NullValue, std::bind(deleter, instance, std::placeholders::_1)) }
+template<std::size_t Group, typename Handle, typename Function>
+std::size_t acquire_groups(std::span<Handle> handles, Function&& function, std::pmr::memory_resource* resource)
 {
+	std::size_t groups = 0;
+	for (; (groups + 1) * Group <= handles.size(); ++groups)
+	{
+		MutableHandles<Handle, Group> out{ handles.subspan(groups * Group).template first<Group>(), resource };
+		if (!function(out.data()))
+		{
+			out.cancel();
+			break;
+		}
+	}
+	return groups;
 }
 
-template<typename T, T NullValue, typename RT>
-template<typename Class, typename DType, typename... Args>
-WinHandle<T, NullValue, RT>::WinHandle(RT(__stdcall Class::* deleter)(DType, Args...), Class* instance, Args&&... args)
-	: m_impl{ std::make_shared<impl>(NullValue, std::bind(deleter, instance, std::placeholders::_1, std::forward<Args>(args)...)) }
+#pragma endregion
+#pragma endregion
+
+#pragma region SmallHandleVector implementation
+//////////////////////////////////////////////////////////////////////////
+// SmallHandleVector implementation
+
+#pragma region Relocation
+// Relocation
+
+template<typename T>
+void winhandle_detail::relocate(T* source, std::size_t count, T* target) noexcept
 {
+	if constexpr (is_trivially_relocatable_v<T>)
+	{
+		if (count)
+			std::memmove(static_cast<void*>(target), static_cast<const void*>(source), count * sizeof(T));
+	}
+	else
+	{
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			::new (static_cast<void*>(target + i)) T(std::move(source[i]));
+			source[i].~T();
+		}
+	}
 }
 
-template<typename T, T NullValue, typename RT>
-template<typename Class, typename DType>
-WinHandle<T, NullValue, RT>::WinHandle(T handle, RT(__stdcall Class::* deleter)(DType), Class* instance)
-	: m_impl{ std::make_shared<impl>(handle, std::bind(deleter, instance, std::placeholders::_1)) }
+#pragma endregion
+
+#pragma region Constructors
+// Constructors
+
+template<typename Handle, std::size_t InlineCapacity>
+SmallHandleVector<Handle, InlineCapacity>::SmallHandleVector() noexcept
+	: m_data{ inline_data() }
 {
 }
 
-template<typename T, T NullValue, typename RT>
-template<typename Class, typename DType, typename... Args>
-WinHandle<T, NullValue, RT>::WinHandle(T handle, RT(__stdcall Class::* deleter)(DType, Args...), Class* instance, Args&&... args)
-	: m_impl{ std::make_shared<impl>(handle, std::bind(deleter, instance, std::placeholders::_1, std::forward<Args>(args)...)) }
+template<typename Handle, std::size_t InlineCapacity>
+SmallHandleVector<Handle, InlineCapacity>::SmallHandleVector(std::initializer_list<Handle> handles)
+	: SmallHandleVector()
 {
+	reserve(handles.size());
+	for (const Handle& handle : handles)
+		push_back(handle);
 }
 
 #pragma endregion
 
-#pragma region Copy and move constructors
-// Copy and move constructors
-template<typename T, T NullValue, typename RT>
-WinHandle<T, NullValue, RT>::WinHandle(WinHandle&& move) noexcept
-	: m_impl(move.m_impl)
+#pragma region Copy and move
+// Copy and move
+
+template<typename Handle, std::size_t InlineCapacity>
+SmallHandleVector<Handle, InlineCapacity>::SmallHandleVector(const SmallHandleVector& copy)
+	: SmallHandleVector()
 {
-	std::make_shared<impl>(NullValue, m_impl->deleter()).swap(move.m_impl);
+	reserve(copy.size());
+	for (const Handle& handle : copy)
+		push_back(handle);
 }
 
-#pragma endregion
-
-#pragma region Copy and move assignment operators
-// Copy and move assignment operators
+// Allocated storage is taken over, inline elements are relocated
+template<typename Handle, std::size_t InlineCapacity>
+SmallHandleVector<Handle, InlineCapacity>::SmallHandleVector(SmallHandleVector&& move) noexcept
+	: SmallHandleVector()
+{
+	swap(move);
+}
 
-template<typename T, T NullValue, typename RT>
-WinHandle<T, NullValue, RT>& WinHandle<T, NullValue, RT>::operator =(WinHandle&& move) noexcept
+template<typename Handle, std::size_t InlineCapacity>
+SmallHandleVector<Handle, InlineCapacity>& SmallHandleVector<Handle, InlineCapacity>::operator=(const SmallHandleVector& copy)
 {
-	m_impl = move.m_impl;
-	std::make_shared<impl>(NullValue, m_impl->deleter()).swap(move.m_impl);
+	if (this != &copy)
+	{
+		SmallHandleVector replacement{ copy };
+		swap(replacement);
+	}
 	return *this;
 }
 
-#pragma endregion
-
-#pragma region Assignment operators
-// Assignment operators
-
-template<typename T, T NullValue, typename RT>
-WinHandle<T, NullValue, RT>& WinHandle<T, NullValue, RT>::operator=(const T& handle) noexcept
+template<typename Handle, std::size_t InlineCapacity>
+SmallHandleVector<Handle, InlineCapacity>& SmallHandleVector<Handle, InlineCapacity>::operator=(SmallHandleVector&& move) noexcept
 {
-	m_impl->assign(handle);
+	if (this != &move)
+	{
+		clear();
+		release_storage();
+		swap(move);
+	}
 	return *this;
 }
 
 #pragma endregion
 
-#pragma region Conversion operators
-// Conversion operators
+#pragma region Destructor
+// Destructor
 
-template<typename T, T NullValue, typename RT>
-WinHandle<T, NullValue, RT>::operator bool_type() const noexcept
+template<typename Handle, std::size_t InlineCapacity>
+SmallHandleVector<Handle, InlineCapacity>::~SmallHandleVector() noexcept
 {
-	return valid() ? &WinHandle::this_type_does_not_support_comparisons : nullptr;
+	clear();
+	release_storage();
 }
 
 #pragma endregion
 
-#pragma region Smart pointer operations
-// Smart pointer operations
+#pragma region Modifiers
+// Modifiers
 
-template<typename T, T NullValue, typename RT>
-void WinHandle<T, NullValue, RT>::swap(WinHandle& other) noexcept
+template<typename Handle, std::size_t InlineCapacity>
+void SmallHandleVector<Handle, InlineCapacity>::push_back(const Handle& handle)
 {
-	m_impl.swap(other.m_impl);
+	emplace_back(handle);
 }
 
-template<typename T, T NullValue, typename RT>
-void WinHandle<T, NullValue, RT>::reset()
+template<typename Handle, std::size_t InlineCapacity>
+void SmallHandleVector<Handle, InlineCapacity>::push_back(Handle&& handle)
 {
-	std::make_shared<impl>(NullValue, m_impl->deleter()).swap(m_impl);
+	emplace_back(std::move(handle));
 }
 
-template<typename T, T NullValue, typename RT>
-void WinHandle<T, NullValue, RT>::reset(T handle)
+// When the vector is full, the new element is constructed in the new storage before the others are
+// relocated, so args may refer to an element of the vector
+template<typename Handle, std::size_t InlineCapacity>
+template<typename... Args>
+Handle& SmallHandleVector<Handle, InlineCapacity>::emplace_back(Args&&... args)
 {
-	if (handle != m_impl->get())
-		std::make_shared<impl>(handle, m_impl->deleter()).swap(m_impl);
+	if (m_size < m_capacity)
+		return *::new (static_cast<void*>(m_data + m_size++)) Handle(std::forward<Args>(args)...);
+
+	const size_type capacity = grown(m_size + 1);
+	Handle* storage = std::allocator<Handle>{}.allocate(capacity);
+	Handle* handle;
+	try
+	{
+		handle = ::new (static_cast<void*>(storage + m_size)) Handle(std::forward<Args>(args)...);
+	}
+	catch (...)
+	{
+		std::allocator<Handle>{}.deallocate(storage, capacity);
+		throw;
+	}
+
+	winhandle_detail::relocate(m_data, m_size, storage);
+	release_storage();
+	m_data = storage;
+	m_capacity = capacity;
+	++m_size;
+	return *handle;
 }
 
-template<typename T, T NullValue, typename RT>
-long WinHandle<T, NullValue, RT>::use_count() const noexcept
+template<typename Handle, std::size_t InlineCapacity>
+void SmallHandleVector<Handle, InlineCapacity>::pop_back() noexcept
 {
-	return m_impl.use_count();
+	m_data[--m_size].~Handle();
 }
 
-#pragma endregion
-
-#pragma region Handle operations
-// Handle operations
-
-template<typename T, T NullValue, typename RT>
-bool WinHandle<T, NullValue, RT>::valid() const noexcept
+template<typename Handle, std::size_t InlineCapacity>
+typename SmallHandleVector<Handle, InlineCapacity>::iterator SmallHandleVector<Handle, InlineCapacity>::erase(const_iterator position) noexcept
 {
-	return m_impl->get() != NullValue;
+	return erase(position, position + 1);
 }
 
-template<typename T, T NullValue, typename RT>
-T WinHandle<T, NullValue, RT>::get() const noexcept
+// The erased handles are destroyed and the elements after them are relocated into their place
+template<typename Handle, std::size_t InlineCapacity>
+typename SmallHandleVector<Handle, InlineCapacity>::iterator SmallHandleVector<Handle, InlineCapacity>::erase(const_iterator first, const_iterator last) noexcept
 {
-	return m_impl->get();
+	Handle* target = m_data + (first - m_data);
+	Handle* source = m_data + (last - m_data);
+	std::destroy(target, source);
+	winhandle_detail::relocate(source, static_cast<size_type>(end() - source), target);
+	m_size -= static_cast<size_type>(source - target);
+	return target;
 }
 
-template<typename T, T NullValue, typename RT>
-const T* WinHandle<T, NullValue, RT>::ptr() const noexcept
+template<typename Handle, std::size_t InlineCapacity>
+void SmallHandleVector<Handle, InlineCapacity>::clear() noexcept
 {
-	return m_impl->ptr();
+	std::destroy(m_data, m_data + m_size);
+	m_size = 0;
 }
 
-template<typename T, T NullValue, typename RT>
-typename WinHandle<T, NullValue, RT>::MutableHandle WinHandle<T, NullValue, RT>::ptr() noexcept
+template<typename Handle, std::size_t InlineCapacity>
+void SmallHandleVector<Handle, InlineCapacity>::reserve(size_type capacity)
 {
-	return MutableHandle(*this);
+	if (capacity > m_capacity)
+		reallocate(capacity);
 }
 
-template<typename T, T NullValue, typename RT>
-RT WinHandle<T, NullValue, RT>::close() noexcept
+template<typename Handle, std::size_t InlineCapacity>
+void SmallHandleVector<Handle, InlineCapacity>::swap(SmallHandleVector& other) noexcept
 {
-	return m_impl->assign(NullValue);
+	if (this == &other)
+		return;
+
+	// Allocated storage changes owners. Inline elements are relocated through a temporary buffer.
+	alignas(Handle) unsigned char buffer[sizeof(m_inline)];
+	Handle* const saved = reinterpret_cast<Handle*>(buffer);
+	const bool thisInline = is_inline();
+	const bool otherInline = other.is_inline();
+	if (thisInline)
+		winhandle_detail::relocate(m_data, m_size, saved);
+	if (otherInline)
+		winhandle_detail::relocate(other.m_data, other.m_size, inline_data());
+	if (thisInline)
+		winhandle_detail::relocate(saved, m_size, other.inline_data());
+
+	std::swap(m_data, other.m_data);
+	std::swap(m_size, other.m_size);
+	std::swap(m_capacity, other.m_capacity);
+	if (otherInline)
+		m_data = inline_data();
+	if (thisInline)
+		other.m_data = other.inline_data();
 }
 
 #pragma endregion
 
-#pragma endregion
-
-#pragma region WinHandle::impl implementation
-//////////////////////////////////////////////////////////////////////////
-// WinHandle::impl implementation
+#pragma region Element access
+// Element access
 
-#pragma region Constructors
-// Constructors
+template<typename Handle, std::size_t InlineCapacity>
+Handle& SmallHandleVector<Handle, InlineCapacity>::operator[](size_type index) noexcept
+{
+	return m_data[index];
+}
 
-template<typename T, T NullValue, typename RT>
-WinHandle<T, NullValue, RT>::impl::impl(T handle, nullptr_t) noexcept
-	: m_handle{ handle }
+template<typename Handle, std::size_t InlineCapacity>
+const Handle& SmallHandleVector<Handle, InlineCapacity>::operator[](size_type index) const noexcept
 {
+	return m_data[index];
 }
 
-// std::function
-template<typename T, T NullValue, typename RT>
-WinHandle<T, NullValue, RT>::impl::impl(T handle, std::function<RT(T)> deleter)
-	: m_handle{ handle }, m_deleter{ deleter }
+template<typename Handle, std::size_t InlineCapacity>
+Handle& SmallHandleVector<Handle, InlineCapacity>::front() noexcept
 {
+	return m_data[0];
 }
 
-#pragma endregion
+template<typename Handle, std::size_t InlineCapacity>
+Handle& SmallHandleVector<Handle, InlineCapacity>::back() noexcept
+{
+	return m_data[m_size - 1];
+}
 
-#pragma region Destructor
-// Destructor
+template<typename Handle, std::size_t InlineCapacity>
+Handle* SmallHandleVector<Handle, InlineCapacity>::data() noexcept
+{
+	return m_data;
+}
 
-template<typename T, T NullValue, typename RT>
-WinHandle<T, NullValue, RT>::impl::~impl() noexcept
+template<typename Handle, std::size_t InlineCapacity>
+const Handle* SmallHandleVector<Handle, InlineCapacity>::data() const noexcept
 {
-	destroy();
+	return m_data;
 }
 
 #pragma endregion
 
-#pragma region Assignment
-// Assignment
+#pragma region Iterators
+// Iterators
 
-template<typename T, T NullValue, typename RT>
-RT WinHandle<T, NullValue, RT>::impl::assign(T v) noexcept
+template<typename Handle, std::size_t InlineCapacity>
+typename SmallHandleVector<Handle, InlineCapacity>::iterator SmallHandleVector<Handle, InlineCapacity>::begin() noexcept
 {
-	RT result = {};
-	if (v != m_handle)
-	{
-		result = destroy();
-		m_handle = v;
-	}
-	return result;
+	return m_data;
 }
 
-#pragma endregion
-
-#pragma region Member access
-// Member access
-
-template<typename T, T NullValue, typename RT>
-T WinHandle<T, NullValue, RT>::impl::get() const noexcept
+template<typename Handle, std::size_t InlineCapacity>
+typename SmallHandleVector<Handle, InlineCapacity>::iterator SmallHandleVector<Handle, InlineCapacity>::end() noexcept
 {
-	return m_handle;
+	return m_data + m_size;
 }
 
-template<typename T, T NullValue, typename RT>
-const T* WinHandle<T, NullValue, RT>::impl::ptr() const noexcept
+template<typename Handle, std::size_t InlineCapacity>
+typename SmallHandleVector<Handle, InlineCapacity>::const_iterator SmallHandleVector<Handle, InlineCapacity>::begin() const noexcept
 {
-	return &m_handle;
+	return m_data;
 }
 
-template<typename T, T NullValue, typename RT>
-std::function<RT(T)> WinHandle<T, NullValue, RT>::impl::deleter() const noexcept
+template<typename Handle, std::size_t InlineCapacity>
+typename SmallHandleVector<Handle, InlineCapacity>::const_iterator SmallHandleVector<Handle, InlineCapacity>::end() const noexcept
 {
-	return m_deleter;
+	return m_data + m_size;
 }
 
 #pragma endregion
 
-#pragma region Deleter
-// Deleter
+#pragma region Capacity
+// Capacity
 
-template<typename T, T NullValue, typename RT>
-RT WinHandle<T, NullValue, RT>::impl::destroy() noexcept
+template<typename Handle, std::size_t InlineCapacity>
+typename SmallHandleVector<Handle, InlineCapacity>::size_type SmallHandleVector<Handle, InlineCapacity>::size() const noexcept
 {
-	RT result = {};
-	if (m_handle != NullValue)
-	{
-		if (m_deleter)
-			result = m_deleter(m_handle);
-		m_handle = NullValue;
-	}
-	return result;
+	return m_size;
 }
 
-#pragma endregion
-#pragma endregion
-
-#pragma region MutableHandle implementation
+template<typename Handle, std::size_t InlineCapacity>
+typename SmallHandleVector<Handle, InlineCapacity>::size_type SmallHandleVector<Handle, InlineCapacity>::capacity() const noexcept
+{
+	return m_capacity;
+}
 
-//////////////////////////////////////////////////////////////////////////
-// MutableHandle implementation
+template<typename Handle, std::size_t InlineCapacity>
+bool SmallHandleVector<Handle, InlineCapacity>::empty() const noexcept
+{
+	return m_size == 0;
+}
 
-#pragma region Constructor
-// Constructor
-template<typename T, T NullValue, typename RT>
-WinHandle<T, NullValue, RT>::MutableHandle::MutableHandle(WinHandle& owner) noexcept
-	: m_owner(owner), m_handle(owner.get())
+template<typename Handle, std::size_t InlineCapacity>
+bool SmallHandleVector<Handle, InlineCapacity>::is_inline() const noexcept
 {
+	return m_data == reinterpret_cast<const Handle*>(m_inline);
 }
 
 #pragma endregion
 
-#pragma region Destructor
-// Destructor
-template<typename T, T NullValue, typename RT>
-WinHandle<T, NullValue, RT>::MutableHandle::~MutableHandle() noexcept
+#pragma region Storage management
+// Storage management
+
+template<typename Handle, std::size_t InlineCapacity>
+Handle* SmallHandleVector<Handle, InlineCapacity>::inline_data() noexcept
 {
-	m_owner.reset(m_handle);
-	m_handle = NullValue;
+	return reinterpret_cast<Handle*>(m_inline);
 }
 
-#pragma endregion
+// Capacity doubles, starting at 8 elements
+template<typename Handle, std::size_t InlineCapacity>
+typename SmallHandleVector<Handle, InlineCapacity>::size_type SmallHandleVector<Handle, InlineCapacity>::grown(size_type required) const noexcept
+{
+	return std::max({ required, m_capacity * 2, size_type{ 8 } });
+}
 
-#pragma region Conversion operator
-// Conversion operator
-template<typename T, T NullValue, typename RT>
-WinHandle<T, NullValue, RT>::MutableHandle::operator T*() noexcept
+template<typename Handle, std::size_t InlineCapacity>
+void SmallHandleVector<Handle, InlineCapacity>::reallocate(size_type capacity)
 {
-	return &m_handle;
+	Handle* storage = std::allocator<Handle>{}.allocate(capacity);
+	winhandle_detail::relocate(m_data, m_size, storage);
+	release_storage();
+	m_data = storage;
+	m_capacity = capacity;
 }
 
-#pragma endregion
+// Frees allocated storage, which must hold no elements, and returns to the inline storage
+template<typename Handle, std::size_t InlineCapacity>
+void SmallHandleVector<Handle, InlineCapacity>::release_storage() noexcept
+{
+	if (!is_inline())
+		std::allocator<Handle>{}.deallocate(m_data, m_capacity);
+	m_data = inline_data();
+	m_capacity = InlineCapacity;
+}
 
 #pragma endregion
+#pragma endregion